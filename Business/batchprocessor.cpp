@@ -0,0 +1,395 @@
+#include "batchprocessor.h"
+#include "converter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+bool isBlank(const std::string& line) {
+    auto first = std::find_if(line.begin(), line.end(), [](unsigned char c) { return !std::isspace(c); });
+    return first == line.end() || *first == '#';
+}
+
+int parseNumber(const std::string& text, const char* field) {
+    std::size_t used = 0;
+    int value = 0;
+    try {
+        value = std::stoi(text, &used);
+    } catch (const std::exception&) {
+        used = 0;
+    }
+    if (used == 0 || used != text.size()) throw std::invalid_argument(std::string("Invalid ") + field + ": '" + text + "'");
+    return value;
+}
+
+bool containsIgnoringCase(const std::string& text, const std::string& part) {
+    auto it = std::search(text.begin(), text.end(), part.begin(), part.end(), [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    });
+    return it != text.end();
+}
+
+const std::string& required(const std::map<std::string, std::string>& args, const std::string& key) {
+    auto it = args.find(key);
+    if (it == args.end()) throw std::invalid_argument("Missing " + key + "=");
+    return it->second;
+}
+
+StorageFormat formatNamed(const std::string& name) {
+    if (name == "csv") return StorageFormat::Csv;
+    if (name == "json") return StorageFormat::JsonArray;
+    if (name == "ndjson") return StorageFormat::Ndjson;
+    throw std::invalid_argument("Unknown format: " + name);
+}
+
+void checkArguments(const std::map<std::string, std::string>& args, std::initializer_list<const char*> allowed) {
+    for (const auto& [key, value] : args) {
+        if (std::none_of(allowed.begin(), allowed.end(), [&key](const char* name) { return key == name; }))
+            throw std::invalid_argument("Unknown argument: " + key + "=");
+    }
+}
+
+}
+
+std::string BatchReport::summary() const {
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed << "Ran " << commands << " commands (" << failed << " failed) in " << seconds << " s, "
+        << commandsPerSecond() << " commands/s";
+    return out.str();
+}
+
+BatchProcessor::BatchProcessor(Controller& controller) : BatchProcessor(controller, Options()) {}
+
+BatchProcessor::BatchProcessor(Controller& controller, Options options) : controller(controller), options(options) {
+    if (options.groupLimit == 0) throw std::invalid_argument("Group limit must be positive");
+}
+
+BatchProcessor::Command BatchProcessor::parse(const std::string& line) {
+    Command command;
+    std::size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && std::isspace(static_cast<unsigned char>(line[i]))) ++i;
+        if (i == line.size()) break;
+
+        std::string key, current;
+        bool hasValue = false;
+        while (i < line.size() && !std::isspace(static_cast<unsigned char>(line[i]))) {
+            char c = line[i++];
+            if (c == '"') {
+                for (;;) {
+                    if (i == line.size()) throw std::invalid_argument("Unterminated quote");
+                    c = line[i++];
+                    if (c == '"') break;
+                    if (c == '\\' && i < line.size()) c = line[i++];
+                    current += c;
+                }
+            } else if (c == '=' && !hasValue && !command.verb.empty()) {
+                hasValue = true;
+                key.swap(current);
+            } else {
+                current += c;
+            }
+        }
+
+        if (command.verb.empty()) command.verb = current;
+        else if (hasValue) command.args[key] = current;
+        else command.words.push_back(current);
+    }
+    return command;
+}
+
+std::function<bool(const Book&)> BatchProcessor::filterFor(const Command& command) {
+    std::string title, author, genre;
+    bool byTitle = false, byAuthor = false, byGenre = false, byYear = false;
+    int yearFrom = 0, yearTo = 0;
+    for (const auto& [key, value] : command.args) {
+        if (key == "title") {
+            byTitle = true;
+            title = value;
+        } else if (key == "author") {
+            byAuthor = true;
+            author = value;
+        } else if (key == "genre") {
+            byGenre = true;
+            genre = value;
+        } else if (key == "year") {
+            byYear = true;
+            std::size_t dash = value.find('-', 1);
+            yearFrom = parseNumber(value.substr(0, dash), "year");
+            yearTo = dash == std::string::npos ? yearFrom : parseNumber(value.substr(dash + 1), "year");
+        } else if (key != "format") {
+            throw std::invalid_argument("Unknown filter: " + key + "=");
+        }
+    }
+
+    return [=](const Book& book) {
+        if (byTitle && !containsIgnoringCase(book.getTitle(), title)) return false;
+        if (byAuthor && !containsIgnoringCase(book.getAuthor(), author)) return false;
+        if (byGenre && book.getGenre() != genre) return false;
+        if (byYear && (book.getYear() < yearFrom || book.getYear() > yearTo)) return false;
+        return true;
+    };
+}
+
+bool BatchProcessor::isGroupable(const Command& command) {
+    return command.verb == "add" || command.verb == "update" || command.verb == "remove";
+}
+
+bool BatchProcessor::isQuery(const std::string& line) {
+    if (isBlank(line)) return true;
+    try {
+        std::string verb = parse(line).verb;
+        return verb == "filter" || verb == "count" || verb == "stats" || verb == "export";
+    } catch (const std::exception&) {
+        return true; // answered with an error without touching the catalog
+    }
+}
+
+std::function<std::string(Controller&)> BatchProcessor::mutation(const Command& command) {
+    const auto& args = command.args;
+    if (!command.words.empty()) throw std::invalid_argument("Unexpected argument: " + command.words[0]);
+
+    if (command.verb == "add") {
+        checkArguments(args, {"id", "title", "author", "genre", "year"});
+        Book book(required(args, "title"), required(args, "author"), required(args, "genre"),
+                  parseNumber(required(args, "year"), "year"), 0);
+        int id = args.count("id") ? parseNumber(args.at("id"), "id") : 0;
+        return [book, id](Controller& c) mutable {
+            book.setId(id ? id : c.nextId());
+            if (id && c.findStoredBook(id)) throw std::invalid_argument("Book " + std::to_string(id) + " already exists");
+            c.addBook(book);
+            return "ok " + std::to_string(book.getId());
+        };
+    }
+
+    if (command.verb == "update") {
+        checkArguments(args, {"id", "title", "author", "genre", "year"});
+        int id = parseNumber(required(args, "id"), "id");
+        std::map<std::string, std::string> changes = args;
+        int year = args.count("year") ? parseNumber(args.at("year"), "year") : 0;
+        return [id, changes, year](Controller& c) {
+            auto book = c.findStoredBook(id);
+            if (!book) throw std::out_of_range("No book with id " + std::to_string(id));
+            if (changes.count("title")) book->setTitle(changes.at("title"));
+            if (changes.count("author")) book->setAuthor(changes.at("author"));
+            if (changes.count("genre")) book->setGenre(changes.at("genre"));
+            if (changes.count("year")) book->setYear(year);
+            c.updateBook(*book);
+            return std::string("ok");
+        };
+    }
+
+    // remove
+    if (args.count("id")) {
+        checkArguments(args, {"id"});
+        int id = parseNumber(args.at("id"), "id");
+        return [id](Controller& c) {
+            if (!c.findStoredBook(id)) throw std::out_of_range("No book with id " + std::to_string(id));
+            c.removeBook(id);
+            return std::string("ok 1");
+        };
+    }
+    if (args.empty()) throw std::invalid_argument("remove needs id= or a filter");
+    auto filter = filterFor(command);
+    return [filter](Controller& c) { return "ok " + std::to_string(c.removeMatching(filter)); };
+}
+
+std::string BatchProcessor::query(const Command& command, std::ostream& out) const {
+    auto snapshot = controller.snapshot();
+
+    if (command.verb == "filter" || command.verb == "count") {
+        if (!command.words.empty()) throw std::invalid_argument("Unexpected argument: " + command.words[0]);
+        auto filter = filterFor(command);
+        if (command.verb == "count") {
+            if (command.args.count("format")) throw std::invalid_argument("Unknown argument: format=");
+            std::size_t count = 0;
+            for (const auto& book : *snapshot) count += filter(book) ? 1 : 0;
+            return "ok " + std::to_string(count);
+        }
+        StorageFormat format = command.args.count("format") ? formatNamed(command.args.at("format")) : StorageFormat::Csv;
+        return "ok " + std::to_string(exportBooks(*snapshot, out, format, filter));
+    }
+
+    if (command.verb == "export") {
+        if (command.words.size() != 1) throw std::invalid_argument("export needs one file name");
+        if (command.args.count("format")) throw std::invalid_argument("Unknown argument: format=");
+        const std::string& fileName = command.words[0];
+        StorageFormat format = FormatConverter::formatOf(fileName);
+        auto filter = filterFor(command);
+
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) throw std::runtime_error("Failed to open " + fileName + " for writing");
+        return "ok " + std::to_string(exportBooks(*snapshot, file, format, filter));
+    }
+
+    // stats
+    if (!command.args.empty() || !command.words.empty()) throw std::invalid_argument("stats takes no arguments");
+    std::map<std::string, std::size_t> genres;
+    std::unordered_set<std::string> authors;
+    int minYear = 0, maxYear = 0;
+    bool first = true;
+    for (const auto& book : *snapshot) {
+        ++genres[book.getGenre()];
+        authors.insert(book.getAuthor());
+        if (first || book.getYear() < minYear) minYear = book.getYear();
+        if (first || book.getYear() > maxYear) maxYear = book.getYear();
+        first = false;
+    }
+    out << "books " << snapshot->size() << "\n"
+        << "authors " << authors.size() << "\n";
+    if (snapshot->size() > 0) out << "years " << minYear << "-" << maxYear << "\n";
+    for (const auto& [genre, count] : genres) out << "genre " << genre << " " << count << "\n";
+    out << "version " << snapshot->version() << "\n";
+    return "ok";
+}
+
+bool BatchProcessor::dispatch(const Command& command, std::ostream& out) {
+    const std::string& verb = command.verb;
+    try {
+        std::string answer;
+        if (isGroupable(command)) {
+            answer = mutation(command)(controller);
+        } else if (verb == "filter" || verb == "count" || verb == "stats" || verb == "export") {
+            answer = query(command, out);
+        } else if (verb == "import") {
+            if (command.words.size() != 1 || !command.args.empty()) throw std::invalid_argument("import needs one file name");
+            answer = "ok " + std::to_string(controller.importCsv(command.words[0]).imported);
+        } else if (verb == "begin" || verb == "commit" || verb == "rollback" || verb == "undo" || verb == "redo") {
+            if (!command.args.empty() || !command.words.empty()) throw std::invalid_argument(verb + " takes no arguments");
+            if (verb == "begin") controller.beginTransaction();
+            else if (verb == "commit") controller.commitTransaction();
+            else if (verb == "rollback") controller.rollbackTransaction();
+            else if (verb == "undo") controller.undo();
+            else controller.redo();
+            answer = "ok";
+        } else {
+            throw std::invalid_argument("Unknown command: " + verb);
+        }
+        out << answer << "\n";
+        return true;
+    } catch (const std::exception& e) {
+        out << "error " << e.what() << "\n";
+        return false;
+    }
+}
+
+bool BatchProcessor::execute(const std::string& line, std::ostream& out) {
+    if (isBlank(line)) return true;
+
+    Command command;
+    try {
+        command = parse(line);
+    } catch (const std::exception& e) {
+        out << "error " << e.what() << "\n";
+        return false;
+    }
+    return dispatch(command, out);
+}
+
+BatchReport BatchProcessor::run(std::istream& in, std::ostream& out) {
+    auto started = std::chrono::steady_clock::now();
+    BatchReport report;
+
+    // Mutations waiting for a group commit; an entry that failed to parse
+    // keeps its message and is answered in place
+    std::vector<std::function<void(Controller&)>> group;
+    std::vector<std::string> answers;
+    std::vector<std::string> parseErrors;
+    bool stopped = false;
+
+    auto flush = [&] {
+        if (group.empty()) return;
+        auto errors = controller.applyGroup(group);
+        for (std::size_t i = 0; i < group.size(); ++i) {
+            std::string message = parseErrors[i];
+            if (errors[i]) {
+                try {
+                    std::rethrow_exception(errors[i]);
+                } catch (const std::exception& e) {
+                    message = e.what();
+                }
+            }
+            if (message.empty()) {
+                out << answers[i] << "\n";
+            } else {
+                out << "error " << message << "\n";
+                ++report.failed;
+                if (options.stopOnError) stopped = true;
+            }
+        }
+        group.clear();
+        answers.clear();
+        parseErrors.clear();
+    };
+
+    if (options.atomic) controller.beginTransaction();
+
+    std::string line;
+    while (!stopped && std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (isBlank(line)) continue;
+        ++report.commands;
+
+        Command command;
+        std::string parseError;
+        try {
+            command = parse(line);
+        } catch (const std::exception& e) {
+            parseError = e.what();
+        }
+
+        // Group-commit runs of mutations; inside a transaction every
+        // mutation is deferred to the commit anyway
+        if (parseError.empty() && isGroupable(command) && !controller.inTransaction()) {
+            std::function<std::string(Controller&)> apply;
+            try {
+                apply = mutation(command);
+            } catch (const std::exception& e) {
+                parseError = e.what();
+            }
+            std::size_t index = answers.size();
+            answers.emplace_back();
+            parseErrors.push_back(parseError);
+            group.push_back([apply, &answers, index](Controller& c) {
+                if (apply) answers[index] = apply(c);
+            });
+            if (group.size() >= options.groupLimit) flush();
+            continue;
+        }
+
+        flush();
+        if (stopped) break;
+
+        bool ok;
+        if (!parseError.empty()) {
+            out << "error " << parseError << "\n";
+            ok = false;
+        } else {
+            ok = dispatch(command, out);
+        }
+        if (!ok) {
+            ++report.failed;
+            if (options.stopOnError || options.atomic) stopped = true;
+        }
+    }
+    flush();
+
+    if (options.atomic) {
+        if (report.failed > 0) {
+            controller.rollbackTransaction();
+            out << "error rolled back " << report.commands << " commands\n";
+        } else {
+            controller.commitTransaction();
+        }
+    }
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
@@ -0,0 +1,87 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include "controller.h"
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BatchReport
+{
+    std::size_t commands = 0;
+    std::size_t failed = 0;
+    double seconds = 0;
+
+    double commandsPerSecond() const { return seconds > 0 ? commands / seconds : 0; }
+    std::string summary() const;
+};
+
+// Line protocol over a Controller, for scripted and headless use. One
+// command per line; arguments are key=value pairs (values may be "quoted",
+// with \" and \\ escapes) or plain words:
+//
+//   add title=T author=A genre=G year=Y [id=N]   -> ok <id>
+//   update id=N [title=T] [author=A] [genre=G] [year=Y]
+//   remove id=N | remove <filter>                 -> ok <removed>
+//   filter <filter> [format=csv|json|ndjson]      -> the books, then ok <count>
+//   count <filter>                                -> ok <count>
+//   stats                                         -> key/value lines, then ok
+//   import FILE.csv                               -> ok <imported>
+//   export FILE <filter>                          -> ok <written>; format from the extension
+//   begin | commit | rollback | undo | redo
+//
+// A filter is any of title=, author= (case-insensitive substring), genre=
+// and year=Y or year=FROM-TO; all given conditions must hold. Every command
+// answers with its output followed by "ok ..." or a single "error <message>"
+// line. Blank lines and lines starting with '#' are ignored.
+class BatchProcessor
+{
+public:
+    struct Options
+    {
+        bool atomic = false;         // run(): the whole input as one transaction, rolled back on the first error
+        bool stopOnError = false;    // run(): stop at the first failing command
+        std::size_t groupLimit = 4096; // run(): mutations group-committed per write
+    };
+
+    explicit BatchProcessor(Controller& controller);
+    BatchProcessor(Controller& controller, Options options);
+
+    // Runs one command immediately; returns false if it failed
+    bool execute(const std::string& line, std::ostream& out);
+
+    // Runs every line of in. Outside an explicit transaction, consecutive
+    // mutations are group-committed so the catalog is written once per run
+    // of them instead of once per command; answers still come in input order.
+    BatchReport run(std::istream& in, std::ostream& out);
+
+    // True if the line only reads the catalog (filter, count, stats, export)
+    static bool isQuery(const std::string& line);
+
+private:
+    struct Command
+    {
+        std::string verb;
+        std::map<std::string, std::string> args;
+        std::vector<std::string> words;
+    };
+
+    Controller& controller;
+    Options options;
+
+    static Command parse(const std::string& line);
+    static std::function<bool(const Book&)> filterFor(const Command& command);
+    static bool isGroupable(const Command& command);
+
+    // Mutation bound to its arguments and its answer; throws on failure
+    std::function<std::string(Controller&)> mutation(const Command& command);
+    std::string query(const Command& command, std::ostream& out) const;
+    bool dispatch(const Command& command, std::ostream& out);
+};
+
+#endif // BATCHPROCESSOR_H
@@ -0,0 +1,160 @@
+#include "catalogsnapshot.h"
+
+#include <algorithm>
+#include <iterator>
+
+CatalogSnapshot::CatalogSnapshot(std::uint64_t version, std::vector<Book> books)
+    : snapshotVersion(version) {
+    std::vector<std::shared_ptr<IdBucket>> index(std::max<std::size_t>(1, books.size() / BucketSize));
+    for (auto& bucket : index) bucket = std::make_shared<IdBucket>();
+    buckets.assign(index.begin(), index.end());
+
+    for (std::size_t first = 0; first < books.size(); first += ChunkSize) {
+        auto from = books.begin() + static_cast<std::ptrdiff_t>(first);
+        auto to = books.begin() + static_cast<std::ptrdiff_t>(std::min(books.size(), first + ChunkSize));
+        auto chunk = std::make_shared<Chunk>(std::make_move_iterator(from), std::make_move_iterator(to));
+        for (const auto& book : *chunk) (*index[bucketOf(book.getId())])[book.getId()] = static_cast<std::uint32_t>(chunks.size());
+        chunks.push_back(std::move(chunk));
+    }
+    countBooks();
+}
+
+std::shared_ptr<const CatalogSnapshot> CatalogSnapshot::withChanges(
+    std::uint64_t version, const std::vector<std::pair<int, const Book*>>& changes) const {
+    std::shared_ptr<CatalogSnapshot> next(new CatalogSnapshot(version));
+    next->chunks = chunks;
+    next->buckets = buckets;
+
+    // Each chunk and bucket a change touches is copied once, then edited in place
+    std::unordered_map<std::size_t, Chunk*> copiedChunks;
+    std::unordered_map<std::size_t, IdBucket*> copiedBuckets;
+    auto editChunk = [&next, &copiedChunks](std::size_t slot) -> Chunk& {
+        Chunk*& copy = copiedChunks[slot];
+        if (!copy) {
+            auto fresh = std::make_shared<Chunk>(*next->chunks[slot]);
+            copy = fresh.get();
+            next->chunks[slot] = std::move(fresh);
+        }
+        return *copy;
+    };
+    auto editBucket = [&next, &copiedBuckets](int id) -> IdBucket& {
+        std::size_t b = next->bucketOf(id);
+        IdBucket*& copy = copiedBuckets[b];
+        if (!copy) {
+            auto fresh = std::make_shared<IdBucket>(*next->buckets[b]);
+            copy = fresh.get();
+            next->buckets[b] = std::move(fresh);
+        }
+        return *copy;
+    };
+
+    for (const auto& [id, book] : changes) {
+        const IdBucket& bucket = *next->buckets[next->bucketOf(id)];
+        auto found = bucket.find(id);
+        if (found != bucket.end()) {
+            std::size_t slot = found->second;
+            Chunk& chunk = editChunk(slot);
+            auto it = std::find_if(chunk.begin(), chunk.end(), [id](const Book& b) { return b.getId() == id; });
+            if (book) {
+                *it = *book;
+            } else {
+                chunk.erase(it);
+                editBucket(id).erase(id);
+            }
+        } else if (book) {
+            if (next->chunks.empty() || next->chunks.back()->size() >= ChunkSize) next->chunks.push_back(std::make_shared<const Chunk>());
+            std::size_t slot = next->chunks.size() - 1;
+            editChunk(slot).push_back(*book);
+            editBucket(id)[id] = static_cast<std::uint32_t>(slot);
+        }
+    }
+    next->countBooks();
+
+    // Re-chunked once removals have left half the room in the chunks unused,
+    // or the buckets have grown to four times their size. Either takes as
+    // many changes as the rebuild copies books.
+    if ((next->chunks.size() > 2 && next->count * 2 < next->chunks.size() * ChunkSize) ||
+        next->count > next->buckets.size() * BucketSize * 4) {
+        return std::make_shared<const CatalogSnapshot>(version, next->books());
+    }
+    return next;
+}
+
+void CatalogSnapshot::countBooks() {
+    starts.clear();
+    starts.reserve(chunks.size() + 1);
+    count = 0;
+    for (const auto& chunk : chunks) {
+        starts.push_back(count);
+        count += chunk->size();
+    }
+    starts.push_back(count);
+}
+
+const Book& CatalogSnapshot::at(std::size_t position) const {
+    // The last chunk starting at or before the position; empty chunks share
+    // their start with the next one
+    std::size_t slot = static_cast<std::size_t>(std::upper_bound(starts.begin(), starts.end(), position) - starts.begin()) - 1;
+    return (*chunks[slot])[position - starts[slot]];
+}
+
+std::vector<Book> CatalogSnapshot::books() const {
+    std::vector<Book> all;
+    all.reserve(count);
+    for (const auto& chunk : chunks) all.insert(all.end(), chunk->begin(), chunk->end());
+    return all;
+}
+
+bool CatalogSnapshot::locate(int id, std::size_t& slot, std::size_t& offset) const {
+    const IdBucket& bucket = *buckets[bucketOf(id)];
+    auto found = bucket.find(id);
+    if (found == bucket.end()) return false;
+
+    slot = found->second;
+    const Chunk& chunk = *chunks[slot];
+    for (offset = 0; offset < chunk.size(); ++offset) {
+        if (chunk[offset].getId() == id) return true;
+    }
+    return false;
+}
+
+const Book* CatalogSnapshot::findById(int id) const {
+    std::size_t slot, offset;
+    return locate(id, slot, offset) ? &(*chunks[slot])[offset] : nullptr;
+}
+
+std::size_t CatalogSnapshot::positionOf(int id) const {
+    std::size_t slot, offset;
+    return locate(id, slot, offset) ? starts[slot] + offset : npos;
+}
+
+const std::vector<std::uint32_t>& CatalogSnapshot::sortOrder(SortField field) const {
+    std::size_t slot = static_cast<std::size_t>(field);
+    std::call_once(ordersBuilt[slot], [this, field, slot] {
+        orders[slot] = SortIndex::build(*this, field);
+        ordersReady[slot].store(true, std::memory_order_release);
+    });
+    return orders[slot];
+}
+
+bool CatalogSnapshot::hasSortOrder(SortField field) const {
+    return ordersReady[static_cast<std::size_t>(field)].load(std::memory_order_acquire);
+}
+
+bool CatalogSnapshot::select(const std::function<bool(const Book&)>& predicate,
+                             const std::function<bool()>& cancelled,
+                             std::vector<std::uint32_t>& positions) const {
+    const std::size_t pollInterval = 4096;
+
+    positions.clear();
+    std::uint32_t i = 0;
+    for (const auto& book : *this) {
+        if (i % pollInterval == 0 && cancelled && cancelled()) {
+            positions.clear();
+            return false;
+        }
+        if (predicate(book)) positions.push_back(i);
+        ++i;
+    }
+    return true;
+}
@@ -0,0 +1,120 @@
+#ifndef CATALOGSNAPSHOT_H
+#define CATALOGSNAPSHOT_H
+
+#include "book.h"
+#include "sortindex.h"
+
+#include <vector>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Immutable, versioned copy of the catalog published by the Controller after
+// every committed change. Snapshots are shared between threads; readers keep
+// the one they hold alive for as long as they need it (read-copy-update).
+//
+// The books are held in copy-on-write chunks of up to ChunkSize, with an id
+// index split into buckets the same way. withChanges() builds the next
+// version by copying only the chunks and buckets the changes touch; every
+// other one is shared with the previous version, so publishing a change
+// costs O(ChunkSize), not a copy of the catalog.
+class CatalogSnapshot
+{
+public:
+    static constexpr std::size_t ChunkSize = 1024;
+    static constexpr std::size_t BucketSize = 512; // ids per index bucket when built
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    CatalogSnapshot(std::uint64_t version, std::vector<Book> books);
+
+    // The catalog after the changes, as the given version. Each change names
+    // an id and the book as it is now, or nullptr if it is gone: a known id is
+    // replaced in place or removed, a new one is appended.
+    std::shared_ptr<const CatalogSnapshot> withChanges(std::uint64_t version,
+                                                       const std::vector<std::pair<int, const Book*>>& changes) const;
+
+    std::uint64_t version() const { return snapshotVersion; }
+    std::size_t size() const { return count; }
+    const Book& at(std::size_t position) const; // O(log chunks)
+    std::vector<Book> books() const;            // a copy, in catalog order
+
+    const Book* findById(int id) const;
+    std::size_t positionOf(int id) const;       // npos if absent
+
+    // Catalog positions in ascending order of the field, built on first use
+    const std::vector<std::uint32_t>& sortOrder(SortField field) const;
+    bool hasSortOrder(SortField field) const; // already built, so sortOrder() returns at once
+
+    // Catalog positions of the matching books, in catalog order. cancelled()
+    // is polled every few thousand books; once it returns true the scan stops
+    // and false is returned without a result.
+    bool select(const std::function<bool(const Book&)>& predicate,
+                const std::function<bool()>& cancelled,
+                std::vector<std::uint32_t>& positions) const;
+
+    // Books in catalog order
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Book;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Book*;
+        using reference = const Book&;
+
+        reference operator*() const { return (*snapshot->chunks[slot])[offset]; }
+        pointer operator->() const { return &**this; }
+        const_iterator& operator++() {
+            ++offset;
+            skipEmpty();
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const { return slot == other.slot && offset == other.offset; }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class CatalogSnapshot;
+        const CatalogSnapshot* snapshot;
+        std::size_t slot;
+        std::size_t offset = 0;
+
+        const_iterator(const CatalogSnapshot* snapshot, std::size_t slot) : snapshot(snapshot), slot(slot) { skipEmpty(); }
+        void skipEmpty() {
+            while (slot < snapshot->chunks.size() && offset >= snapshot->chunks[slot]->size()) {
+                ++slot;
+                offset = 0;
+            }
+        }
+    };
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, chunks.size()); }
+
+private:
+    using Chunk = std::vector<Book>;
+    using IdBucket = std::unordered_map<int, std::uint32_t>; // id -> chunk
+
+    std::uint64_t snapshotVersion;
+    std::vector<std::shared_ptr<const Chunk>> chunks;
+    std::vector<std::shared_ptr<const IdBucket>> buckets;
+    std::vector<std::size_t> starts; // catalog position of each chunk's first book, then the size
+    std::size_t count = 0;
+
+    static constexpr std::size_t FieldCount = 5;
+    mutable std::once_flag ordersBuilt[FieldCount];
+    mutable std::vector<std::uint32_t> orders[FieldCount];
+    mutable std::atomic<bool> ordersReady[FieldCount] = {};
+
+    explicit CatalogSnapshot(std::uint64_t version) : snapshotVersion(version) {}
+    void countBooks();
+    bool locate(int id, std::size_t& slot, std::size_t& offset) const;
+    std::size_t bucketOf(int id) const { return static_cast<std::uint32_t>(id) % buckets.size(); }
+};
+
+#endif // CATALOGSNAPSHOT_H
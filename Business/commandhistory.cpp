@@ -0,0 +1,77 @@
+#include "commandhistory.h"
+
+#include <algorithm>
+
+CommandHistory::CommandHistory(std::size_t maxEntries, std::size_t maxBytes)
+    : slots(std::max<std::size_t>(maxEntries, 1)), maxBytes(maxBytes) {}
+
+void CommandHistory::push(std::unique_ptr<Commands> cmd) {
+    dropRedo();
+    if (count == slots.size()) dropOldest();
+
+    bytes += cmd->memoryUsage();
+    at(count) = std::move(cmd);
+    ++count;
+    ++cursor;
+
+    // Always keep the newest entry, even if it alone exceeds the byte budget
+    while (bytes > maxBytes && count > 1) dropOldest();
+}
+
+void CommandHistory::clear() {
+    for (auto& slot : slots) slot.reset();
+    head = count = cursor = bytes = 0;
+}
+
+void CommandHistory::setLimits(std::size_t maxEntries, std::size_t maxBytes) {
+    maxEntries = std::max<std::size_t>(maxEntries, 1);
+    this->maxBytes = maxBytes;
+
+    // Redo entries go first, newest first, so the redo chain stays contiguous;
+    // only then are the oldest undo entries dropped
+    auto overLimit = [&] { return count > maxEntries || (bytes > maxBytes && count > 1); };
+    while (count > cursor && overLimit()) dropNewest();
+    while (overLimit()) dropOldest();
+
+    // Re-pack the surviving entries at the front of the new ring
+    std::vector<std::unique_ptr<Commands>> resized(maxEntries);
+    for (std::size_t i = 0; i < count; ++i) resized[i] = std::move(at(i));
+    slots = std::move(resized);
+    head = 0;
+}
+
+Commands* CommandHistory::nextUndo() const {
+    return canUndo() ? at(cursor - 1).get() : nullptr;
+}
+
+Commands* CommandHistory::nextRedo() const {
+    return canRedo() ? at(cursor).get() : nullptr;
+}
+
+void CommandHistory::undone() {
+    if (canUndo()) --cursor;
+}
+
+void CommandHistory::redone() {
+    if (canRedo()) ++cursor;
+}
+
+void CommandHistory::dropOldest() {
+    auto& oldest = at(0);
+    bytes -= oldest->memoryUsage();
+    oldest.reset();
+    head = (head + 1) % slots.size();
+    --count;
+    if (cursor > 0) --cursor;
+}
+
+void CommandHistory::dropNewest() {
+    auto& newest = at(count - 1);
+    bytes -= newest->memoryUsage();
+    newest.reset();
+    --count;
+}
+
+void CommandHistory::dropRedo() {
+    while (count > cursor) dropNewest();
+}
@@ -0,0 +1,55 @@
+#ifndef COMMANDHISTORY_H
+#define COMMANDHISTORY_H
+
+#include "commands.h"
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+// Undo/redo history kept in a fixed-size ring buffer.
+// Slots [0, cursor) relative to the oldest entry can be undone, [cursor, count) redone.
+// When either the entry or the byte limit is exceeded the oldest entries are dropped;
+// lowering the limits drops redo entries before any undo entry.
+class CommandHistory
+{
+public:
+    static constexpr std::size_t DefaultMaxEntries = 1000;
+    static constexpr std::size_t DefaultMaxBytes = 4 * 1024 * 1024;
+
+    explicit CommandHistory(std::size_t maxEntries = DefaultMaxEntries,
+                            std::size_t maxBytes = DefaultMaxBytes);
+
+    void push(std::unique_ptr<Commands> cmd);
+    void clear();
+    void setLimits(std::size_t maxEntries, std::size_t maxBytes);
+
+    // The command the next undo/redo should run, or nullptr if there is none.
+    // Call undone()/redone() once it has been applied successfully.
+    Commands* nextUndo() const;
+    Commands* nextRedo() const;
+    void undone();
+    void redone();
+
+    bool canUndo() const { return cursor > 0; }
+    bool canRedo() const { return cursor < count; }
+    std::size_t size() const { return count; }
+    std::size_t memoryUsage() const { return bytes; }
+
+private:
+    std::vector<std::unique_ptr<Commands>> slots;
+    std::size_t maxBytes;
+    std::size_t head = 0;   // ring index of the oldest entry
+    std::size_t count = 0;  // live entries (undoable + redoable)
+    std::size_t cursor = 0; // number of undoable entries
+    std::size_t bytes = 0;
+
+    std::unique_ptr<Commands>& at(std::size_t i) { return slots[(head + i) % slots.size()]; }
+    const std::unique_ptr<Commands>& at(std::size_t i) const { return slots[(head + i) % slots.size()]; }
+
+    void dropOldest();
+    void dropNewest();
+    void dropRedo();
+};
+
+#endif // COMMANDHISTORY_H
@@ -1,3 +1,113 @@
 #include "commands.h"
 
+#include <stdexcept>
+
+namespace {
+
+std::size_t bookFootprint(const Book& book) {
+    return sizeof(Book) + book.getTitle().size() + book.getAuthor().size() + book.getGenre().size();
+}
+
+}
+
 Commands::Commands() {}
+
+std::size_t AddCommand::memoryUsage() const {
+    return sizeof(*this) - sizeof(Book) + bookFootprint(book);
+}
+
+std::size_t RemoveCommand::memoryUsage() const {
+    return sizeof(*this) - sizeof(Book) + bookFootprint(book);
+}
+
+BookDelta::BookDelta(const Book& before, const Book& after)
+    : changed(0), yearBefore(before.getYear()), yearAfter(after.getYear()) {
+    if (before.getTitle() != after.getTitle()) {
+        changed |= Title;
+        texts.emplace_back(before.getTitle(), after.getTitle());
+    }
+    if (before.getAuthor() != after.getAuthor()) {
+        changed |= Author;
+        texts.emplace_back(before.getAuthor(), after.getAuthor());
+    }
+    if (before.getGenre() != after.getGenre()) {
+        changed |= Genre;
+        texts.emplace_back(before.getGenre(), after.getGenre());
+    }
+    if (yearBefore != yearAfter) changed |= Year;
+    texts.shrink_to_fit();
+}
+
+void BookDelta::apply(Book& book) const {
+    assign(book, true);
+}
+
+void BookDelta::revert(Book& book) const {
+    assign(book, false);
+}
+
+void BookDelta::assign(Book& book, bool forward) const {
+    auto text = texts.begin();
+    auto pick = [forward](const std::pair<std::string, std::string>& p) {
+        return forward ? p.second : p.first;
+    };
+
+    if (changed & Title) book.setTitle(pick(*text++));
+    if (changed & Author) book.setAuthor(pick(*text++));
+    if (changed & Genre) book.setGenre(pick(*text++));
+    if (changed & Year) book.setYear(forward ? yearAfter : yearBefore);
+}
+
+std::size_t BookDelta::memoryUsage() const {
+    std::size_t total = sizeof(*this);
+    for (const auto& [before, after] : texts) {
+        total += sizeof(std::pair<std::string, std::string>) + before.size() + after.size();
+    }
+    return total;
+}
+
+void UpdateCommand::undo() {
+    auto book = repo->findById(id);
+    if (!book) throw std::out_of_range("Book with ID not found");
+    delta.revert(*book);
+    repo->update(*book);
+}
+
+void UpdateCommand::redo() {
+    auto book = repo->findById(id);
+    if (!book) throw std::out_of_range("Book with ID not found");
+    delta.apply(*book);
+    repo->update(*book);
+}
+
+std::size_t UpdateCommand::memoryUsage() const {
+    return sizeof(*this) - sizeof(BookDelta) + delta.memoryUsage();
+}
+
+void CompositeCommand::undo() {
+    repo->beginBatch();
+    try {
+        for (auto it = commands.rbegin(); it != commands.rend(); ++it) (*it)->undo();
+    } catch (...) {
+        repo->endBatch();
+        throw;
+    }
+    repo->endBatch();
+}
+
+void CompositeCommand::redo() {
+    repo->beginBatch();
+    try {
+        for (auto& cmd : commands) cmd->redo();
+    } catch (...) {
+        repo->endBatch();
+        throw;
+    }
+    repo->endBatch();
+}
+
+std::size_t CompositeCommand::memoryUsage() const {
+    std::size_t total = sizeof(*this) + commands.capacity() * sizeof(std::unique_ptr<Commands>);
+    for (const auto& cmd : commands) total += cmd->memoryUsage();
+    return total;
+}
@@ -3,10 +3,14 @@
 
 #include "repository.h"
 
+#include <cstddef>
+
 class Commands {
 public:
     virtual void undo() = 0;
     virtual void redo() = 0;
+    // Approximate heap + object footprint, used to cap the undo history by bytes
+    virtual std::size_t memoryUsage() const = 0;
     virtual ~Commands() = default;
     Commands();
 };
@@ -18,6 +22,7 @@ public:
     AddCommand(Repository* repo, const Book& book) : repo(repo), book(book) {}
     void undo() override { repo->remove(book.getId()); }
     void redo() override { repo->add(book); }
+    std::size_t memoryUsage() const override;
 };
 
 class RemoveCommand : public Commands {
@@ -27,22 +32,54 @@ public:
     RemoveCommand(Repository* repo, const Book& book) : repo(repo), book(book) {}
     void undo() override { repo->add(book); }
     void redo() override { repo->remove(book.getId()); }
+    std::size_t memoryUsage() const override;
+};
+
+// Field-level difference between two versions of the same book.
+// Only the fields that actually changed are stored.
+class BookDelta {
+public:
+    BookDelta(const Book& before, const Book& after);
+
+    void apply(Book& book) const;   // before -> after
+    void revert(Book& book) const;  // after -> before
+    std::size_t memoryUsage() const;
+
+private:
+    enum Field : unsigned char { Title = 1, Author = 2, Genre = 4, Year = 8 };
+
+    unsigned char changed;
+    std::vector<std::pair<std::string, std::string>> texts; // (before, after) per changed text field, in Field order
+    int yearBefore, yearAfter;
+
+    void assign(Book& book, bool forward) const;
 };
 
 class UpdateCommand : public Commands {
     Repository* repo;
-    Book oldBook, newBook;
+    int id;
+    BookDelta delta;
 public:
     UpdateCommand(Repository* repo, const Book& oldBook, const Book& newBook)
-        : repo(repo), oldBook(oldBook), newBook(newBook) {}
-    void undo() override {
-        repo->remove(newBook.getId());
-        repo->add(oldBook);
-    }
-    void redo() override {
-        repo->remove(oldBook.getId());
-        repo->add(newBook);
-    }
+        : repo(repo), id(newBook.getId()), delta(oldBook, newBook) {}
+    void undo() override;
+    void redo() override;
+    std::size_t memoryUsage() const override;
+};
+
+// Groups several commands into one undo step. Undo runs the children in
+// reverse order; both directions run inside a single repository batch.
+class CompositeCommand : public Commands {
+    Repository* repo;
+    std::vector<std::unique_ptr<Commands>> commands;
+public:
+    explicit CompositeCommand(Repository* repo) : repo(repo) {}
+    void add(std::unique_ptr<Commands> cmd) { commands.push_back(std::move(cmd)); }
+    bool empty() const { return commands.empty(); }
+    std::size_t size() const { return commands.size(); }
+    void undo() override;
+    void redo() override;
+    std::size_t memoryUsage() const override;
 };
 
 #endif // COMMANDS_H
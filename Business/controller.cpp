@@ -1,61 +1,363 @@
 #include "controller.h"
+#include "metrics.h"
 
-Controller::Controller() {}
+#include <stdexcept>
+
+using WriteLock = std::lock_guard<std::recursive_mutex>;
+
+Controller::Controller()
+    : current(std::make_shared<const CatalogSnapshot>(0, std::vector<Book>{})) {}
 
 Controller::Controller(std::unique_ptr<Repository> repo)
-    : repo(std::move(repo)) {}
+    : repo(std::move(repo)) {
+    this->repo->subscribe([this](const ChangeEvent& event) {
+        ChangeEvent pending = event;
+        pending.book = nullptr;
+        pendingEvents.push_back(pending);
+        if (event.book) pendingBooks[event.id] = *event.book;
+        else pendingBooks.erase(event.id);
+    });
+    publish();
+}
 
 void Controller::addBook(const Book& book) {
+    SCOPED_TIMER("Controller::addBook");
+    WriteLock lock(writeMutex);
     repo->add(book);
-    undoStack.push(std::make_unique<AddCommand>(repo.get(), book));
-    while (!redoStack.empty()) redoStack.pop();
+    record(std::make_unique<AddCommand>(repo.get(), book));
 }
 
 void Controller::removeBook(int id) {
+    SCOPED_TIMER("Controller::removeBook");
+    WriteLock lock(writeMutex);
     auto book = repo->findById(id);
     if (!book) return;
     repo->remove(id);
-    undoStack.push(std::make_unique<RemoveCommand>(repo.get(), *book));
-    while (!redoStack.empty()) redoStack.pop();
+    record(std::make_unique<RemoveCommand>(repo.get(), *book));
 }
 
 void Controller::updateBook(const Book& book) {
+    SCOPED_TIMER("Controller::updateBook");
+    WriteLock lock(writeMutex);
     auto old = repo->findById(book.getId());
     if (!old) return;
-    repo->remove(book.getId());
-    repo->add(book);
-    undoStack.push(std::make_unique<UpdateCommand>(repo.get(), *old, book));
-    while (!redoStack.empty()) redoStack.pop();
+    repo->update(book);
+    record(std::make_unique<UpdateCommand>(repo.get(), *old, book));
+}
+
+void Controller::record(std::unique_ptr<Commands> cmd) {
+    if (transaction) {
+        transaction->add(std::move(cmd));
+        return;
+    }
+    history.push(std::move(cmd));
+    publish();
+}
+
+void Controller::publish() {
+    SCOPED_TIMER("Controller::publish");
+    if (transaction || grouping) return;
+
+    // The next snapshot shares every chunk the pending changes leave alone.
+    // Each change names its book's final state; the events carry the books
+    // the repository wrote, and anything merged in is looked up.
+    std::vector<int> order;
+    std::unordered_map<int, bool> removed;
+    bool reset = !current;
+    for (const auto& event : pendingEvents) {
+        if (event.type == ChangeEvent::Type::Reset) reset = true;
+        if (event.id < 0 || reset) continue;
+        auto [it, added] = removed.emplace(event.id, false);
+        if (added) order.push_back(event.id);
+        it->second = event.type == ChangeEvent::Type::Removed;
+    }
+
+    std::shared_ptr<const CatalogSnapshot> next;
+    if (reset || order.size() > current->size()) {
+        next = std::make_shared<const CatalogSnapshot>(++version, repo->getAll());
+    } else {
+        std::vector<std::unique_ptr<Book>> lookedUp;
+        std::vector<std::pair<int, const Book*>> changes;
+        changes.reserve(order.size());
+        for (int id : order) {
+            const Book* book = nullptr;
+            if (!removed[id]) {
+                auto known = pendingBooks.find(id);
+                if (known != pendingBooks.end()) {
+                    book = &known->second;
+                } else if (auto found = repo->findById(id)) {
+                    lookedUp.push_back(std::move(found));
+                    book = lookedUp.back().get();
+                }
+            }
+            changes.emplace_back(id, book);
+        }
+        next = current->withChanges(++version, changes);
+    }
+    pendingBooks.clear();
+    std::atomic_store(&current, std::shared_ptr<const CatalogSnapshot>(std::move(next)));
+    dispatch(version);
+}
+
+void Controller::dispatch(std::uint64_t version) {
+    if (pendingEvents.empty()) return;
+
+    std::vector<ChangeEvent> events;
+    events.swap(pendingEvents);
+    for (auto& event : events) event.version = version;
+    if (events.size() > 1) {
+        events.insert(events.begin(), ChangeEvent{ChangeEvent::Type::BatchBegin, -1, version});
+        events.push_back(ChangeEvent{ChangeEvent::Type::BatchEnd, -1, version});
+    }
+
+    std::vector<std::pair<int, ChangeListener>> targets;
+    {
+        std::lock_guard<std::mutex> lock(listenerMutex);
+        targets = listeners;
+    }
+    for (const auto& event : events) {
+        for (const auto& [subscription, listener] : targets) listener(event);
+    }
+}
+
+int Controller::subscribe(ChangeListener listener) {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    listeners.emplace_back(++nextSubscription, std::move(listener));
+    return nextSubscription;
+}
+
+void Controller::unsubscribe(int subscription) {
+    std::lock_guard<std::mutex> lock(listenerMutex);
+    for (auto it = listeners.begin(); it != listeners.end(); ++it) {
+        if (it->first == subscription) {
+            listeners.erase(it);
+            return;
+        }
+    }
+}
+
+std::shared_ptr<const CatalogSnapshot> Controller::snapshot() const {
+    return std::atomic_load(&current);
+}
+
+int Controller::nextId() {
+    return repo->nextId();
+}
+
+int Controller::reserveIds(int count) {
+    return repo->reserveIds(count);
 }
 
 std::vector<Book> Controller::getAllBooks() const {
-    return repo->getAll();
+    return snapshot()->books();
 }
 
 std::unique_ptr<Book> Controller::findBook(int id) const {
+    auto snap = snapshot();
+    const Book* book = snap->findById(id);
+    return book ? std::make_unique<Book>(*book) : nullptr;
+}
+
+std::unique_ptr<Book> Controller::findStoredBook(int id) {
+    WriteLock lock(writeMutex);
     return repo->findById(id);
 }
 
 void Controller::undo() {
-    if (undoStack.empty()) return;
-    auto cmd = std::move(undoStack.top());
-    undoStack.pop();
+    SCOPED_TIMER("Controller::undo");
+    WriteLock lock(writeMutex);
+    if (transaction) throw std::logic_error("Cannot undo while a transaction is in progress");
+    Commands* cmd = history.nextUndo();
+    if (!cmd) return;
     cmd->undo();
-    redoStack.push(std::move(cmd));
+    history.undone();
+    publish();
 }
 
 void Controller::redo() {
-    if (redoStack.empty()) return;
-    auto cmd = std::move(redoStack.top());
-    redoStack.pop();
+    SCOPED_TIMER("Controller::redo");
+    WriteLock lock(writeMutex);
+    if (transaction) throw std::logic_error("Cannot redo while a transaction is in progress");
+    Commands* cmd = history.nextRedo();
+    if (!cmd) return;
     cmd->redo();
-    undoStack.push(std::move(cmd));
+    history.redone();
+    publish();
+}
+
+void Controller::setHistoryLimits(std::size_t maxEntries, std::size_t maxBytes) {
+    WriteLock lock(writeMutex);
+    history.setLimits(maxEntries, maxBytes);
+}
+
+void Controller::beginTransaction() {
+    std::unique_lock<std::recursive_mutex> lock(writeMutex);
+    if (transaction) throw std::logic_error("Transaction already in progress");
+    repo->beginBatch();
+    transaction = std::make_unique<CompositeCommand>(repo.get());
+    transactionLock = std::move(lock);
+}
+
+void Controller::commitTransaction() {
+    SCOPED_TIMER("Controller::commitTransaction");
+    WriteLock lock(writeMutex);
+    if (!transaction) throw std::logic_error("No transaction in progress");
+    auto release = std::move(transactionLock);
+    auto cmd = std::move(transaction);
+    if (!cmd->empty()) history.push(std::move(cmd));
+    try {
+        repo->endBatch();
+    } catch (...) {
+        publish();
+        throw;
+    }
+    publish();
+}
+
+void Controller::rollbackTransaction() {
+    WriteLock lock(writeMutex);
+    if (!transaction) throw std::logic_error("No transaction in progress");
+    auto release = std::move(transactionLock);
+    auto cmd = std::move(transaction);
+    try {
+        cmd->undo();
+    } catch (...) {
+        repo->endBatch();
+        publish();
+        throw;
+    }
+    repo->endBatch();
+    publish();
+}
+
+std::vector<std::exception_ptr> Controller::applyGroup(const std::vector<std::function<void(Controller&)>>& mutations) {
+    SCOPED_TIMER("Controller::applyGroup");
+    WriteLock lock(writeMutex);
+    if (transaction) throw std::logic_error("Cannot group-commit inside a transaction");
+
+    std::vector<std::exception_ptr> errors(mutations.size());
+    grouping = true;
+    repo->beginBatch();
+    for (std::size_t i = 0; i < mutations.size(); ++i) {
+        try {
+            mutations[i](*this);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    }
+    grouping = false;
+
+    try {
+        repo->endBatch();
+    } catch (...) {
+        publish();
+        throw;
+    }
+    publish();
+    return errors;
+}
+
+std::size_t Controller::removeMatching(const std::function<bool(const Book&)>& filterFn) {
+    SCOPED_TIMER("Controller::removeMatching");
+    WriteLock lock(writeMutex);
+    std::vector<int> ids;
+    for (const auto& book : repo->findMatching(filterFn)) ids.push_back(book.getId());
+
+    bool owner = !transaction;
+    if (owner) beginTransaction();
+    try {
+        for (int id : ids) removeBook(id);
+    } catch (...) {
+        if (owner) rollbackTransaction();
+        throw;
+    }
+    if (owner) commitTransaction();
+    return ids.size();
+}
+
+ImportReport Controller::importCsv(const std::string& fileName, const CsvImporter& importer) {
+    SCOPED_TIMER("Controller::importCsv");
+    // Parse before taking the lock, so other writers only wait for the rows
+    // being added
+    CsvImporter::ParsedFile parsed = importer.parseFile(fileName);
+
+    WriteLock lock(writeMutex);
+    if (transaction) throw std::logic_error("Cannot import inside a transaction");
+
+    ImportReport report;
+    try {
+        report = importer.apply(std::move(parsed), *repo);
+    } catch (...) {
+        publish();
+        throw;
+    }
+    publish();
+    return report;
+}
+
+void Controller::setCompressedStorage(bool enabled) {
+    SCOPED_TIMER("Controller::setCompressedStorage");
+    WriteLock lock(writeMutex);
+    if (transaction) throw std::logic_error("Cannot change storage inside a transaction");
+
+    repo->setCompressed(enabled);
+    publish(); // the write may have merged another process's changes
+}
+
+std::size_t Controller::reloadFromDisk() {
+    SCOPED_TIMER("Controller::reloadFromDisk");
+    WriteLock lock(writeMutex);
+    if (transaction) throw std::logic_error("Cannot reload inside a transaction");
+
+    std::size_t changed = repo->reload();
+    if (changed > 0) publish();
+    return changed;
+}
+
+std::size_t Controller::setGenre(const std::vector<int>& ids, const std::string& genre) {
+    return updateEach(ids, [&genre](Book& book) { book.setGenre(genre); });
+}
+
+std::size_t Controller::setYear(const std::vector<int>& ids, int year) {
+    return updateEach(ids, [year](Book& book) { book.setYear(year); });
+}
+
+std::size_t Controller::updateEach(const std::vector<int>& ids, const std::function<void(Book&)>& change) {
+    SCOPED_TIMER("Controller::updateEach");
+    WriteLock lock(writeMutex);
+    std::size_t updated = 0;
+
+    bool owner = !transaction;
+    if (owner) beginTransaction();
+    try {
+        for (int id : ids) {
+            auto book = repo->findById(id);
+            if (!book) continue;
+            change(*book);
+            updateBook(*book);
+            ++updated;
+        }
+    } catch (...) {
+        if (owner) rollbackTransaction();
+        throw;
+    }
+    if (owner) commitTransaction();
+    return updated;
 }
 
 std::vector<Book> Controller::filterBooks(const std::function<bool(const Book&)>& filterFn) const {
+    SCOPED_TIMER("Controller::filterBooks");
+    auto snap = snapshot();
     std::vector<Book> result;
-    for (const auto& book : repo->getAll()) {
+    for (const auto& book : *snap) {
         if (filterFn(book)) result.push_back(book);
     }
     return result;
 }
+
+std::size_t Controller::exportBooks(std::ostream& out, ExportFormat format,
+                                    const std::function<bool(const Book&)>& filterFn) const {
+    SCOPED_TIMER("Controller::exportBooks");
+    auto snap = snapshot();
+    return ::exportBooks(*snap, out, format, filterFn);
+}
@@ -3,11 +3,23 @@
 
 #include "repository.h"
 #include "commands.h"
+#include "commandhistory.h"
+#include "catalogsnapshot.h"
+#include "csvimporter.h"
+#include "exporter.h"
 
-#include <stack>
 #include <memory>
+#include <unordered_map>
+#include <mutex>
 #include <vector>
+#include <string>
+#include <functional>
+#include <exception>
 
+// Mutations are serialized by a writer lock and, once committed, published as
+// a new CatalogSnapshot. Read calls (getAllBooks, findBook, filterBooks and
+// snapshot) only touch the current snapshot, so they may run on any thread
+// without waiting for the writer.
 class Controller
 {
 public:
@@ -20,18 +32,92 @@ public:
 
     std::vector<Book> getAllBooks() const;
     std::unique_ptr<Book> findBook(int id) const;
+    std::shared_ptr<const CatalogSnapshot> snapshot() const;
+    // Reads the repository under the writer lock rather than the snapshot, so
+    // it sees changes not yet published; for writers inside a transaction or
+    // group commit
+    std::unique_ptr<Book> findStoredBook(int id);
+
+    // Id allocation, delegated to the repository; safe from any thread
+    int nextId();
+    int reserveIds(int count);
+
+    // Change notification. Listeners run on the writing thread right after the
+    // snapshot containing the change has been published. Changes committed
+    // together (transaction, group commit, bulk undo) arrive between
+    // BatchBegin and BatchEnd.
+    int subscribe(ChangeListener listener);
+    void unsubscribe(int subscription);
 
     // Undo/Redo
     void undo();
     void redo();
+    void setHistoryLimits(std::size_t maxEntries, std::size_t maxBytes);
+
+    // Transactions: mutations between begin and commit are written to disk once
+    // and undone/redone as a single step. Rollback reverts the partial work.
+    // The writer lock is held from begin to commit/rollback, which must be
+    // called on the same thread. Readers see the changes after commit.
+    void beginTransaction();
+    void commitTransaction();
+    void rollbackTransaction();
+    bool inTransaction() const { return transaction != nullptr; }
+
+    // Group commit: runs independent mutations under one repository batch, so
+    // the file is written and a snapshot published once. Unlike a transaction
+    // each mutation keeps its own undo entry and a failing one does not affect
+    // the others; its exception is returned at the same index.
+    // Throws if the final write fails.
+    std::vector<std::exception_ptr> applyGroup(const std::vector<std::function<void(Controller&)>>& mutations);
+
+    // Bulk operations, each run as one transaction
+    std::size_t removeMatching(const std::function<bool(const Book&)>& filterFn);
+    std::size_t setGenre(const std::vector<int>& ids, const std::string& genre);
+    std::size_t setYear(const std::vector<int>& ids, int year);
+
+    // Bulk CSV import in a single write. Imported books are not recorded in
+    // the undo history.
+    ImportReport importCsv(const std::string& fileName, const CsvImporter& importer = CsvImporter());
+
+    // Switches the repository file between plain and block-compressed storage
+    // and rewrites it once
+    void setCompressedStorage(bool enabled);
+    bool compressedStorage() const { return repo->isCompressed(); }
+
+    // Applies changes another process made to the repository file and
+    // publishes them; returns how many books changed. The undo history is
+    // kept, so undoing may overwrite what the other process wrote.
+    std::size_t reloadFromDisk();
 
     // Filtering
     std::vector<Book> filterBooks(const std::function<bool(const Book&)>& filterFn) const;
+
+    // Streams the matching books of the current snapshot to out without
+    // collecting them first; returns how many were written
+    std::size_t exportBooks(std::ostream& out, ExportFormat format,
+                            const std::function<bool(const Book&)>& filterFn = nullptr) const;
 private:
     std::unique_ptr<Repository> repo;
 
-    std::stack<std::unique_ptr<Commands>> undoStack;
-    std::stack<std::unique_ptr<Commands>> redoStack;
+    CommandHistory history;
+    std::unique_ptr<CompositeCommand> transaction;
+
+    std::recursive_mutex writeMutex;
+    std::unique_lock<std::recursive_mutex> transactionLock;
+    std::shared_ptr<const CatalogSnapshot> current;
+    std::uint64_t version = 0;
+    bool grouping = false;
+
+    std::mutex listenerMutex;
+    int nextSubscription = 0;
+    std::vector<std::pair<int, ChangeListener>> listeners;
+    std::vector<ChangeEvent> pendingEvents;
+    std::unordered_map<int, Book> pendingBooks; // last book written per pending id
+
+    void record(std::unique_ptr<Commands> cmd);
+    void publish();
+    void dispatch(std::uint64_t version);
+    std::size_t updateEach(const std::vector<int>& ids, const std::function<void(Book&)>& change);
 };
 
 #endif // CONTROLLER_H
@@ -0,0 +1,306 @@
+#include "converter.h"
+#include "csvrepository.h"
+#include "jsonrepository.h"
+#include "ndjsonrepository.h"
+#include "blockfile.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    if (text.size() < suffix.size()) return false;
+    for (std::size_t i = 0; i < suffix.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(text[text.size() - suffix.size() + i])) != suffix[i]) return false;
+    }
+    return true;
+}
+
+bool hasBookFields(const QJsonObject& obj) {
+    return obj.contains("id") && obj.contains("title") && obj.contains("author") &&
+           obj.contains("genre") && obj.contains("year");
+}
+
+enum class NdjsonLine { Malformed, Deleted, Record };
+
+// One NDJSON line as NDJSONRepository reads it: a book, a deletion of id, or neither
+NdjsonLine parseNdjson(const std::string& text, Book& book, int& id) {
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(QByteArray(text.data(), static_cast<int>(text.size())), &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) return NdjsonLine::Malformed;
+
+    QJsonObject obj = doc.object();
+    if (!obj.contains("id")) return NdjsonLine::Malformed;
+    if (obj.value("deleted").toBool()) {
+        id = obj.value("id").toInt();
+        return NdjsonLine::Deleted;
+    }
+    if (!hasBookFields(obj)) return NdjsonLine::Malformed;
+    try {
+        book = Book::fromJson(obj);
+    } catch (const std::exception&) {
+        return NdjsonLine::Malformed;
+    }
+    id = book.getId();
+    return NdjsonLine::Record;
+}
+
+bool isBlank(const std::string& text) {
+    return text.empty() || text == "\r";
+}
+
+}
+
+// ========== BookReader ==========
+
+BookReader::BookReader(std::istream& in, StorageFormat format) : in(in), format(format) {}
+
+bool BookReader::next(Book& book) {
+    switch (format) {
+    case StorageFormat::Csv: return nextCsv(book);
+    case StorageFormat::Ndjson: return nextNdjson(book);
+    case StorageFormat::JsonArray: return nextJson(book);
+    }
+    return false;
+}
+
+bool BookReader::nextCsv(Book& book) {
+    while (std::getline(in, text)) {
+        if (text.empty() || text[0] == ',' || text[0] == '\r') continue;
+        try {
+            book = CSVRepository::parseLine(text);
+            return true;
+        } catch (const std::exception&) {
+            ++skippedRecords;
+        }
+    }
+    return false;
+}
+
+bool BookReader::nextNdjson(Book& book) {
+    if (!started) {
+        started = true;
+        indexNdjson();
+    }
+
+    int id = 0;
+    while (std::getline(in, text)) {
+        if (isBlank(text)) continue;
+        std::size_t current = line++;
+
+        switch (parseNdjson(text, book, id)) {
+        case NdjsonLine::Malformed:
+            ++skippedRecords;
+            break;
+        case NdjsonLine::Deleted:
+            break;
+        case NdjsonLine::Record:
+            // Written only if no later line replaces or deletes it
+            if (lastRecords.at(id) == current) return true;
+            break;
+        }
+    }
+    return false;
+}
+
+void BookReader::indexNdjson() {
+    std::streampos start = in.tellg();
+    if (start == std::streampos(-1)) {
+        throw std::runtime_error("NDJSON source must be seekable to resolve replaced records.");
+    }
+
+    Book book;
+    int id = 0;
+    for (std::size_t current = 0; std::getline(in, text);) {
+        if (isBlank(text)) continue;
+        if (parseNdjson(text, book, id) != NdjsonLine::Malformed) lastRecords[id] = current;
+        ++current;
+    }
+
+    in.clear();
+    in.seekg(start);
+    if (!in) throw std::runtime_error("Failed to rewind NDJSON source.");
+}
+
+bool BookReader::nextJson(Book& book) {
+    if (!started) {
+        started = true;
+        in >> std::ws;
+        if (in.get() != '[') throw std::runtime_error("Invalid JSON structure: expected an array.");
+    }
+
+    while (!ended && readJsonValue()) {
+        // Wrapped, so that scalar elements parse as a document too
+        text.insert(0, 1, '[');
+        text += ']';
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(QByteArray(text.data(), static_cast<int>(text.size())), &error);
+        if (error.error != QJsonParseError::NoError) {
+            throw std::runtime_error("JSON parsing failed: " + error.errorString().toStdString());
+        }
+
+        // Non-object elements and incomplete records are skipped, as JSONRepository does
+        QJsonValue element = doc.array().at(0);
+        QJsonObject obj = element.toObject();
+        if (!element.isObject() || !hasBookFields(obj)) {
+            ++skippedRecords;
+            continue;
+        }
+        try {
+            book = Book::fromJson(obj);
+            return true;
+        } catch (const std::exception&) {
+            ++skippedRecords;
+        }
+    }
+    return false;
+}
+
+bool BookReader::readJsonValue() {
+    text.clear();
+    std::streambuf* buffer = in.rdbuf();
+
+    int c = buffer->sbumpc();
+    while (c != EOF && (std::isspace(c) || c == ',')) c = buffer->sbumpc();
+    if (c == ']') {
+        ended = true;
+        return false;
+    }
+
+    // Collect one complete element, tracking nesting outside of strings. A
+    // scalar ends at the next separator, which is put back.
+    int depth = 0;
+    bool inString = false;
+    bool escaped = false;
+    for (;; c = buffer->sbumpc()) {
+        if (c == EOF) throw std::runtime_error("JSON parsing failed: unterminated array");
+        char ch = static_cast<char>(c);
+        if (!inString && depth == 0 && (ch == ',' || ch == ']') && !text.empty()) {
+            buffer->sungetc();
+            break;
+        }
+
+        text += ch;
+        if (inString) {
+            if (escaped) escaped = false;
+            else if (ch == '\\') escaped = true;
+            else if (ch == '"') inString = false;
+        } else if (ch == '"') {
+            inString = true;
+        } else if (ch == '{' || ch == '[') {
+            ++depth;
+        } else if (ch == '}' || ch == ']') {
+            if (--depth == 0) break;
+        }
+    }
+    return true;
+}
+
+// ========== FormatConverter ==========
+
+std::string ConversionReport::summary() const {
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed << "Converted " << records << " records (" << skipped << " skipped) in "
+        << seconds << " s, " << recordsPerSecond() << " records/s";
+    return out.str();
+}
+
+FormatConverter::FormatConverter() {}
+
+FormatConverter::FormatConverter(Options options) : options(options) {
+    if (options.bufferSize == 0) throw std::invalid_argument("Buffer size must be positive");
+}
+
+StorageFormat FormatConverter::formatOf(const std::string& fileName) {
+    if (endsWith(fileName, ".csv")) return StorageFormat::Csv;
+    if (endsWith(fileName, ".json")) return StorageFormat::JsonArray;
+    if (endsWith(fileName, ".ndjson") || endsWith(fileName, ".jsonl")) return StorageFormat::Ndjson;
+    throw std::invalid_argument("Unknown catalog format: " + fileName);
+}
+
+std::unique_ptr<Repository> FormatConverter::openRepository(const std::string& fileName) {
+    switch (formatOf(fileName)) {
+    case StorageFormat::Csv: return std::make_unique<CSVRepository>(fileName);
+    case StorageFormat::JsonArray: return std::make_unique<JSONRepository>(QString::fromStdString(fileName));
+    case StorageFormat::Ndjson: return std::make_unique<NDJSONRepository>(QString::fromStdString(fileName));
+    }
+    return nullptr;
+}
+
+ConversionReport FormatConverter::convert(std::istream& in, StorageFormat from, std::ostream& out, StorageFormat to) const {
+    auto started = std::chrono::steady_clock::now();
+
+    BookReader reader(in, from);
+    BookExporter writer(out, to, options.bufferSize);
+    Book book;
+    while (reader.next(book)) writer.write(book);
+
+    ConversionReport report;
+    report.records = writer.finish();
+    report.skipped = reader.skipped();
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
+
+ConversionReport FormatConverter::convert(const std::string& source, const std::string& destination) const {
+    StorageFormat from = formatOf(source);
+    StorageFormat to = formatOf(destination);
+    if (source == destination) throw std::invalid_argument("Source and destination are the same file");
+
+    std::ifstream plainIn;
+    std::unique_ptr<BlockFile::ReadBuffer> compressedIn;
+    std::istream in(nullptr);
+    if (BlockFile::detect(source)) {
+        compressedIn = std::make_unique<BlockFile::ReadBuffer>(source);
+        in.rdbuf(compressedIn.get());
+    } else {
+        plainIn.open(source, std::ios::binary);
+        if (!plainIn.is_open()) throw std::runtime_error("Failed to open catalog for conversion: " + source);
+        in.rdbuf(plainIn.rdbuf());
+    }
+
+    const std::string temporary = destination + ".tmp";
+    ConversionReport report;
+    try {
+        if (options.compress) {
+            BlockFile::WriteBuffer compressedOut(temporary);
+            std::ostream out(&compressedOut);
+            report = convert(in, from, out, to);
+            compressedOut.close();
+        } else {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) throw std::runtime_error("Failed to open catalog for writing: " + destination);
+            report = convert(in, from, out, to);
+            out.close();
+            if (!out) throw std::runtime_error("Failed to write catalog: " + destination);
+        }
+    } catch (...) {
+        std::remove(temporary.c_str());
+        throw;
+    }
+
+    if (std::rename(temporary.c_str(), destination.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Failed to replace catalog: " + destination);
+    }
+
+    // Carry the id high-water mark over so deleted ids stay retired
+    std::ifstream ids(source + ".ids", std::ios::binary);
+    if (ids.is_open()) {
+        std::ofstream copy(destination + ".ids", std::ios::binary | std::ios::trunc);
+        copy << ids.rdbuf();
+    }
+    return report;
+}
@@ -0,0 +1,94 @@
+#ifndef CONVERTER_H
+#define CONVERTER_H
+
+#include "book.h"
+#include "exporter.h"
+#include "repository.h"
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+// The repository file formats, in the exporter's terms: CSV, a JSON array
+// (JSONRepository) and JSON lines (NDJSONRepository)
+using StorageFormat = ExportFormat;
+
+// Reads books one at a time from a stream in one of the repository formats.
+// JSON arrays are scanned incrementally, one object at a time, so memory use
+// does not depend on the size of the input. Malformed records are skipped
+// and counted, as the repositories skip them on load.
+//
+// NDJSON sources are read twice: a first pass finds the last record for
+// every id, so that records replaced or deleted by a later line are skipped
+// as NDJSONRepository resolves them. This needs a seekable stream and
+// memory for the ids, not the books. A replaced book comes out where its
+// last record is rather than where it was first added.
+class BookReader
+{
+public:
+    BookReader(std::istream& in, StorageFormat format);
+
+    bool next(Book& book); // false at the end of the input
+    std::size_t skipped() const { return skippedRecords; }
+
+private:
+    std::istream& in;
+    StorageFormat format;
+    std::size_t skippedRecords = 0;
+    bool started = false;
+    bool ended = false;
+    std::string text;
+    std::unordered_map<int, std::size_t> lastRecords; // NDJSON only: line of the last record per id
+    std::size_t line = 0;
+
+    bool nextCsv(Book& book);
+    bool nextNdjson(Book& book);
+    void indexNdjson();
+    bool nextJson(Book& book);
+    bool readJsonValue(); // next array element into text; false at the closing bracket
+};
+
+struct ConversionReport
+{
+    std::size_t records = 0;
+    std::size_t skipped = 0;  // malformed source records
+    double seconds = 0;
+
+    double recordsPerSecond() const { return seconds > 0 ? records / seconds : 0; }
+    std::string summary() const;
+};
+
+// Converts catalog files between repository formats in a single streaming
+// pass: each book is read, written and forgotten, so a catalog of any size
+// converts in constant memory. Compressed sources (see BlockFile) are
+// detected; the destination is compressed on request. The destination is
+// written under a temporary name and only replaces an existing file once the
+// conversion has succeeded.
+class FormatConverter
+{
+public:
+    struct Options
+    {
+        bool compress = false;              // write a block-compressed destination
+        std::size_t bufferSize = 1 << 20;   // output buffer
+    };
+
+    FormatConverter();
+    explicit FormatConverter(Options options);
+
+    // From the extension: .csv, .json, or .ndjson/.jsonl; throws std::invalid_argument
+    static StorageFormat formatOf(const std::string& fileName);
+    // The repository for a catalog file, chosen by formatOf
+    static std::unique_ptr<Repository> openRepository(const std::string& fileName);
+
+    ConversionReport convert(const std::string& source, const std::string& destination) const;
+    ConversionReport convert(std::istream& in, StorageFormat from, std::ostream& out, StorageFormat to) const;
+
+private:
+    Options options;
+};
+
+#endif // CONVERTER_H
@@ -0,0 +1,194 @@
+#include "csvimporter.h"
+#include "csvrepository.h"
+
+#include <chrono>
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+
+struct ParsedChunk
+{
+    std::vector<Book> books;
+    std::vector<std::size_t> bookLines; // chunk-relative line of each book
+    std::vector<ImportError> errors;    // chunk-relative lines
+    std::size_t rows = 0;
+    std::size_t lines = 0;
+};
+
+ParsedChunk parseChunk(const std::string& text) {
+    ParsedChunk chunk;
+    std::size_t start = 0;
+    std::string line;
+    while (start < text.size()) {
+        std::size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        line.assign(text, start, end - start);
+        start = end + 1;
+        ++chunk.lines;
+
+        if (line.empty() || line == "\r") continue;
+        ++chunk.rows;
+        try {
+            chunk.books.push_back(CSVRepository::parseLine(line));
+            chunk.bookLines.push_back(chunk.lines);
+        } catch (const std::exception& e) {
+            chunk.errors.push_back({chunk.lines, e.what()});
+        }
+    }
+    return chunk;
+}
+
+}
+
+std::string ImportReport::summary() const {
+    std::ostringstream out;
+    out.precision(1);
+    out << std::fixed << "Imported " << imported << " of " << rows << " rows ("
+        << duplicates << " duplicates, " << invalid << " invalid) in " << seconds << " s, "
+        << rowsPerSecond() << " rows/s, " << megabytesPerSecond() << " MB/s";
+    return out.str();
+}
+
+CsvImporter::CsvImporter() {}
+
+CsvImporter::CsvImporter(Options options) : options(options) {
+    if (options.chunkSize == 0) throw std::invalid_argument("Chunk size must be positive");
+}
+
+ImportReport CsvImporter::importFile(const std::string& fileName, Repository& repo) const {
+    return apply(parseFile(fileName), repo);
+}
+
+CsvImporter::ParsedFile CsvImporter::parseFile(const std::string& fileName) const {
+    auto started = std::chrono::steady_clock::now();
+
+    std::ifstream in{fileName, std::ios::binary};
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open CSV file for import: " + fileName);
+    }
+
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    ParsedFile parsed;
+    ImportReport& report = parsed.report;
+    std::unordered_set<int> seen;
+
+    std::size_t lineOffset = 0;
+    auto note = [&report, this](std::size_t line, std::string message) {
+        if (report.errors.size() < options.maxReportedErrors) report.errors.push_back({line, std::move(message)});
+    };
+
+    // Merging runs on this thread in file order, so ids and line numbers are
+    // resolved exactly as a sequential load would
+    auto merge = [&](ParsedChunk chunk) {
+        report.rows += chunk.rows;
+        auto error = chunk.errors.begin();
+        for (std::size_t i = 0; i < chunk.books.size(); ++i) {
+            for (; error != chunk.errors.end() && error->line < chunk.bookLines[i]; ++error) {
+                ++report.invalid;
+                note(lineOffset + error->line, std::move(error->message));
+            }
+            Book& book = chunk.books[i];
+            if (!seen.insert(book.getId()).second) {
+                ++report.duplicates;
+                note(lineOffset + chunk.bookLines[i], "Duplicate id " + std::to_string(book.getId()));
+                continue;
+            }
+            parsed.books.push_back(std::move(book));
+            parsed.lines.push_back(lineOffset + chunk.bookLines[i]);
+        }
+        for (; error != chunk.errors.end(); ++error) {
+            ++report.invalid;
+            note(lineOffset + error->line, std::move(error->message));
+        }
+        lineOffset += chunk.lines;
+    };
+
+    std::deque<std::future<ParsedChunk>> inFlight;
+    std::string carry;
+    std::vector<char> buffer(options.chunkSize);
+    while (in) {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        std::size_t got = static_cast<std::size_t>(in.gcount());
+        if (got == 0) break;
+        report.bytes += got;
+
+        // Cut after the last newline; the partial line starts the next chunk
+        std::string text = std::move(carry);
+        text.append(buffer.data(), got);
+        std::size_t cut = text.rfind('\n');
+        if (cut == std::string::npos) {
+            carry = std::move(text);
+            continue;
+        }
+        carry.assign(text, cut + 1, std::string::npos);
+        text.resize(cut + 1);
+
+        if (inFlight.size() >= threads) {
+            merge(inFlight.front().get());
+            inFlight.pop_front();
+        }
+        inFlight.push_back(std::async(std::launch::async, [chunk = std::move(text)] { return parseChunk(chunk); }));
+    }
+    if (!carry.empty()) inFlight.push_back(std::async(std::launch::async, [chunk = std::move(carry)] { return parseChunk(chunk); }));
+
+    for (auto& pending : inFlight) merge(pending.get());
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return parsed;
+}
+
+ImportReport CsvImporter::apply(ParsedFile parsed, Repository& repo) const {
+    auto started = std::chrono::steady_clock::now();
+    ImportReport report = std::move(parsed.report);
+
+    std::unordered_set<int> existing;
+    repo.forEach([&existing](const Book& book) { existing.insert(book.getId()); });
+
+    std::vector<Book> accepted;
+    accepted.reserve(parsed.books.size());
+    for (std::size_t i = 0; i < parsed.books.size(); ++i) {
+        Book& book = parsed.books[i];
+        if (existing.count(book.getId())) {
+            ++report.duplicates;
+            report.errors.push_back({parsed.lines[i], "Duplicate id " + std::to_string(book.getId())});
+            continue;
+        }
+        accepted.push_back(std::move(book));
+    }
+
+    // Keep the first few rejected rows in file order. Rows dropped while
+    // parsing come after every row kept then, so none of them belongs here.
+    std::stable_sort(report.errors.begin(), report.errors.end(),
+                     [](const ImportError& a, const ImportError& b) { return a.line < b.line; });
+    if (report.errors.size() > options.maxReportedErrors) report.errors.resize(options.maxReportedErrors);
+
+    repo.beginBatch();
+    std::size_t added = 0;
+    try {
+        for (const auto& book : accepted) {
+            repo.add(book);
+            ++added;
+        }
+    } catch (...) {
+        // All or nothing: take the added books out before the batch is written
+        try {
+            while (added > 0) repo.remove(accepted[--added].getId());
+        } catch (...) {
+        }
+        repo.endBatch();
+        throw;
+    }
+    repo.endBatch();
+    report.imported = accepted.size();
+
+    report.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
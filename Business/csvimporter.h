@@ -0,0 +1,67 @@
+#ifndef CSVIMPORTER_H
+#define CSVIMPORTER_H
+
+#include "repository.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct ImportError
+{
+    std::size_t line;    // 1-based line in the input file
+    std::string message;
+};
+
+struct ImportReport
+{
+    std::size_t rows = 0;        // non-blank lines read
+    std::size_t imported = 0;
+    std::size_t duplicates = 0;  // ids already in the repository or earlier in the file
+    std::size_t invalid = 0;
+    std::size_t bytes = 0;
+    double seconds = 0;
+    std::vector<ImportError> errors; // first few duplicate/invalid rows, in file order
+
+    double rowsPerSecond() const { return seconds > 0 ? rows / seconds : 0; }
+    double megabytesPerSecond() const { return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0; }
+    std::string summary() const;
+};
+
+// Bulk loader for large CSV dumps in the CSVRepository format. The file is
+// read in chunks cut at line boundaries; chunks are parsed and validated on
+// worker threads while the next ones are read, then merged in file order,
+// deduplicated by id and added to the repository inside a single batch, so
+// the repository is written out once. If an add fails, the books already
+// added are removed again before the exception is passed on, so an import
+// goes in whole or not at all.
+class CsvImporter
+{
+public:
+    struct Options
+    {
+        std::size_t chunkSize = 8 * 1024 * 1024;
+        unsigned threads = 0;               // 0: one per hardware thread
+        std::size_t maxReportedErrors = 100;
+    };
+
+    CsvImporter();
+    explicit CsvImporter(Options options);
+
+    ImportReport importFile(const std::string& fileName, Repository& repo) const;
+
+    // The two halves of importFile(). Parsing does not touch the repository,
+    // so a caller can run it before taking its write lock.
+    struct ParsedFile
+    {
+        ImportReport report;            // rows, bytes, invalid rows and duplicates within the file
+        std::vector<Book> books;
+        std::vector<std::size_t> lines; // file line of each book
+    };
+    ParsedFile parseFile(const std::string& fileName) const;
+    ImportReport apply(ParsedFile parsed, Repository& repo) const; // rejects ids already in repo
+private:
+    Options options;
+};
+
+#endif // CSVIMPORTER_H
@@ -0,0 +1,166 @@
+#include "deltasync.h"
+#include "catalogsync.h"
+
+#include <algorithm>
+#include <future>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Spreads the record hashes over all 64 bits so that sums of them collide
+// no more often than the hashes themselves
+std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+void writeQuoted(std::ostream& out, const char* key, const std::string& value) {
+    out << ' ' << key << "=\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+void writeFields(std::ostream& out, const Book& book) {
+    out << " id=" << book.getId();
+    writeQuoted(out, "title", book.getTitle());
+    writeQuoted(out, "author", book.getAuthor());
+    writeQuoted(out, "genre", book.getGenre());
+    out << " year=" << book.getYear() << '\n';
+}
+
+}
+
+std::string SyncDelta::summary() const {
+    std::ostringstream out;
+    out << added.size() << " added, " << updated.size() << " updated, " << removed.size() << " removed";
+    return out.str();
+}
+
+void SyncDelta::writeScript(std::ostream& out) const {
+    for (int id : removed) out << "remove id=" << id << '\n';
+    for (const auto& book : updated) {
+        out << "update";
+        writeFields(out, book);
+    }
+    for (const auto& book : added) {
+        out << "add";
+        writeFields(out, book);
+    }
+}
+
+HashTree::HashTree(std::vector<Book> catalog) : books(std::move(catalog)) {
+    auto byId = [](const Book& a, const Book& b) { return a.getId() < b.getId(); };
+    if (!std::is_sorted(books.begin(), books.end(), byId)) std::stable_sort(books.begin(), books.end(), byId);
+
+    // Hashing dominates building; large catalogs are hashed in parallel chunks
+    const std::size_t minChunk = 1 << 16;
+    std::size_t count = books.size();
+    ids.resize(count);
+    hashes.resize(count);
+    auto hashRange = [this](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            ids[i] = books[i].getId();
+            hashes[i] = mix(CatalogSync::hash(books[i]));
+        }
+    };
+    std::size_t chunks = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                               (count + minChunk - 1) / minChunk);
+    if (chunks <= 1) {
+        hashRange(0, count);
+    } else {
+        std::vector<std::future<void>> parts;
+        std::size_t step = (count + chunks - 1) / chunks;
+        for (std::size_t first = step; first < count; first += step) {
+            parts.push_back(std::async(std::launch::async, hashRange, first, std::min(first + step, count)));
+        }
+        hashRange(0, step);
+        for (auto& part : parts) part.get();
+    }
+
+    prefix.resize(count + 1);
+    prefix[0] = 0;
+    for (std::size_t i = 0; i < count; ++i) prefix[i + 1] = prefix[i] + hashes[i];
+}
+
+SyncDelta HashTree::diff(const HashTree& target, Stats* stats) const {
+    SyncDelta delta;
+    Stats counted;
+    if (!ids.empty() || !target.ids.empty()) {
+        std::int64_t low = std::min(ids.empty() ? target.ids.front() : ids.front(),
+                                    target.ids.empty() ? ids.front() : target.ids.front());
+        std::int64_t high = std::max(ids.empty() ? target.ids.back() : ids.back(),
+                                     target.ids.empty() ? ids.back() : target.ids.back());
+        diffRange(target, low, high + 1, delta, counted);
+    }
+    if (stats) *stats = counted;
+    return delta;
+}
+
+std::pair<std::size_t, std::size_t> HashTree::span(std::int64_t low, std::int64_t high) const {
+    auto first = std::lower_bound(ids.begin(), ids.end(), low, [](int id, std::int64_t bound) { return id < bound; });
+    auto last = std::lower_bound(first, ids.end(), high, [](int id, std::int64_t bound) { return id < bound; });
+    return {static_cast<std::size_t>(first - ids.begin()), static_cast<std::size_t>(last - ids.begin())};
+}
+
+void HashTree::diffRange(const HashTree& target, std::int64_t low, std::int64_t high,
+                         SyncDelta& delta, Stats& stats) const {
+    auto mine = span(low, high);
+    auto theirs = target.span(low, high);
+    std::size_t myCount = mine.second - mine.first;
+    std::size_t theirCount = theirs.second - theirs.first;
+    ++stats.rangesCompared;
+
+    if (myCount == theirCount && rangeHash(mine) == target.rangeHash(theirs)) return;
+
+    if (myCount <= LeafSize || theirCount <= LeafSize || high - low <= Fanout) {
+        diffRecords(target, mine, theirs, delta, stats);
+        return;
+    }
+
+    std::int64_t step = (high - low + Fanout - 1) / Fanout;
+    for (std::int64_t child = low; child < high; child += step) {
+        diffRange(target, child, std::min(child + step, high), delta, stats);
+    }
+}
+
+void HashTree::diffRecords(const HashTree& target, std::pair<std::size_t, std::size_t> mine,
+                           std::pair<std::size_t, std::size_t> theirs, SyncDelta& delta, Stats& stats) const {
+    std::size_t i = mine.first;
+    std::size_t j = theirs.first;
+    while (i < mine.second || j < theirs.second) {
+        ++stats.recordsCompared;
+        if (j == theirs.second || (i < mine.second && ids[i] < target.ids[j])) {
+            delta.added.push_back(books[i++]);
+        } else if (i == mine.second || target.ids[j] < ids[i]) {
+            delta.removed.push_back(target.ids[j++]);
+        } else {
+            if (hashes[i] != target.hashes[j]) delta.updated.push_back(books[i]);
+            ++i;
+            ++j;
+        }
+    }
+}
+
+std::size_t applyDelta(Controller& target, const SyncDelta& delta) {
+    if (delta.empty()) return 0;
+
+    target.beginTransaction();
+    try {
+        for (int id : delta.removed) target.removeBook(id);
+        for (const auto& book : delta.updated) target.updateBook(book);
+        for (const auto& book : delta.added) target.addBook(book);
+    } catch (...) {
+        target.rollbackTransaction();
+        throw;
+    }
+    target.commitTransaction();
+    return delta.size();
+}
@@ -0,0 +1,74 @@
+#ifndef DELTASYNC_H
+#define DELTASYNC_H
+
+#include "book.h"
+#include "controller.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The changes that turn a target catalog into a source catalog
+struct SyncDelta
+{
+    std::vector<Book> added;    // only in the source
+    std::vector<Book> updated;  // in both but different; the source's version
+    std::vector<int> removed;   // only in the target
+
+    bool empty() const { return added.empty() && updated.empty() && removed.empty(); }
+    std::size_t size() const { return added.size() + updated.size() + removed.size(); }
+    std::string summary() const;
+
+    // As BatchProcessor commands (add/update/remove id=N), one per line
+    void writeScript(std::ostream& out) const;
+};
+
+// A catalog in id order with an implicit hash tree over id ranges. A range's
+// hash is the sum of its records' hashes, read off prefix sums, so building
+// costs one hash per book and no tree nodes are stored. Comparing two trees
+// starts at the whole id range and splits only the ranges whose record count
+// or hash differ, so nearly identical catalogs are compared in a handful of
+// range lookups plus the records that actually changed.
+class HashTree
+{
+public:
+    struct Stats
+    {
+        std::size_t rangesCompared = 0;
+        std::size_t recordsCompared = 0;
+    };
+
+    explicit HashTree(std::vector<Book> books); // sorted by id unless already in id order
+
+    std::size_t size() const { return books.size(); }
+    std::uint64_t rootHash() const { return prefix.back(); }
+
+    // The delta that turns target into this catalog
+    SyncDelta diff(const HashTree& target, Stats* stats = nullptr) const;
+
+private:
+    static constexpr std::int64_t Fanout = 16;
+    static constexpr std::size_t LeafSize = 32; // ranges this small are compared record by record
+
+    std::vector<Book> books;
+    std::vector<int> ids;
+    std::vector<std::uint64_t> hashes;
+    std::vector<std::uint64_t> prefix;          // prefix[i] = sum of hashes[0..i)
+
+    std::pair<std::size_t, std::size_t> span(std::int64_t low, std::int64_t high) const; // ids in [low, high)
+    std::uint64_t rangeHash(std::pair<std::size_t, std::size_t> range) const {
+        return prefix[range.second] - prefix[range.first];
+    }
+    void diffRange(const HashTree& target, std::int64_t low, std::int64_t high, SyncDelta& delta, Stats& stats) const;
+    void diffRecords(const HashTree& target, std::pair<std::size_t, std::size_t> mine,
+                     std::pair<std::size_t, std::size_t> theirs, SyncDelta& delta, Stats& stats) const;
+};
+
+// Applies a delta as one transaction: written once and undone in one step.
+// Returns the number of changes made.
+std::size_t applyDelta(Controller& target, const SyncDelta& delta);
+
+#endif // DELTASYNC_H
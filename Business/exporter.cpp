@@ -0,0 +1,158 @@
+#include "exporter.h"
+#include "catalogsnapshot.h"
+
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+// ========== BufferedWriter ==========
+
+BufferedWriter::BufferedWriter(std::ostream& out, std::size_t capacity)
+    : out(out), buffer(capacity > 0 ? capacity : 1) {}
+
+BufferedWriter::~BufferedWriter() {
+    try {
+        flush();
+    } catch (...) {
+        // Callers that care flush explicitly and see the error there
+    }
+}
+
+void BufferedWriter::write(const char* data, std::size_t size) {
+    if (used + size > buffer.size()) {
+        flush();
+        // Larger than the whole buffer; pass it straight through
+        if (size > buffer.size()) {
+            out.write(data, static_cast<std::streamsize>(size));
+            if (!out) throw std::runtime_error("Failed to write export output.");
+            return;
+        }
+    }
+    std::memcpy(buffer.data() + used, data, size);
+    used += size;
+}
+
+void BufferedWriter::put(char c) {
+    if (used == buffer.size()) flush();
+    buffer[used++] = c;
+}
+
+void BufferedWriter::writeInt(int value) {
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    write(digits, static_cast<std::size_t>(result.ptr - digits));
+}
+
+void BufferedWriter::flush() {
+    if (used > 0) {
+        out.write(buffer.data(), static_cast<std::streamsize>(used));
+        used = 0;
+    }
+    out.flush();
+    if (!out) throw std::runtime_error("Failed to write export output.");
+}
+
+// ========== BookExporter ==========
+
+BookExporter::BookExporter(std::ostream& out, ExportFormat format, std::size_t bufferSize)
+    : writer(out, bufferSize), format(format) {
+    if (format == ExportFormat::JsonArray) writer.put('[');
+}
+
+void BookExporter::write(const Book& book) {
+    if (finished) throw std::logic_error("Export already finished");
+
+    switch (format) {
+    case ExportFormat::Csv:
+        writer.writeInt(book.getId());
+        writer.put(',');
+        writer.write(book.getTitle());
+        writer.put(',');
+        writer.write(book.getAuthor());
+        writer.put(',');
+        writer.write(book.getGenre());
+        writer.put(',');
+        writer.writeInt(book.getYear());
+        writer.put('\n');
+        break;
+    case ExportFormat::JsonArray:
+        writer.write(count == 0 ? "\n    " : ",\n    ", count == 0 ? 5 : 6);
+        writeJsonObject(book);
+        break;
+    case ExportFormat::Ndjson:
+        writeJsonObject(book);
+        writer.put('\n');
+        break;
+    }
+    ++count;
+}
+
+std::size_t BookExporter::finish() {
+    if (!finished) {
+        if (format == ExportFormat::JsonArray) writer.write(count == 0 ? "]\n" : "\n]\n", count == 0 ? 2 : 3);
+        finished = true;
+    }
+    writer.flush();
+    return count;
+}
+
+void BookExporter::writeJsonObject(const Book& book) {
+    writer.write("{\"id\":", 6);
+    writer.writeInt(book.getId());
+    writer.write(",\"title\":", 9);
+    writeJsonString(book.getTitle());
+    writer.write(",\"author\":", 10);
+    writeJsonString(book.getAuthor());
+    writer.write(",\"genre\":", 9);
+    writeJsonString(book.getGenre());
+    writer.write(",\"year\":", 8);
+    writer.writeInt(book.getYear());
+    writer.put('}');
+}
+
+void BookExporter::writeJsonString(const std::string& text) {
+    static const char hex[] = "0123456789abcdef";
+
+    writer.put('"');
+    for (char c : text) {
+        switch (c) {
+        case '"': writer.write("\\\"", 2); break;
+        case '\\': writer.write("\\\\", 2); break;
+        case '\n': writer.write("\\n", 2); break;
+        case '\r': writer.write("\\r", 2); break;
+        case '\t': writer.write("\\t", 2); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[6] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0xF], hex[c & 0xF]};
+                writer.write(escaped, sizeof(escaped));
+            } else {
+                writer.put(c); // UTF-8 passes through unchanged
+            }
+        }
+    }
+    writer.put('"');
+}
+
+namespace {
+
+template <typename Books>
+std::size_t exportAll(const Books& books, std::ostream& out, ExportFormat format,
+                      const std::function<bool(const Book&)>& filterFn) {
+    BookExporter exporter(out, format);
+    for (const auto& book : books) {
+        if (!filterFn || filterFn(book)) exporter.write(book);
+    }
+    return exporter.finish();
+}
+
+}
+
+std::size_t exportBooks(const std::vector<Book>& books, std::ostream& out, ExportFormat format,
+                        const std::function<bool(const Book&)>& filterFn) {
+    return exportAll(books, out, format, filterFn);
+}
+
+std::size_t exportBooks(const CatalogSnapshot& books, std::ostream& out, ExportFormat format,
+                        const std::function<bool(const Book&)>& filterFn) {
+    return exportAll(books, out, format, filterFn);
+}
@@ -0,0 +1,68 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include "book.h"
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class CatalogSnapshot;
+
+enum class ExportFormat { Csv, JsonArray, Ndjson };
+
+// Accumulates output in a fixed buffer and hands it to the stream in large
+// blocks. Memory use does not depend on how much is written.
+class BufferedWriter
+{
+public:
+    explicit BufferedWriter(std::ostream& out, std::size_t capacity = 1 << 20);
+    ~BufferedWriter();
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    void write(const char* data, std::size_t size);
+    void write(const std::string& text) { write(text.data(), text.size()); }
+    void put(char c);
+    void writeInt(int value);
+    void flush(); // throws std::runtime_error if the stream fails
+
+private:
+    std::ostream& out;
+    std::vector<char> buffer;
+    std::size_t used = 0;
+};
+
+// Writes books one at a time in a format the repositories can read back:
+// CSV as CSVRepository stores it, a JSON array of book objects as
+// JSONRepository stores it, or one such object per line (NDJSON).
+class BookExporter
+{
+public:
+    BookExporter(std::ostream& out, ExportFormat format, std::size_t bufferSize = 1 << 20);
+
+    void write(const Book& book);
+    std::size_t finish(); // closes the document and flushes; returns the number of books written
+
+    std::size_t written() const { return count; }
+
+private:
+    BufferedWriter writer;
+    ExportFormat format;
+    std::size_t count = 0;
+    bool finished = false;
+
+    void writeJsonString(const std::string& text);
+    void writeJsonObject(const Book& book);
+};
+
+// Streams the books accepted by filterFn (all when it is empty) to out
+std::size_t exportBooks(const std::vector<Book>& books, std::ostream& out, ExportFormat format,
+                        const std::function<bool(const Book&)>& filterFn = nullptr);
+std::size_t exportBooks(const CatalogSnapshot& books, std::ostream& out, ExportFormat format,
+                        const std::function<bool(const Book&)>& filterFn = nullptr);
+
+#endif // EXPORTER_H
@@ -0,0 +1,191 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// The mutex guards the map only; what every finished timer touches is atomic
+struct Registry
+{
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+    std::atomic<const std::string*> lastName{nullptr};
+
+    std::atomic<bool> stallEnabled{false};
+    std::atomic<std::uint64_t> stallThreshold{0};
+    std::shared_ptr<const Metrics::StallHandler> stallHandler; // std::atomic_load/atomic_store only
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// Taken during static initialization, before main() runs
+const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+
+struct StartupPhases
+{
+    std::mutex mutex;
+    std::vector<StartupProfile::Phase> phases;
+};
+
+StartupPhases& startupPhases() {
+    static StartupPhases instance;
+    return instance;
+}
+
+}
+
+// ========== LatencyHistogram ==========
+
+int LatencyHistogram::bucketFor(std::uint64_t micros) {
+    if (micros < static_cast<std::uint64_t>(SubBuckets)) return static_cast<int>(micros);
+
+    int magnitude = 63;
+    while (!(micros >> magnitude)) --magnitude;
+    int shift = magnitude - SubBucketBits;
+    int sub = static_cast<int>((micros >> shift) & (SubBuckets - 1));
+    return (shift + 1) * SubBuckets + sub;
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(int bucket) {
+    if (bucket < SubBuckets) return static_cast<std::uint64_t>(bucket);
+
+    int shift = bucket / SubBuckets - 1;
+    std::uint64_t sub = static_cast<std::uint64_t>(bucket % SubBuckets);
+    return ((SubBuckets + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t micros) {
+    buckets[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    lastValue.store(micros, std::memory_order_relaxed);
+
+    std::uint64_t seen = maxValue.load(std::memory_order_relaxed);
+    while (micros > seen && !maxValue.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {}
+}
+
+std::uint64_t LatencyHistogram::percentile(double p) const {
+    std::uint64_t n = count();
+    if (n == 0) return 0;
+
+    std::uint64_t rank = static_cast<std::uint64_t>(std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(n));
+    rank = std::max<std::uint64_t>(rank, 1);
+
+    std::uint64_t seen = 0;
+    for (int bucket = 0; bucket < BucketCount; ++bucket) {
+        seen += buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(bucketUpperBound(bucket), max());
+    }
+    return max();
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    lastValue.store(0, std::memory_order_relaxed);
+    maxValue.store(0, std::memory_order_relaxed);
+}
+
+// ========== Metrics ==========
+
+LatencyHistogram& Metrics::histogram(const std::string& name) {
+    const std::string* key = nullptr;
+    return histogram(name, key);
+}
+
+Metrics::Site Metrics::site(const std::string& name) {
+    Site site{nullptr, nullptr};
+    site.histogram = &histogram(name, site.name);
+    return site;
+}
+
+LatencyHistogram& Metrics::histogram(const std::string& name, const std::string*& key) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto it = r.histograms.find(name);
+    if (it == r.histograms.end()) it = r.histograms.emplace(name, std::make_unique<LatencyHistogram>()).first;
+    key = &it->first;
+    return *it->second;
+}
+
+std::vector<std::string> Metrics::names() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<std::string> result;
+    for (const auto& entry : r.histograms) result.push_back(entry.first);
+    return result;
+}
+
+std::string Metrics::lastOperation() {
+    const std::string* name = registry().lastName.load(std::memory_order_acquire);
+    return name ? *name : std::string();
+}
+
+void Metrics::setStallHandler(std::uint64_t thresholdMicros, StallHandler handler) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.stallEnabled.store(false, std::memory_order_release);
+    r.stallThreshold.store(thresholdMicros, std::memory_order_relaxed);
+    std::shared_ptr<const StallHandler> shared;
+    if (handler) shared = std::make_shared<const StallHandler>(std::move(handler));
+    std::atomic_store(&r.stallHandler, shared);
+    r.stallEnabled.store(shared != nullptr, std::memory_order_release);
+}
+
+void Metrics::finished(const std::string* key, LatencyHistogram& histogram, std::uint64_t micros) {
+    histogram.record(micros);
+
+    Registry& r = registry();
+    r.lastName.store(key, std::memory_order_release);
+    if (!r.stallEnabled.load(std::memory_order_acquire) || micros < r.stallThreshold.load(std::memory_order_relaxed)) return;
+
+    // No lock is held, so the handler may query the registry
+    auto handler = std::atomic_load(&r.stallHandler);
+    if (handler) (*handler)(*key, micros);
+}
+
+// ========== StartupProfile ==========
+
+void StartupProfile::mark(const std::string& phase) {
+    StartupPhases& s = startupPhases();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+    for (const auto& recorded : s.phases) {
+        if (recorded.name == phase) return;
+    }
+    s.phases.push_back({phase, millis});
+}
+
+std::vector<StartupProfile::Phase> StartupProfile::phases() {
+    StartupPhases& s = startupPhases();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.phases;
+}
+
+std::string StartupProfile::report() {
+    std::string text;
+    double previous = 0;
+    for (const auto& phase : phases()) {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%9.1f ms  (+%8.1f ms)  %s\n", phase.millis, phase.millis - previous, phase.name.c_str());
+        text += line;
+        previous = phase.millis;
+    }
+    return text;
+}
+
+// ========== ScopedTimer ==========
+
+ScopedTimer::ScopedTimer(const std::string& name)
+    : key(nullptr), histogram(Metrics::histogram(name, key)), start(std::chrono::steady_clock::now()) {}
+
+ScopedTimer::ScopedTimer(const Metrics::Site& site)
+    : key(site.name), histogram(*site.histogram), start(std::chrono::steady_clock::now()) {}
+
+ScopedTimer::~ScopedTimer() {
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    Metrics::finished(key, histogram, static_cast<std::uint64_t>(elapsed.count()));
+}
@@ -0,0 +1,115 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Lock-free latency histogram with log-linear buckets: every power of two
+// is split into SubBuckets linear steps, so percentiles are exact to within
+// 1/SubBuckets of the value. Values are in microseconds.
+class LatencyHistogram
+{
+public:
+    void record(std::uint64_t micros);
+
+    std::uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    std::uint64_t last() const { return lastValue.load(std::memory_order_relaxed); }
+    std::uint64_t max() const { return maxValue.load(std::memory_order_relaxed); }
+    std::uint64_t percentile(double p) const; // upper bound of the bucket holding the p-th percentile
+    void reset();
+
+private:
+    static constexpr int SubBucketBits = 3;
+    static constexpr int SubBuckets = 1 << SubBucketBits;
+    static constexpr int BucketCount = SubBuckets * 64;
+
+    std::array<std::atomic<std::uint64_t>, BucketCount> buckets{};
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<std::uint64_t> lastValue{0};
+    std::atomic<std::uint64_t> maxValue{0};
+
+    static int bucketFor(std::uint64_t micros);
+    static std::uint64_t bucketUpperBound(int bucket);
+};
+
+// Process-wide registry of named histograms. Histograms are created on first
+// use and live until exit, so references to them stay valid.
+class Metrics
+{
+public:
+    // A histogram looked up once, for timers on hot paths: a ScopedTimer
+    // built from a Site takes no lock and does no lookup
+    struct Site
+    {
+        const std::string* name; // the registry's copy
+        LatencyHistogram* histogram;
+    };
+
+    static LatencyHistogram& histogram(const std::string& name);
+    static Site site(const std::string& name);
+    static std::vector<std::string> names();
+
+    // Name and duration of the most recent measurement
+    static std::string lastOperation();
+
+    // Called from ScopedTimer for every measurement over the threshold
+    using StallHandler = std::function<void(const std::string& operation, std::uint64_t micros)>;
+    static void setStallHandler(std::uint64_t thresholdMicros, StallHandler handler);
+
+private:
+    friend class ScopedTimer;
+    static LatencyHistogram& histogram(const std::string& name, const std::string*& key);
+    static void finished(const std::string* key, LatencyHistogram& histogram, std::uint64_t micros);
+};
+
+// Wall-clock milestones of application startup. Each phase is recorded the
+// first time it is marked, with its offset from process start, so later
+// repository switches do not overwrite the cold start. Thread-safe.
+class StartupProfile
+{
+public:
+    struct Phase
+    {
+        std::string name;
+        double millis; // since process start
+    };
+
+    static void mark(const std::string& phase);
+    static std::vector<Phase> phases();
+    static std::string report(); // one line per phase: offset and time since the previous phase
+};
+
+// Measures the enclosing scope and records it under the given name.
+// SCOPED_TIMER("Class::method") resolves the name once per call site; the
+// string constructor looks it up on every call.
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const std::string& name);
+    explicit ScopedTimer(const Metrics::Site& site);
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    const std::string* key; // the registry's copy of the name
+    LatencyHistogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define SCOPED_TIMER(name) \
+    static const Metrics::Site METRICS_CONCAT(timerSite_, __LINE__) = Metrics::site(name); \
+    ScopedTimer METRICS_CONCAT(scopedTimer_, __LINE__)(METRICS_CONCAT(timerSite_, __LINE__))
+
+#endif // METRICS_H
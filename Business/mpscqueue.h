@@ -0,0 +1,59 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <optional>
+
+// Unbounded lock-free multi-producer / single-consumer queue (Vyukov).
+// push() may be called from any thread and never blocks; pop() and empty()
+// must only be called from the one consumer thread.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : head(new Node), tail(head.load()) {}
+
+    ~MpscQueue() {
+        while (tail) {
+            Node* next = tail->next.load();
+            delete tail;
+            tail = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        Node* node = new Node;
+        node->value.emplace(std::move(value));
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_seq_cst);
+    }
+
+    bool pop(T& out) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+
+        out = std::move(*next->value);
+        next->value.reset();
+        delete tail;
+        tail = next; // the popped node becomes the new stub
+        return true;
+    }
+
+    bool empty() const {
+        return tail->next.load(std::memory_order_seq_cst) == nullptr;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::optional<T> value;
+    };
+
+    std::atomic<Node*> head; // last pushed node, shared by producers
+    Node* tail;              // stub node owned by the consumer
+};
+
+#endif // MPSCQUEUE_H
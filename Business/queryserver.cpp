@@ -0,0 +1,374 @@
+#include "queryserver.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        throw std::runtime_error(std::string("Failed to configure socket: ") + std::strerror(errno));
+    }
+}
+
+std::string firstWord(const std::string& line) {
+    std::istringstream in(line);
+    std::string word;
+    in >> word;
+    return word;
+}
+
+bool isBlank(const std::string& line) {
+    return line.find_first_not_of(" \t\r") == std::string::npos;
+}
+
+}
+
+QueryServer::QueryServer(Controller& controller, std::string socketPath)
+    : QueryServer(controller, std::move(socketPath), Options()) {}
+
+QueryServer::QueryServer(Controller& controller, std::string socketPath, Options options)
+    : socketPath(std::move(socketPath)), options(options), processor(controller), pipeline(controller) {
+    if (pipe(wakeFds) != 0) throw std::runtime_error(std::string("Failed to create wake pipe: ") + std::strerror(errno));
+    setNonBlocking(wakeFds[0]);
+    setNonBlocking(wakeFds[1]);
+}
+
+QueryServer::~QueryServer() {
+    stopWorkers();
+    pipeline.stop();
+    closeAll();
+    for (int fd : wakeFds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void QueryServer::stop() {
+    stopping = true;
+    char byte = 's';
+    ssize_t ignored = ::write(wakeFds[1], &byte, 1);
+    (void)ignored;
+}
+
+void QueryServer::run() {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Socket path is empty or too long: " + socketPath);
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    // A socket file left behind by a crashed server is replaced; anything else is not
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) throw std::runtime_error("Not a socket: " + socketPath);
+        unlink(socketPath.c_str());
+    }
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) throw std::runtime_error(std::string("Failed to create socket: ") + std::strerror(errno));
+    setNonBlocking(listenFd);
+
+    // Owner only, and before listen(), so no other user ever gets to connect
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        chmod(socketPath.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+        std::string reason = std::strerror(errno);
+        closeAll();
+        throw std::runtime_error("Failed to listen on " + socketPath + ": " + reason);
+    }
+
+    startWorkers();
+
+    std::vector<pollfd> fds;
+    std::vector<std::uint64_t> ids;
+    while (!stopping) {
+        fds.clear();
+        ids.clear();
+        fds.push_back({listenFd, POLLIN, 0});
+        fds.push_back({wakeFds[0], POLLIN, 0});
+        for (auto& [id, connection] : connections) {
+            short events = 0;
+            if (!connection.closing && connection.output.size() < options.maxPendingOutput) events |= POLLIN;
+            if (!connection.output.empty()) events |= POLLOUT;
+
+            // A closing connection waiting for its answers is left out: poll()
+            // reports POLLHUP whatever the events, and the loop would spin
+            if (events == 0 && connection.closing) continue;
+            fds.push_back({connection.fd, events, 0});
+            ids.push_back(id);
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("poll failed: ") + std::strerror(errno));
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char drain[256];
+            while (::read(wakeFds[0], drain, sizeof(drain)) > 0) {}
+        }
+        collectCompletions();
+        if (fds[0].revents & POLLIN) accept();
+
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            auto it = connections.find(ids[i]);
+            if (it == connections.end()) continue;
+            short revents = fds[i + 2].revents;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) read(it->first, it->second);
+            if ((revents & POLLOUT) && !it->second.broken) write(it->second);
+        }
+
+        for (auto it = connections.begin(); it != connections.end();) {
+            Connection& connection = it->second;
+            bool finished = connection.closing && connection.requests.empty() && connection.output.empty();
+            if (connection.broken || finished) {
+                close(connection.fd);
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Let the requests in flight finish, then hand out what can be sent without blocking
+    stopWorkers();
+    pipeline.stop();
+    collectCompletions();
+    for (auto& [id, connection] : connections) {
+        if (!connection.broken) write(connection);
+    }
+    closeAll();
+}
+
+void QueryServer::accept() {
+    while (true) {
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) return; // EAGAIN, or a client that gave up while queued
+        try {
+            setNonBlocking(fd);
+        } catch (const std::exception&) {
+            close(fd);
+            continue;
+        }
+        Connection connection;
+        connection.fd = fd;
+        connections.emplace(nextConnection++, std::move(connection));
+    }
+}
+
+void QueryServer::read(std::uint64_t id, Connection& connection) {
+    char buffer[64 * 1024];
+    while (!connection.closing) {
+        ssize_t received = ::read(connection.fd, buffer, sizeof(buffer));
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) connection.broken = true;
+            break;
+        }
+        if (received == 0) {
+            connection.closing = true; // the client is done sending; answer what it asked
+            break;
+        }
+        connection.input.append(buffer, static_cast<std::size_t>(received));
+
+        std::size_t start = 0;
+        std::size_t newline;
+        while ((newline = connection.input.find('\n', start)) != std::string::npos) {
+            std::string line = connection.input.substr(start, newline - start);
+            start = newline + 1;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (isBlank(line)) continue;
+
+            Request request;
+            request.sequence = connection.nextSequence++;
+            request.mutation = !BatchProcessor::isQuery(line);
+            request.line = std::move(line);
+            connection.requests.push_back(std::move(request));
+        }
+        connection.input.erase(0, start);
+
+        if (connection.input.size() > options.maxLineLength) {
+            Request request;
+            request.sequence = connection.nextSequence++;
+            request.mutation = false;
+            request.dispatched = request.done = true;
+            request.answer = "error Request too long\n";
+            connection.requests.push_back(std::move(request));
+            connection.input.clear();
+            connection.closing = true;
+        }
+    }
+    dispatch(id, connection);
+}
+
+void QueryServer::dispatch(std::uint64_t id, Connection& connection) {
+    // Hand finished answers out in order
+    while (!connection.requests.empty() && connection.requests.front().done) {
+        connection.output += connection.requests.front().answer;
+        connection.requests.pop_front();
+    }
+
+    for (auto& request : connection.requests) {
+        if (request.dispatched) continue;
+        if (request.mutation ? connection.runningQueries > 0 : connection.runningMutations > 0) break;
+
+        request.dispatched = true;
+        std::uint64_t sequence = request.sequence;
+        std::string line = request.line;
+
+        // Client-chosen paths would be opened with the server's permissions
+        std::string verb = firstWord(line);
+        if (verb == "import" || verb == "export") {
+            request.done = true;
+            request.answer = "error Import and export are not available over the server\n";
+            continue;
+        }
+
+        if (!request.mutation) {
+            ++connection.runningQueries;
+            post([this, id, sequence, line] {
+                std::ostringstream out;
+                processor.execute(line, out);
+                complete(id, sequence, out.str());
+            });
+            continue;
+        }
+
+        if (verb == "begin" || verb == "commit" || verb == "rollback") {
+            request.done = true;
+            request.answer = "error Transactions are not available over the server\n";
+            continue;
+        }
+
+        // Submitted from this thread, so the writer applies them in request order
+        ++connection.runningMutations;
+        auto out = std::make_shared<std::ostringstream>();
+        pipeline.submit([this, line, out](Controller&) { processor.execute(line, *out); },
+                        [this, id, sequence, out](std::exception_ptr error) {
+                            std::string answer = out->str();
+                            if (error) {
+                                // The group could not be written
+                                try {
+                                    std::rethrow_exception(error);
+                                } catch (const std::exception& e) {
+                                    answer = std::string("error ") + e.what() + "\n";
+                                }
+                            }
+                            complete(id, sequence, std::move(answer));
+                        });
+    }
+
+    // Answers rejected in place may now be at the front
+    while (!connection.requests.empty() && connection.requests.front().done) {
+        connection.output += connection.requests.front().answer;
+        connection.requests.pop_front();
+    }
+    if (!connection.output.empty()) write(connection);
+}
+
+void QueryServer::write(Connection& connection) {
+    while (!connection.output.empty()) {
+        ssize_t sent = send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) connection.broken = true;
+            return;
+        }
+        connection.output.erase(0, static_cast<std::size_t>(sent));
+    }
+}
+
+void QueryServer::collectCompletions() {
+    std::vector<Completion> finished;
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        finished.swap(completions);
+    }
+
+    for (auto& completion : finished) {
+        auto it = connections.find(completion.connection);
+        if (it == connections.end()) continue; // the client went away
+        Connection& connection = it->second;
+        for (auto& request : connection.requests) {
+            if (request.sequence != completion.sequence) continue;
+            request.done = true;
+            request.answer = std::move(completion.answer);
+            --(request.mutation ? connection.runningMutations : connection.runningQueries);
+            break;
+        }
+        if (!connection.broken) dispatch(it->first, connection);
+    }
+}
+
+void QueryServer::complete(std::uint64_t connection, std::uint64_t sequence, std::string answer) {
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        completions.push_back({connection, sequence, std::move(answer)});
+    }
+    char byte = 'c';
+    ssize_t ignored = ::write(wakeFds[1], &byte, 1); // a full pipe already means "wake up"
+    (void)ignored;
+}
+
+void QueryServer::startWorkers() {
+    unsigned count = options.workers > 0 ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+    workersStopping = false;
+    for (unsigned i = 0; i < count; ++i) {
+        workers.emplace_back([this] {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(jobMutex);
+                    jobReady.wait(lock, [this] { return workersStopping || !jobs.empty(); });
+                    if (jobs.empty()) return;
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        });
+    }
+}
+
+void QueryServer::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        workersStopping = true;
+    }
+    jobReady.notify_all();
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+}
+
+void QueryServer::post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobs.push_back(std::move(job));
+    }
+    jobReady.notify_one();
+}
+
+void QueryServer::closeAll() {
+    for (auto& [id, connection] : connections) close(connection.fd);
+    connections.clear();
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+        unlink(socketPath.c_str());
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef QUERYSERVER_H
+#define QUERYSERVER_H
+
+#include "batchprocessor.h"
+#include "writerpipeline.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Serves one Controller to many local clients over a Unix domain socket
+// (POSIX only), speaking the BatchProcessor line protocol: each request is
+// one line and each answer ends with its "ok ..." or "error ..." line.
+//
+// A single thread runs a poll() event loop that accepts connections and
+// moves bytes. Queries run on a worker pool against the current snapshot;
+// everything else goes through a WriterPipeline, so mutations from all
+// clients are group-committed together. Clients may pipeline requests:
+// consecutive queries from one connection run in parallel, consecutive
+// mutations are queued to the writer together, a query never overtakes an
+// earlier mutation of its connection (or the reverse), and answers always
+// come back in request order. Transactions (begin/commit/rollback)
+// are per-thread in the Controller and are not offered over the socket.
+// Neither are import and export, which would let any client read and write
+// files with the server's permissions. The socket file is created with mode
+// 0600, so only the server's user can connect.
+class QueryServer
+{
+public:
+    struct Options
+    {
+        unsigned workers = 0;                   // query threads; 0: one per hardware thread
+        std::size_t maxLineLength = 64 * 1024;  // longer requests close the connection
+        std::size_t maxPendingOutput = 4 << 20; // stop reading from a client that does not read its answers
+    };
+
+    QueryServer(Controller& controller, std::string socketPath);
+    QueryServer(Controller& controller, std::string socketPath, Options options);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Binds the socket (replacing a stale one) and serves until stop(). Call
+    // it once; throws std::runtime_error if the socket cannot be set up.
+    void run();
+
+    // Makes run() return after the requests being processed have been answered.
+    // Async-signal-safe, so it may be called from a signal handler.
+    void stop();
+
+private:
+    struct Request
+    {
+        std::uint64_t sequence;
+        std::string line;
+        bool mutation;
+        bool dispatched = false;
+        bool done = false;
+        std::string answer;
+    };
+
+    struct Connection
+    {
+        int fd;
+        std::string input;
+        std::string output;
+        std::deque<Request> requests; // in arrival order; answered from the front
+        std::uint64_t nextSequence = 0;
+        std::size_t runningQueries = 0;   // dispatched, not done
+        std::size_t runningMutations = 0;
+        bool closing = false;         // answer what is pending, then close
+        bool broken = false;          // drop without answering
+    };
+
+    struct Completion
+    {
+        std::uint64_t connection;
+        std::uint64_t sequence;
+        std::string answer;
+    };
+
+    std::string socketPath;
+    Options options;
+    BatchProcessor processor;
+    WriterPipeline pipeline;
+
+    int listenFd = -1;
+    int wakeFds[2] = {-1, -1};
+    std::atomic<bool> stopping{false};
+
+    std::map<std::uint64_t, Connection> connections;
+    std::uint64_t nextConnection = 0;
+
+    std::mutex completionMutex;
+    std::vector<Completion> completions;
+
+    // Worker pool for queries
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> workers;
+    bool workersStopping = false;
+
+    void startWorkers();
+    void stopWorkers();
+    void post(std::function<void()> job);
+    void complete(std::uint64_t connection, std::uint64_t sequence, std::string answer);
+
+    void accept();
+    void read(std::uint64_t id, Connection& connection);
+    void write(Connection& connection);
+    void collectCompletions();
+    void dispatch(std::uint64_t id, Connection& connection);
+    void closeAll();
+};
+
+#endif // QUERYSERVER_H
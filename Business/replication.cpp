@@ -0,0 +1,469 @@
+#include "replication.h"
+#include "csvrepository.h"
+#include "exporter.h"
+#include "metrics.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+std::uint64_t wallClockMillis() {
+    using namespace std::chrono;
+    return static_cast<std::uint64_t>(duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+// "#tag VERSION"; false if the line is anything else
+bool parseHeader(const std::string& line, const std::string& tag, std::uint64_t& version) {
+    std::istringstream in(line);
+    std::string word;
+    return (in >> word >> version) && word == tag;
+}
+
+void writeRecord(std::ostream& out, const Book& book) {
+    out << book.getId() << ',' << book.getTitle() << ',' << book.getAuthor() << ','
+        << book.getGenre() << ',' << book.getYear();
+}
+
+std::string messageOf(std::exception_ptr error) {
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::exception& e) {
+        return e.what();
+    } catch (...) {
+        return "unknown error";
+    }
+}
+
+}
+
+struct ReplicationLog::State
+{
+    Controller& primary;
+    std::string baseName;
+    Options options;
+
+    std::mutex mutex;
+    std::ofstream log;
+    std::uint64_t baseVersion = 0;      // version of the current snapshot
+    std::size_t records = 0;            // log records since the snapshot
+    bool inBatch = false;
+    bool closed = false;
+    bool failed = false;                // the log could not be written; wait for a new one
+
+    // The snapshot being written in the background, and the records past its
+    // version, which the new log starts with
+    std::shared_future<void> snapshotTask;
+    bool snapshotPending = false;
+    bool snapshotAgain = false;         // a Reset arrived meanwhile
+    std::uint64_t pendingVersion = 0;
+    std::string pendingRecords;
+    std::size_t pendingCount = 0;
+
+    State(Controller& primary, std::string baseName, Options options)
+        : primary(primary), baseName(std::move(baseName)), options(options) {}
+
+    void onChange(const ChangeEvent& event);
+    void append(std::uint64_t version, const std::string& record);
+    void startSnapshot();
+    void finishSnapshot(const std::shared_ptr<const CatalogSnapshot>& snapshot);
+    void writeSnapshotFile(const CatalogSnapshot& snapshot) const;
+    void startLog(std::uint64_t version, const std::string& carried);
+    void report(const std::string& message) const;
+};
+
+ReplicationLog::ReplicationLog(Controller& primary, std::string baseName)
+    : ReplicationLog(primary, std::move(baseName), Options()) {}
+
+ReplicationLog::ReplicationLog(Controller& primary, std::string baseName, Options options)
+    : primary(primary), state(std::make_shared<State>(primary, std::move(baseName), options)) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    // Subscribe before taking the snapshot: changes committed in between are
+    // in the snapshot and are skipped by version
+    auto shared = state;
+    subscription = primary.subscribe([shared](const ChangeEvent& event) { shared->onChange(event); });
+    try {
+        auto snapshot = primary.snapshot();
+        state->writeSnapshotFile(*snapshot);
+        state->startLog(snapshot->version(), std::string());
+        state->baseVersion = snapshot->version();
+    } catch (...) {
+        primary.unsubscribe(subscription);
+        state->closed = true;
+        throw;
+    }
+}
+
+ReplicationLog::~ReplicationLog() {
+    primary.unsubscribe(subscription);
+
+    // No new snapshot starts once closed; the one running uses the state
+    std::shared_future<void> task;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->closed = true;
+        task = state->snapshotTask;
+    }
+    if (task.valid()) task.wait();
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->log.close();
+}
+
+void ReplicationLog::writeSnapshot() {
+    // One already running may be older than now: let it finish, then start ours
+    while (true) {
+        std::shared_future<void> task;
+        bool ours = false;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (!state->snapshotPending) {
+                state->startSnapshot();
+                ours = true;
+            }
+            task = state->snapshotTask;
+        }
+        if (ours) {
+            task.get();
+            return;
+        }
+        task.wait();
+    }
+}
+
+void ReplicationLog::waitForSnapshot() {
+    while (true) {
+        std::shared_future<void> task;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (!state->snapshotPending) return;
+            task = state->snapshotTask;
+        }
+        task.wait();
+    }
+}
+
+std::uint64_t ReplicationLog::snapshotVersion() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->baseVersion;
+}
+
+// Called with the mutex held
+void ReplicationLog::State::startSnapshot() {
+    if (closed) return;
+    if (snapshotPending) {
+        snapshotAgain = true;
+        return;
+    }
+
+    // Published snapshots are immutable, so the thread needs no lock to read it
+    auto snapshot = primary.snapshot();
+    snapshotPending = true;
+    snapshotAgain = false;
+    pendingVersion = snapshot->version();
+    pendingRecords.clear();
+    pendingCount = 0;
+
+    // The destructor waits for the task, so it may use this state
+    std::packaged_task<void()> task([this, snapshot] { finishSnapshot(snapshot); });
+    snapshotTask = task.get_future().share();
+    std::thread(std::move(task)).detach();
+}
+
+void ReplicationLog::State::finishSnapshot(const std::shared_ptr<const CatalogSnapshot>& snapshot) {
+    std::exception_ptr error;
+    try {
+        writeSnapshotFile(*snapshot);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshotPending = false;
+    if (closed) return;
+    if (!error) {
+        try {
+            startLog(snapshot->version(), pendingRecords);
+            baseVersion = snapshot->version();
+            records = pendingCount;
+            failed = false;
+        } catch (...) {
+            error = std::current_exception();
+            failed = true;
+        }
+    }
+    pendingRecords.clear();
+
+    if (error) {
+        report(messageOf(error));
+        std::rethrow_exception(error);
+    }
+    if (snapshotAgain) startSnapshot();
+}
+
+void ReplicationLog::State::writeSnapshotFile(const CatalogSnapshot& snapshot) const {
+    std::string snapshotFile = ReplicationLog::snapshotFile(baseName);
+    {
+        std::ofstream out(snapshotFile + ".tmp", std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Failed to open " + snapshotFile + ".tmp for writing");
+        out << "#snapshot " << snapshot.version() << "\n";
+        exportBooks(snapshot, out, ExportFormat::Csv);
+        if (!out.flush()) throw std::runtime_error("Failed to write " + snapshotFile);
+    }
+    std::filesystem::rename(snapshotFile + ".tmp", snapshotFile);
+}
+
+// The new log goes in after the snapshot, so it never starts after it
+void ReplicationLog::State::startLog(std::uint64_t version, const std::string& carried) {
+    std::string logFile = ReplicationLog::logFile(baseName);
+    {
+        std::ofstream out(logFile + ".tmp", std::ios::binary | std::ios::trunc);
+        out << "#log " << version << "\n" << carried;
+        if (!out.flush()) throw std::runtime_error("Failed to write " + logFile);
+    }
+    log.close();
+    std::filesystem::rename(logFile + ".tmp", logFile);
+    log.clear();
+    log.open(logFile, std::ios::binary | std::ios::app);
+    if (!log) throw std::runtime_error("Failed to open " + logFile + " for appending");
+}
+
+void ReplicationLog::State::report(const std::string& message) const {
+    if (options.onError) options.onError(message);
+}
+
+void ReplicationLog::State::append(std::uint64_t version, const std::string& record) {
+    if (snapshotPending && version > pendingVersion) {
+        pendingRecords += record;
+        ++pendingCount;
+    }
+    if (failed) return;
+    log << record;
+    ++records;
+}
+
+void ReplicationLog::State::onChange(const ChangeEvent& event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closed || event.version <= baseVersion) return;
+
+    switch (event.type) {
+    case ChangeEvent::Type::BatchBegin:
+        inBatch = true;
+        return;
+    case ChangeEvent::Type::BatchEnd:
+        inBatch = false;
+        break;
+    case ChangeEvent::Type::Reset:
+        startSnapshot();
+        return;
+    case ChangeEvent::Type::Inserted:
+    case ChangeEvent::Type::Updated: {
+        // Listeners run right after the version is published, under the writer lock
+        auto snapshot = primary.snapshot();
+        const Book* book = snapshot->findById(event.id);
+        if (!book) return;
+        std::ostringstream record;
+        record << event.version << '\t' << wallClockMillis() << "\tput\t";
+        writeRecord(record, *book);
+        record << '\n';
+        append(event.version, record.str());
+        break;
+    }
+    case ChangeEvent::Type::Removed:
+        append(event.version, std::to_string(event.version) + '\t' + std::to_string(wallClockMillis()) + "\tdel\t" +
+                                  std::to_string(event.id) + '\n');
+        break;
+    }
+
+    // One write per commit; a new snapshot only between commits
+    if (inBatch) return;
+    if (!failed && !log.flush()) {
+        failed = true;
+        report("Failed to append to " + ReplicationLog::logFile(baseName) + "; replicas wait for the next snapshot");
+    }
+    if (records >= options.snapshotInterval || failed) startSnapshot();
+}
+
+ReplicaRepository::ReplicaRepository(std::string baseName) : baseName(std::move(baseName)) {
+    loadSnapshot();
+    reload();
+}
+
+void ReplicaRepository::add(const Book&) {
+    throw std::logic_error("Replica is read-only");
+}
+
+void ReplicaRepository::remove(int) {
+    throw std::logic_error("Replica is read-only");
+}
+
+void ReplicaRepository::update(const Book&) {
+    throw std::logic_error("Replica is read-only");
+}
+
+std::vector<Book> ReplicaRepository::getAll() const {
+    if (deletedCount == 0) return books;
+    std::vector<Book> live;
+    forEach([&live](const Book& book) { live.push_back(book); });
+    return live;
+}
+
+std::unique_ptr<Book> ReplicaRepository::findById(int id) const {
+    auto it = position.find(id);
+    if (it == position.end()) return nullptr;
+    return std::make_unique<Book>(books[it->second]);
+}
+
+void ReplicaRepository::forEach(const std::function<void(const Book&)>& visit) const {
+    for (std::size_t i = 0; i < books.size(); ++i) {
+        if (!deleted[i]) visit(books[i]);
+    }
+}
+
+std::size_t ReplicaRepository::reload() {
+    std::ifstream in(ReplicationLog::logFile(baseName), std::ios::binary);
+    std::string header;
+    std::uint64_t base = 0;
+    if (!in || !std::getline(in, header) || !parseHeader(header, "#log", base)) return 0;
+
+    std::size_t changed = 0;
+    if (!haveLog || base != logBase) {
+        // The log was restarted; if it starts past us, the records in
+        // between are only in the snapshot
+        if (base > applied) {
+            loadSnapshot();
+            notify(ChangeEvent::Type::Reset, -1);
+            changed = 1;
+        }
+        haveLog = true;
+        logBase = base;
+        offset = header.size() + 1;
+        skipThrough = applied;
+    }
+
+    in.seekg(static_cast<std::streamoff>(offset));
+    std::string tail{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+    // Only whole lines; a record being written is picked up next time
+    std::size_t start = 0;
+    for (std::size_t end; (end = tail.find('\n', start)) != std::string::npos; start = end + 1) {
+        if (applyRecord(tail.substr(start, end - start))) ++changed;
+    }
+    offset += start;
+    if (deletedCount > 0) compact();
+    return changed;
+}
+
+void ReplicaRepository::compact() {
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < books.size(); ++i) {
+        if (deleted[i]) continue;
+        if (kept != i) {
+            books[kept] = std::move(books[i]);
+            position[books[kept].getId()] = kept;
+        }
+        ++kept;
+    }
+    books.resize(kept);
+    deleted.assign(kept, 0);
+    deletedCount = 0;
+}
+
+void ReplicaRepository::loadSnapshot() {
+    std::string fileName = ReplicationLog::snapshotFile(baseName);
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in) throw std::runtime_error("No replication snapshot at " + fileName);
+
+    std::string line;
+    std::uint64_t version = 0;
+    if (!std::getline(in, line) || !parseHeader(line, "#snapshot", version)) {
+        throw std::runtime_error("Malformed replication snapshot " + fileName);
+    }
+
+    books.clear();
+    position.clear();
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        try {
+            Book book = CSVRepository::parseLine(line);
+            position[book.getId()] = books.size();
+            books.push_back(std::move(book));
+        } catch (const std::exception&) {
+            // Skip malformed lines, as the CSV backend does
+        }
+    }
+
+    deleted.assign(books.size(), 0);
+    deletedCount = 0;
+    applied = version;
+    skipThrough = version;
+    ++snapshotLoads;
+}
+
+bool ReplicaRepository::applyRecord(const std::string& line) {
+    std::size_t versionEnd = line.find('\t');
+    std::size_t clockEnd = versionEnd == std::string::npos ? versionEnd : line.find('\t', versionEnd + 1);
+    std::size_t opEnd = clockEnd == std::string::npos ? clockEnd : line.find('\t', clockEnd + 1);
+    if (opEnd == std::string::npos) return false;
+
+    std::uint64_t version = 0;
+    std::uint64_t committed = 0;
+    try {
+        version = std::stoull(line.substr(0, versionEnd));
+        committed = std::stoull(line.substr(versionEnd + 1, clockEnd - versionEnd - 1));
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (version <= skipThrough) return false;
+
+    std::string op = line.substr(clockEnd + 1, opEnd - clockEnd - 1);
+    std::string payload = line.substr(opEnd + 1);
+    if (op == "put") {
+        Book book;
+        try {
+            book = CSVRepository::parseLine(payload);
+        } catch (const std::exception&) {
+            return false;
+        }
+        auto it = position.find(book.getId());
+        if (it != position.end()) {
+            books[it->second] = book;
+            notify(ChangeEvent::Type::Updated, book.getId(), &books[it->second]);
+        } else {
+            position[book.getId()] = books.size();
+            books.push_back(book);
+            deleted.push_back(0);
+            notify(ChangeEvent::Type::Inserted, book.getId(), &books.back());
+        }
+    } else if (op == "del") {
+        int id = 0;
+        try {
+            id = std::stoi(payload);
+        } catch (const std::exception&) {
+            return false;
+        }
+        auto it = position.find(id);
+        if (it == position.end()) return false;
+        // A tombstone; reload() compacts once for all the records it applied
+        deleted[it->second] = 1;
+        ++deletedCount;
+        position.erase(it);
+        notify(ChangeEvent::Type::Removed, id);
+    } else {
+        return false;
+    }
+
+    applied = version;
+    std::uint64_t now = wallClockMillis();
+    lastLag = now > committed ? now - committed : 0;
+    Metrics::histogram("Replica lag").record(lastLag * 1000);
+    return true;
+}
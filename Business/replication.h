@@ -0,0 +1,120 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "controller.h"
+#include "repository.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Ships a primary's committed changes to other local instances.
+//
+// <base>.snapshot holds the whole catalog at some version:
+//     #snapshot VERSION
+//     id,title,author,genre,year            (one CSV record per book)
+// <base>.log holds every change committed after that version, in order:
+//     #log VERSION
+//     VERSION<TAB>MILLIS<TAB>put<TAB>id,title,author,genre,year
+//     VERSION<TAB>MILLIS<TAB>del<TAB>id
+// MILLIS is the primary's wall clock at commit. Both files are replaced by
+// renaming, the snapshot first, so a reader never sees a log that starts
+// after the newest snapshot.
+
+// Primary side: follows a controller's change events and appends them to the
+// log; every snapshotInterval records (and on a Reset) a new snapshot is
+// written and the log starts over. Records are written on the committing
+// thread, once per commit. Snapshots are written by a background thread from
+// the published CatalogSnapshot; records committed meanwhile still go to the
+// old log and are carried over into the new one.
+//
+// A failed write is passed to onError. After a log write fails no records
+// are written until the next snapshot starts a new log, which is retried
+// on every commit.
+class ReplicationLog
+{
+public:
+    struct Options
+    {
+        std::size_t snapshotInterval = 100000; // log records between snapshots
+        // Called on the thread that hit the failure, which may hold the log's
+        // lock: it must not call back into the log
+        std::function<void(const std::string& message)> onError;
+    };
+
+    ReplicationLog(Controller& primary, std::string baseName);
+    ReplicationLog(Controller& primary, std::string baseName, Options options);
+    ~ReplicationLog();
+
+    ReplicationLog(const ReplicationLog&) = delete;
+    ReplicationLog& operator=(const ReplicationLog&) = delete;
+
+    void writeSnapshot();               // snapshot now and start a new log; throws on failure
+    void waitForSnapshot();             // until a snapshot in the background is in place
+    std::uint64_t snapshotVersion() const;
+
+    static std::string snapshotFile(const std::string& baseName) { return baseName + ".snapshot"; }
+    static std::string logFile(const std::string& baseName) { return baseName + ".log"; }
+
+private:
+    // Shared with the listener, which may still be running when the log is
+    // destroyed
+    struct State;
+
+    Controller& primary;
+    std::shared_ptr<State> state;
+    int subscription = 0;
+};
+
+// Read-only repository that mirrors a primary from its ReplicationLog files.
+// reload() applies the log records written since the last call (only whole
+// lines), so Controller::reloadFromDisk() keeps a replica controller current.
+// When the log was restarted past what the replica has applied, it catches up
+// from the snapshot instead and reports a Reset.
+class ReplicaRepository : public Repository
+{
+public:
+    // Loads the snapshot and the log; throws std::runtime_error if the
+    // primary has not written a snapshot yet
+    explicit ReplicaRepository(std::string baseName);
+    ~ReplicaRepository() override = default;
+
+    // Mutations throw std::logic_error; changes come from the primary only
+    void add(const Book& book) override;
+    void remove(int id) override;
+    void update(const Book& book) override;
+    std::vector<Book> getAll() const override;
+    std::unique_ptr<Book> findById(int id) const override;
+    void forEach(const std::function<void(const Book&)>& visit) const override;
+
+    // Returns the number of records applied; a catch-up counts as one
+    std::size_t reload() override;
+
+    std::uint64_t version() const { return applied; }     // primary version mirrored
+    std::uint64_t lagMillis() const { return lastLag; }  // commit-to-apply delay of the newest record
+    std::size_t catchUps() const { return snapshotLoads - 1; }
+
+private:
+    std::string baseName;
+    std::vector<Book> books;
+    std::unordered_map<int, std::size_t> position;        // id -> index in books
+    std::vector<char> deleted;                            // tombstones, compacted once per reload()
+    std::size_t deletedCount = 0;
+
+    std::uint64_t applied = 0;
+    std::uint64_t skipThrough = 0;                        // records up to here are in the snapshot
+    std::uint64_t logBase = 0;                            // "#log" version of the log being read
+    bool haveLog = false;
+    std::uint64_t offset = 0;                             // bytes of that log consumed
+    std::uint64_t lastLag = 0;
+    std::size_t snapshotLoads = 0;
+
+    void loadSnapshot();
+    bool applyRecord(const std::string& line);
+    void compact();
+    void saveToFile() const override {}                   // nothing of its own to write
+};
+
+#endif // REPLICATION_H
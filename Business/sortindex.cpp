@@ -0,0 +1,99 @@
+#include "sortindex.h"
+#include "catalogsnapshot.h"
+
+#include <algorithm>
+#include <locale>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// The user's collation rules when the environment names a usable locale.
+// Only the collate facet is used, so number formatting is left untouched.
+const std::locale& collationLocale() {
+    static const std::locale locale = [] {
+        try {
+            return std::locale("");
+        } catch (const std::runtime_error&) {
+            return std::locale::classic();
+        }
+    }();
+    return locale;
+}
+
+std::string field(const Book& book, SortField sortField) {
+    switch (sortField) {
+    case SortField::Title: return book.getTitle();
+    case SortField::Author: return book.getAuthor();
+    default: return book.getGenre();
+    }
+}
+
+template <typename Books>
+std::vector<std::uint32_t> collationOrder(const Books& books, SortField sortField) {
+    const auto& collate = std::use_facet<std::collate<char>>(collationLocale());
+
+    std::vector<std::string> keys;
+    keys.reserve(books.size());
+    for (const auto& book : books) {
+        const std::string text = field(book, sortField);
+        keys.push_back(collate.transform(text.data(), text.data() + text.size()));
+    }
+
+    std::vector<std::uint32_t> order(books.size());
+    for (std::uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&keys](std::uint32_t a, std::uint32_t b) {
+        return keys[a] < keys[b];
+    });
+    return order;
+}
+
+template <typename Books>
+std::vector<std::uint32_t> buildOrder(const Books& books, SortField sortField) {
+    if (sortField == SortField::Id || sortField == SortField::Year) {
+        std::vector<std::int32_t> keys;
+        keys.reserve(books.size());
+        for (const auto& book : books) keys.push_back(sortField == SortField::Id ? book.getId() : book.getYear());
+        return SortIndex::radixOrder(keys);
+    }
+    return collationOrder(books, sortField);
+}
+
+}
+
+namespace SortIndex {
+
+std::vector<std::uint32_t> radixOrder(const std::vector<std::int32_t>& keys) {
+    if (keys.size() > UINT32_MAX) throw std::length_error("Too many rows to index");
+
+    // Flipping the sign bit makes unsigned byte order match signed order
+    std::vector<std::uint32_t> biased(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) biased[i] = static_cast<std::uint32_t>(keys[i]) ^ 0x80000000u;
+
+    std::vector<std::uint32_t> order(keys.size());
+    std::vector<std::uint32_t> scratch(keys.size());
+    for (std::uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        std::size_t counts[257] = {};
+        for (std::uint32_t key : biased) ++counts[((key >> shift) & 0xFF) + 1];
+
+        // Every key shares this byte; the pass would not move anything
+        if (std::any_of(counts + 1, counts + 257, [&keys](std::size_t c) { return c == keys.size(); })) continue;
+
+        for (int b = 0; b < 256; ++b) counts[b + 1] += counts[b];
+        for (std::uint32_t position : order) scratch[counts[(biased[position] >> shift) & 0xFF]++] = position;
+        order.swap(scratch);
+    }
+    return order;
+}
+
+std::vector<std::uint32_t> build(const std::vector<Book>& books, SortField sortField) {
+    return buildOrder(books, sortField);
+}
+
+std::vector<std::uint32_t> build(const CatalogSnapshot& books, SortField sortField) {
+    return buildOrder(books, sortField);
+}
+
+}
@@ -0,0 +1,28 @@
+#ifndef SORTINDEX_H
+#define SORTINDEX_H
+
+#include "book.h"
+
+#include <vector>
+#include <cstdint>
+
+class CatalogSnapshot;
+
+// Precomputed sort orders for the catalog columns. A permutation lists
+// catalog positions in ascending order of one field; descending order is the
+// same permutation read backwards, so a re-sort never compares rows again.
+// Integer columns use an LSD radix sort; string columns are sorted on
+// collation keys computed once per book.
+enum class SortField { Id, Title, Author, Genre, Year };
+
+namespace SortIndex {
+
+std::vector<std::uint32_t> build(const std::vector<Book>& books, SortField field);
+std::vector<std::uint32_t> build(const CatalogSnapshot& books, SortField field);
+
+// Stable radix sort of positions 0..keys.size()-1 by their key
+std::vector<std::uint32_t> radixOrder(const std::vector<std::int32_t>& keys);
+
+}
+
+#endif // SORTINDEX_H
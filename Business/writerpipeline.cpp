@@ -0,0 +1,125 @@
+#include "writerpipeline.h"
+
+#include <chrono>
+#include <stdexcept>
+
+WriterPipeline::WriterPipeline(Controller& controller, std::size_t maxBatch)
+    : controller(controller), maxBatch(maxBatch > 0 ? maxBatch : 1) {
+    writer = std::thread(&WriterPipeline::run, this);
+}
+
+WriterPipeline::~WriterPipeline() {
+    stop();
+}
+
+std::future<void> WriterPipeline::submitAdd(const Book& book) {
+    return submit([book](Controller& c) { c.addBook(book); });
+}
+
+std::future<void> WriterPipeline::submitRemove(int id) {
+    return submit([id](Controller& c) { c.removeBook(id); });
+}
+
+std::future<void> WriterPipeline::submitUpdate(const Book& book) {
+    return submit([book](Controller& c) { c.updateBook(book); });
+}
+
+std::future<void> WriterPipeline::submit(std::function<void(Controller&)> mutation) {
+    Request request;
+    request.apply = std::move(mutation);
+    auto result = request.done.get_future();
+    enqueue(std::move(request));
+    return result;
+}
+
+void WriterPipeline::submit(std::function<void(Controller&)> mutation, std::function<void(std::exception_ptr)> done) {
+    Request request;
+    request.apply = std::move(mutation);
+    request.callback = std::move(done);
+    enqueue(std::move(request));
+}
+
+void WriterPipeline::enqueue(Request request) {
+    // Counted before the check, so the writer cannot exit between the check
+    // and the push
+    ++producers;
+    if (stopping) {
+        --producers;
+        finish(request, std::make_exception_ptr(std::logic_error("Writer pipeline is stopped")));
+        return;
+    }
+
+    queue.push(std::move(request));
+    --producers;
+    if (sleeping) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+}
+
+void WriterPipeline::stop() {
+    if (stopping.exchange(true)) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+    if (writer.joinable()) writer.join();
+}
+
+void WriterPipeline::run() {
+    std::vector<Request> batch;
+    batch.reserve(maxBatch);
+
+    while (true) {
+        Request request;
+        while (batch.size() < maxBatch && queue.pop(request)) batch.push_back(std::move(request));
+
+        if (!batch.empty()) {
+            commit(batch);
+            batch.clear();
+            continue;
+        }
+
+        if (stopping) {
+            // A producer may have passed the check before stop() flipped the
+            // flag and not pushed yet
+            if (producers == 0 && queue.empty()) return;
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        sleeping = true;
+        // The timeout is only a safety net; producers wake us when sleeping is set
+        wake.wait_for(lock, std::chrono::milliseconds(100),
+                      [this] { return stopping || !queue.empty(); });
+        sleeping = false;
+    }
+}
+
+void WriterPipeline::commit(std::vector<Request>& batch) {
+    std::vector<std::function<void(Controller&)>> mutations;
+    mutations.reserve(batch.size());
+    for (auto& request : batch) mutations.push_back(std::move(request.apply));
+
+    std::vector<std::exception_ptr> errors;
+    try {
+        errors = controller.applyGroup(mutations);
+    } catch (...) {
+        auto failure = std::current_exception();
+        for (auto& request : batch) finish(request, failure);
+        return;
+    }
+
+    for (std::size_t i = 0; i < batch.size(); ++i) finish(batch[i], errors[i]);
+}
+
+void WriterPipeline::finish(Request& request, std::exception_ptr error) {
+    if (request.callback) {
+        request.callback(error);
+    } else if (error) {
+        request.done.set_exception(error);
+    } else {
+        request.done.set_value();
+    }
+}
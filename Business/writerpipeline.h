@@ -0,0 +1,66 @@
+#ifndef WRITERPIPELINE_H
+#define WRITERPIPELINE_H
+
+#include "controller.h"
+#include "mpscqueue.h"
+
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Single-writer mutation pipeline. Any number of producer threads submit
+// mutations through a lock-free queue; one writer thread drains it and
+// group-commits up to maxBatch requests at a time with Controller::applyGroup.
+// Each returned future becomes ready once its mutation has been written to
+// disk, or carries the exception that the mutation or the write raised.
+class WriterPipeline
+{
+public:
+    static constexpr std::size_t DefaultMaxBatch = 512;
+
+    explicit WriterPipeline(Controller& controller, std::size_t maxBatch = DefaultMaxBatch);
+    ~WriterPipeline();
+
+    WriterPipeline(const WriterPipeline&) = delete;
+    WriterPipeline& operator=(const WriterPipeline&) = delete;
+
+    std::future<void> submitAdd(const Book& book);
+    std::future<void> submitRemove(int id);
+    std::future<void> submitUpdate(const Book& book);
+    std::future<void> submit(std::function<void(Controller&)> mutation);
+    // Same, but reports through a callback instead of a future: done gets
+    // nullptr once the mutation is on disk, or the exception. It runs on the
+    // writer thread, or right away if the pipeline is already stopped.
+    void submit(std::function<void(Controller&)> mutation, std::function<void(std::exception_ptr)> done);
+
+    // Finishes everything already submitted, then stops the writer thread
+    void stop();
+
+private:
+    struct Request {
+        std::function<void(Controller&)> apply;
+        std::promise<void> done;
+        std::function<void(std::exception_ptr)> callback; // used instead of done when set
+    };
+
+    Controller& controller;
+    std::size_t maxBatch;
+
+    MpscQueue<Request> queue;
+    std::atomic<bool> stopping{false};
+    std::atomic<int> producers{0};      // between the stopping check and the push
+    std::atomic<bool> sleeping{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread writer;
+
+    void run();
+    void enqueue(Request request);
+    void commit(std::vector<Request>& batch);
+    static void finish(Request& request, std::exception_ptr error);
+};
+
+#endif // WRITERPIPELINE_H
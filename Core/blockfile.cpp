@@ -0,0 +1,413 @@
+#include "blockfile.h"
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <QString>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const char Magic[8] = {'L', 'F', 'B', 'L', 'O', 'C', 'K', '1'};
+const char TrailerMagic[8] = {'L', 'F', 'I', 'N', 'D', 'E', 'X', '1'};
+const int CompressionLevel = 1; // favour speed; catalog text compresses well anyway
+
+using BlockFile::BlockEntry;
+
+const std::size_t EntrySize = 16;
+const std::size_t TrailerSize = 8 + 4 + 8; // index offset, block count, magic
+
+void putLE(std::string& out, std::uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+std::uint64_t getLE(const char* in, int bytes) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) value |= static_cast<std::uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    return value;
+}
+
+unsigned workerCount(std::size_t jobs) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(jobs, 1)));
+}
+
+// Runs work(i) for i in [0, count) on up to one thread per core
+template <typename Work>
+void parallelFor(std::size_t count, Work work) {
+    unsigned threads = workerCount(count);
+    std::vector<std::future<void>> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+        workers.push_back(std::async(std::launch::async, [=] {
+            for (std::size_t i = t; i < count; i += threads) work(i);
+        }));
+    }
+    for (std::size_t i = 0; i < count; i += threads) work(i);
+    for (auto& worker : workers) worker.get();
+}
+
+std::vector<QByteArray> compressBlocks(const std::string& content, std::size_t blockSize) {
+    if (blockSize == 0) throw std::invalid_argument("Block size must be positive");
+
+    std::size_t count = (content.size() + blockSize - 1) / blockSize;
+    std::vector<QByteArray> blocks(count);
+    parallelFor(count, [&](std::size_t i) {
+        std::size_t size = std::min(blockSize, content.size() - i * blockSize);
+        blocks[i] = qCompress(reinterpret_cast<const uchar*>(content.data() + i * blockSize), static_cast<int>(size),
+                              CompressionLevel);
+    });
+    return blocks;
+}
+
+// Appends the blocks at offset and returns their index entries
+std::vector<BlockEntry> writeBlocks(std::ostream& out, std::uint64_t offset, const std::vector<QByteArray>& blocks,
+                                    const std::string& content, std::size_t blockSize) {
+    std::vector<BlockEntry> entries;
+    for (std::size_t i = 0; i < blocks.size(); ++i) {
+        std::size_t rawSize = std::min(blockSize, content.size() - i * blockSize);
+        out.write(blocks[i].constData(), blocks[i].size());
+        entries.push_back({offset, static_cast<std::uint32_t>(blocks[i].size()), static_cast<std::uint32_t>(rawSize)});
+        offset += static_cast<std::uint64_t>(blocks[i].size());
+    }
+    return entries;
+}
+
+std::string indexEntries(const std::vector<BlockEntry>& entries) {
+    std::string index;
+    index.reserve(entries.size() * EntrySize);
+    for (const auto& entry : entries) {
+        putLE(index, entry.offset, 8);
+        putLE(index, entry.compressedSize, 4);
+        putLE(index, entry.rawSize, 4);
+    }
+    return index;
+}
+
+std::string trailer(std::uint64_t indexOffset, std::size_t count) {
+    std::string bytes;
+    putLE(bytes, indexOffset, 8);
+    putLE(bytes, count, 4);
+    bytes.append(TrailerMagic, sizeof(TrailerMagic));
+    return bytes;
+}
+
+// True if a well-formed trailer ends at end; sets where its index starts and how many entries it has
+bool trailerAt(std::istream& in, std::uint64_t end, std::uint64_t& indexOffset, std::uint64_t& count) {
+    if (end < sizeof(Magic) + TrailerSize) return false;
+
+    char bytes[TrailerSize];
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(end - TrailerSize));
+    in.read(bytes, TrailerSize);
+    if (!in || std::memcmp(bytes + 12, TrailerMagic, sizeof(TrailerMagic)) != 0) return false;
+
+    indexOffset = getLE(bytes, 8);
+    count = getLE(bytes + 8, 4);
+    return indexOffset >= sizeof(Magic) && indexOffset + count * EntrySize + TrailerSize == end;
+}
+
+// End of the last complete trailer. Appends never touch an earlier trailer,
+// so if one was cut short, the container as it was before is still there;
+// search backwards for it.
+std::uint64_t findTrailer(std::istream& in, std::uint64_t fileSize, std::uint64_t& indexOffset, std::uint64_t& count) {
+    if (trailerAt(in, fileSize, indexOffset, count)) return fileSize;
+
+    const std::uint64_t window = 64 * 1024;
+    const std::uint64_t overlap = sizeof(TrailerMagic) - 1;
+    std::string chunk;
+    std::uint64_t end = fileSize;
+    while (end > sizeof(Magic)) {
+        std::uint64_t start = std::max<std::uint64_t>(sizeof(Magic), end > window ? end - window : 0);
+        chunk.resize(end - start);
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(start));
+        in.read(&chunk[0], static_cast<std::streamsize>(chunk.size()));
+        if (!in) break;
+
+        for (std::size_t pos = chunk.rfind(TrailerMagic, std::string::npos, sizeof(TrailerMagic)); pos != std::string::npos;
+             pos = pos > 0 ? chunk.rfind(TrailerMagic, pos - 1, sizeof(TrailerMagic)) : std::string::npos) {
+            std::uint64_t candidate = start + pos + sizeof(TrailerMagic);
+            if (candidate < fileSize && trailerAt(in, candidate, indexOffset, count)) return candidate;
+        }
+        if (start == sizeof(Magic)) break;
+        end = start + overlap;
+    }
+    throw std::runtime_error("Compressed catalog has no block index.");
+}
+
+// Reads the index of an open container; returns where the index starts and sets
+// where the container ends, which is before any remains of an interrupted append
+std::uint64_t readIndex(std::istream& in, std::vector<BlockEntry>& entries, std::uint64_t* containerEnd = nullptr) {
+    in.seekg(0, std::ios::end);
+    std::uint64_t fileSize = static_cast<std::uint64_t>(in.tellg());
+    if (fileSize < sizeof(Magic) + TrailerSize) throw std::runtime_error("Compressed catalog is truncated.");
+
+    std::uint64_t indexOffset = 0;
+    std::uint64_t count = 0;
+    std::uint64_t end = findTrailer(in, fileSize, indexOffset, count);
+    if (containerEnd) *containerEnd = end;
+
+    std::string index(count * EntrySize, '\0');
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(indexOffset));
+    in.read(&index[0], static_cast<std::streamsize>(index.size()));
+    if (!in) throw std::runtime_error("Compressed catalog index is damaged.");
+
+    entries.clear();
+    for (std::uint64_t i = 0; i < count; ++i) {
+        const char* entry = index.data() + i * EntrySize;
+        BlockEntry block{getLE(entry, 8), static_cast<std::uint32_t>(getLE(entry + 8, 4)),
+                         static_cast<std::uint32_t>(getLE(entry + 12, 4))};
+        if (block.offset + block.compressedSize > indexOffset) throw std::runtime_error("Compressed catalog index is damaged.");
+        entries.push_back(block);
+    }
+    return indexOffset;
+}
+
+}
+
+namespace BlockFile {
+
+bool detect(const std::string& fileName) {
+    std::ifstream in{fileName, std::ios::binary};
+    char head[sizeof(Magic)];
+    return in.read(head, sizeof(head)) && std::memcmp(head, Magic, sizeof(Magic)) == 0;
+}
+
+std::string read(const std::string& fileName) {
+    std::ifstream in{fileName, std::ios::binary};
+    if (!in.is_open()) throw std::runtime_error("Failed to open compressed catalog for reading.");
+
+    std::vector<BlockEntry> entries;
+    std::uint64_t indexOffset = readIndex(in, entries);
+
+    // One read for all compressed bytes, then inflate every block into place
+    std::string compressed(indexOffset, '\0');
+    in.seekg(0);
+    in.read(&compressed[0], static_cast<std::streamsize>(indexOffset));
+    if (!in) throw std::runtime_error("Failed to read compressed catalog.");
+
+    std::vector<std::size_t> outputOffsets(entries.size());
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        outputOffsets[i] = total;
+        total += entries[i].rawSize;
+    }
+
+    std::string content(total, '\0');
+    std::vector<char> damaged(entries.size(), 0);
+    parallelFor(entries.size(), [&](std::size_t i) {
+        const BlockEntry& entry = entries[i];
+        QByteArray raw = qUncompress(reinterpret_cast<const uchar*>(compressed.data() + entry.offset),
+                                     static_cast<int>(entry.compressedSize));
+        if (static_cast<std::size_t>(raw.size()) != entry.rawSize) {
+            damaged[i] = 1;
+            return;
+        }
+        std::memcpy(&content[outputOffsets[i]], raw.constData(), entry.rawSize);
+    });
+    if (std::find(damaged.begin(), damaged.end(), 1) != damaged.end()) {
+        throw std::runtime_error("Compressed catalog block is damaged.");
+    }
+    return content;
+}
+
+void write(const std::string& fileName, const std::string& content, std::size_t blockSize) {
+    std::vector<QByteArray> blocks = compressBlocks(content, blockSize);
+
+    std::ostringstream out;
+    out.write(Magic, sizeof(Magic));
+    auto entries = writeBlocks(out, sizeof(Magic), blocks, content, blockSize);
+    std::uint64_t indexOffset = sizeof(Magic);
+    for (const auto& block : blocks) indexOffset += static_cast<std::uint64_t>(block.size());
+    out << indexEntries(entries) << trailer(indexOffset, entries.size());
+    std::string data = out.str();
+
+    // The old file stays in place until the new one is complete
+    QSaveFile file(QString::fromStdString(fileName));
+    if (!file.open(QIODevice::WriteOnly)) throw std::runtime_error("Failed to open compressed catalog for writing.");
+    if (file.write(data.data(), static_cast<qint64>(data.size())) != static_cast<qint64>(data.size()) || !file.commit()) {
+        throw std::runtime_error("Failed to write compressed catalog.");
+    }
+}
+
+void append(const std::string& fileName, const std::string& content, std::size_t blockSize) {
+    if (!detect(fileName)) {
+        write(fileName, content, blockSize);
+        return;
+    }
+    if (content.empty()) return;
+
+    std::vector<QByteArray> blocks = compressBlocks(content, blockSize);
+
+    std::vector<BlockEntry> entries;
+    std::uint64_t end = 0;
+    {
+        std::ifstream in{fileName, std::ios::binary};
+        if (!in.is_open()) throw std::runtime_error("Failed to open compressed catalog for reading.");
+        readIndex(in, entries, &end);
+    }
+
+    // Drop what an interrupted append left behind; nothing refers to it
+    std::error_code error;
+    if (std::filesystem::file_size(fileName, error) != end) std::filesystem::resize_file(fileName, end, error);
+    if (error) throw std::runtime_error("Failed to append to compressed catalog.");
+
+    std::fstream file{fileName, std::ios::in | std::ios::out | std::ios::binary};
+    if (!file.is_open()) throw std::runtime_error("Failed to open compressed catalog for writing.");
+
+    // New blocks and a full index go after the old trailer, which is left
+    // alone; the new trailer is written last, so until it is complete
+    // readers still find the old one
+    file.seekp(static_cast<std::streamoff>(end));
+    auto added = writeBlocks(file, end, blocks, content, blockSize);
+    entries.insert(entries.end(), added.begin(), added.end());
+    std::uint64_t indexOffset = end;
+    for (const auto& block : blocks) indexOffset += static_cast<std::uint64_t>(block.size());
+    file << indexEntries(entries);
+    file.flush();
+    file << trailer(indexOffset, entries.size());
+    file.flush();
+
+    if (!file) throw std::runtime_error("Failed to append to compressed catalog.");
+}
+
+// ========== ReadBuffer ==========
+
+ReadBuffer::ReadBuffer(const std::string& fileName) : in(fileName, std::ios::binary) {
+    if (!in.is_open()) throw std::runtime_error("Failed to open compressed catalog for reading.");
+    readIndex(in, entries);
+    in.clear();
+
+    std::uint64_t start = 0;
+    for (const auto& entry : entries) {
+        blockStarts.push_back(start);
+        start += entry.rawSize;
+    }
+}
+
+void ReadBuffer::loadBlock(std::size_t index) {
+    const BlockEntry& entry = entries[index];
+    compressed.resize(entry.compressedSize);
+    in.seekg(static_cast<std::streamoff>(entry.offset));
+    in.read(&compressed[0], static_cast<std::streamsize>(entry.compressedSize));
+    QByteArray raw = qUncompress(reinterpret_cast<const uchar*>(compressed.data()),
+                                 static_cast<int>(entry.compressedSize));
+    if (!in || static_cast<std::size_t>(raw.size()) != entry.rawSize) {
+        throw std::runtime_error("Compressed catalog block is damaged.");
+    }
+
+    block.assign(raw.constData(), entry.rawSize);
+    blockStart = blockStarts[index];
+    nextBlock = index + 1;
+    setg(&block[0], &block[0], &block[0] + block.size());
+}
+
+ReadBuffer::int_type ReadBuffer::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    // Empty blocks are allowed; skip ahead to one with content
+    while (nextBlock < entries.size()) {
+        if (entries[nextBlock].rawSize == 0) {
+            ++nextBlock;
+            continue;
+        }
+        loadBlock(nextBlock);
+        return traits_type::to_int_type(*gptr());
+    }
+    return traits_type::eof();
+}
+
+ReadBuffer::pos_type ReadBuffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+    std::uint64_t total = blockStarts.empty() ? 0 : blockStarts.back() + entries.back().rawSize;
+    std::uint64_t current = blockStart + static_cast<std::uint64_t>(gptr() - eback());
+    off_type base = dir == std::ios_base::beg ? 0 : static_cast<off_type>(dir == std::ios_base::cur ? current : total);
+    return seekpos(pos_type(base + off), which);
+}
+
+ReadBuffer::pos_type ReadBuffer::seekpos(pos_type pos, std::ios_base::openmode which) {
+    const pos_type failed(off_type(-1));
+    std::uint64_t total = blockStarts.empty() ? 0 : blockStarts.back() + entries.back().rawSize;
+    if (!(which & std::ios_base::in) || off_type(pos) < 0 || static_cast<std::uint64_t>(off_type(pos)) > total) return failed;
+    std::uint64_t target = static_cast<std::uint64_t>(off_type(pos));
+
+    // Within the current block, or at its end, no inflating is needed
+    if (eback() && target >= blockStart && target <= blockStart + block.size()) {
+        setg(eback(), eback() + (target - blockStart), egptr());
+        return pos;
+    }
+
+    if (target == total) {
+        setg(nullptr, nullptr, nullptr);
+        blockStart = total;
+        nextBlock = entries.size();
+        return pos;
+    }
+
+    // The last block starting at or before the target holds it; it cannot be empty
+    std::size_t index = static_cast<std::size_t>(std::upper_bound(blockStarts.begin(), blockStarts.end(), target) -
+                                                 blockStarts.begin());
+    loadBlock(index - 1);
+    setg(eback(), eback() + (target - blockStart), egptr());
+    return pos;
+}
+
+// ========== WriteBuffer ==========
+
+WriteBuffer::WriteBuffer(const std::string& fileName, std::size_t blockSize)
+    : out(fileName, std::ios::binary | std::ios::trunc), block(blockSize > 0 ? blockSize : 1) {
+    if (!out.is_open()) throw std::runtime_error("Failed to open compressed catalog for writing.");
+    out.write(Magic, sizeof(Magic));
+    offset = sizeof(Magic);
+    setp(block.data(), block.data() + block.size());
+}
+
+WriteBuffer::~WriteBuffer() {
+    try {
+        close();
+    } catch (...) {
+        // Callers that care close explicitly and see the error there
+    }
+}
+
+WriteBuffer::int_type WriteBuffer::overflow(int_type ch) {
+    if (closed) return traits_type::eof();
+    writeBlock();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+void WriteBuffer::writeBlock() {
+    int size = static_cast<int>(pptr() - pbase());
+    if (size > 0) {
+        QByteArray packed = qCompress(reinterpret_cast<const uchar*>(pbase()), size, CompressionLevel);
+        out.write(packed.constData(), packed.size());
+        entries.push_back({offset, static_cast<std::uint32_t>(packed.size()), static_cast<std::uint32_t>(size)});
+        offset += static_cast<std::uint64_t>(packed.size());
+    }
+    setp(block.data(), block.data() + block.size());
+    if (!out) throw std::runtime_error("Failed to write compressed catalog.");
+}
+
+void WriteBuffer::close() {
+    if (closed) return;
+    closed = true;
+    writeBlock();
+    out << indexEntries(entries) << trailer(offset, entries.size());
+    out.close();
+    if (!out) throw std::runtime_error("Failed to write compressed catalog.");
+}
+
+}
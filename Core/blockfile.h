@@ -0,0 +1,98 @@
+#ifndef BLOCKFILE_H
+#define BLOCKFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// Optional block-compressed container for catalog files. The content is cut
+// into fixed-size blocks that are zlib-compressed independently, followed by
+// an index of block offsets and sizes and a fixed-size trailer:
+//
+//   "LFBLOCK1" | block 0 | block 1 | ... | index | trailer
+//
+// Because every block and its decompressed size are known up front, blocks
+// are inflated in parallel straight into the output.
+//
+// Writing replaces the file atomically. Appending adds blocks, a full index
+// and a new trailer after the old end and never rewrites existing bytes, so
+// append-only backends stay append-only; readers use the last complete
+// trailer, so an interrupted append leaves the previous content readable.
+namespace BlockFile {
+
+constexpr std::size_t DefaultBlockSize = 256 * 1024;
+
+struct BlockEntry
+{
+    std::uint64_t offset;         // of the compressed block in the file
+    std::uint32_t compressedSize;
+    std::uint32_t rawSize;
+};
+
+// True if the file exists and starts with the container magic
+bool detect(const std::string& fileName);
+
+// Whole decompressed content; throws std::runtime_error on a damaged file
+std::string read(const std::string& fileName);
+
+// Replaces the file with a compressed container holding content
+void write(const std::string& fileName, const std::string& content, std::size_t blockSize = DefaultBlockSize);
+
+// Adds content at the end of an existing container (or creates one)
+void append(const std::string& fileName, const std::string& content, std::size_t blockSize = DefaultBlockSize);
+
+// Stream buffers for reading and writing a container one block at a time,
+// so arbitrarily large content passes through in constant memory.
+// Wrap them in std::istream / std::ostream. Reading can seek to any
+// position of the decompressed content; only the block holding it is inflated.
+class ReadBuffer : public std::streambuf
+{
+public:
+    explicit ReadBuffer(const std::string& fileName); // throws std::runtime_error
+
+protected:
+    int_type underflow() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+    std::ifstream in;
+    std::vector<BlockEntry> entries;
+    std::vector<std::uint64_t> blockStarts; // decompressed offset of each block
+    std::uint64_t blockStart = 0;           // of the block in the get area
+    std::size_t nextBlock = 0;
+    std::string compressed;
+    std::string block;
+
+    void loadBlock(std::size_t index);
+};
+
+class WriteBuffer : public std::streambuf
+{
+public:
+    explicit WriteBuffer(const std::string& fileName, std::size_t blockSize = DefaultBlockSize);
+    ~WriteBuffer() override;
+
+    // Writes the last block and the index; throws std::runtime_error on failure.
+    // Without close() the file is left without an index and is not readable.
+    void close();
+
+protected:
+    int_type overflow(int_type ch) override;
+
+private:
+    std::ofstream out;
+    std::vector<BlockEntry> entries;
+    std::vector<char> block;
+    std::uint64_t offset = 0;
+    bool closed = false;
+
+    void writeBlock();
+};
+
+}
+
+#endif // BLOCKFILE_H
@@ -0,0 +1,153 @@
+#include "catalogsync.h"
+
+#include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+std::string describe(const std::vector<int>& ids) {
+    std::string text = "Book id";
+    text += ids.size() == 1 ? " " : "s ";
+    for (std::size_t i = 0; i < ids.size(); ++i) text += (i ? ", " : "") + std::to_string(ids[i]);
+    return text + " changed here and by another process; reload to see the other version";
+}
+
+}
+
+MergeConflict::MergeConflict(std::vector<int> ids)
+    : std::runtime_error(describe(ids)), conflictIds(std::move(ids)) {}
+
+FileStamp FileStamp::of(const std::string& fileName) {
+    FileStamp stamp;
+#ifndef _WIN32
+    struct stat info;
+    if (::stat(fileName.c_str(), &info) != 0) return stamp;
+    stamp.size = static_cast<std::uintmax_t>(info.st_size);
+    stamp.modifiedNs = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    stamp.changedNs = static_cast<std::int64_t>(info.st_ctim.tv_sec) * 1000000000 + info.st_ctim.tv_nsec;
+    stamp.inode = static_cast<std::uint64_t>(info.st_ino);
+    stamp.device = static_cast<std::uint64_t>(info.st_dev);
+#else
+    std::error_code error;
+    stamp.size = std::filesystem::file_size(fileName, error);
+    if (error) return stamp;
+    auto modified = std::filesystem::last_write_time(fileName, error);
+    if (error) return stamp;
+    stamp.modifiedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(modified.time_since_epoch()).count();
+#endif
+    stamp.exists = true;
+    return stamp;
+}
+
+bool CatalogSync::changedOnDisk() const {
+    return FileStamp::of(fileName) != stamp;
+}
+
+void CatalogSync::synced(const std::vector<Book>& books) {
+    stamp = FileStamp::of(fileName);
+    base.clear();
+    base.reserve(books.size());
+    for (const auto& book : books) base[book.getId()] = hash(book);
+}
+
+std::vector<CatalogSync::Change> CatalogSync::merge(std::vector<Book>& ours, const std::vector<Book>& theirs) const {
+    std::unordered_map<int, std::size_t> position;
+    position.reserve(ours.size());
+    for (std::size_t i = 0; i < ours.size(); ++i) position[ours[i].getId()] = i;
+
+    // Did we change the record since the last sync? (absent counts as a state)
+    auto changedHere = [&](int id) {
+        auto b = base.find(id);
+        auto p = position.find(id);
+        if (b == base.end() || p == position.end()) return (b == base.end()) != (p == position.end());
+        return hash(ours[p->second]) != b->second;
+    };
+
+    // Changed on both sides with different results: neither may silently
+    // replace the other
+    std::vector<int> conflicts;
+    std::unordered_set<int> present;
+    present.reserve(theirs.size());
+    for (const auto& book : theirs) {
+        int id = book.getId();
+        present.insert(id);
+        auto b = base.find(id);
+        if (b != base.end() && b->second == hash(book)) continue; // they did not touch it
+        if (!changedHere(id)) continue;
+        auto p = position.find(id);
+        if (p == position.end() || hash(ours[p->second]) != hash(book)) conflicts.push_back(id);
+    }
+    for (const auto& entry : base) {
+        // Removed there, but changed and still present here
+        if (!present.count(entry.first) && position.count(entry.first) && changedHere(entry.first))
+            conflicts.push_back(entry.first);
+    }
+    if (!conflicts.empty()) {
+        std::sort(conflicts.begin(), conflicts.end());
+        throw MergeConflict(std::move(conflicts));
+    }
+
+    std::vector<Change> changes;
+    for (const auto& book : theirs) {
+        int id = book.getId();
+        auto b = base.find(id);
+        if (b != base.end() && b->second == hash(book)) continue; // they did not touch it
+        if (changedHere(id)) continue; // both sides made the same change
+
+        auto p = position.find(id);
+        if (p != position.end()) {
+            ours[p->second] = book;
+            changes.push_back({ChangeEvent::Type::Updated, id});
+        } else {
+            position[id] = ours.size();
+            ours.push_back(book);
+            changes.push_back({ChangeEvent::Type::Inserted, id});
+        }
+    }
+
+    std::unordered_set<int> removed;
+    for (const auto& [id, recordHash] : base) {
+        if (present.count(id) || changedHere(id)) continue;
+        removed.insert(id);
+    }
+    if (!removed.empty()) {
+        ours.erase(std::remove_if(ours.begin(), ours.end(),
+                                  [&removed](const Book& b) { return removed.count(b.getId()) > 0; }),
+                   ours.end());
+        for (int id : removed) changes.push_back({ChangeEvent::Type::Removed, id});
+    }
+
+    return changes;
+}
+
+std::uint64_t CatalogSync::hash(const Book& book) {
+    // FNV-1a over the fields, with a separator so field boundaries count
+    std::uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const std::string& text) {
+        for (unsigned char c : text) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        h ^= 0xff;
+        h *= 1099511628211ull;
+    };
+    auto mixNumber = [&h](int value) {
+        auto bits = static_cast<std::uint32_t>(value);
+        for (int shift = 0; shift < 32; shift += 8) {
+            h ^= (bits >> shift) & 0xff;
+            h *= 1099511628211ull;
+        }
+    };
+    mixNumber(book.getId());
+    mix(book.getTitle());
+    mix(book.getAuthor());
+    mix(book.getGenre());
+    mixNumber(book.getYear());
+    return h;
+}
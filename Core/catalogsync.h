@@ -0,0 +1,85 @@
+#ifndef CATALOGSYNC_H
+#define CATALOGSYNC_H
+
+#include "book.h"
+#include "changeevent.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstdint>
+
+// What stat() says about a file, used to notice that it was written without
+// reading it. The status change time moves on every write, even one that
+// keeps the size and puts the modification time back, and a file replaced
+// by a rename has a new inode. A change that turns out to leave every record
+// as it was costs a read and an empty merge, nothing more.
+struct FileStamp
+{
+    bool exists = false;
+    std::uintmax_t size = 0;
+    std::int64_t modifiedNs = 0;
+    std::int64_t changedNs = 0;   // status change time
+    std::uint64_t inode = 0;
+    std::uint64_t device = 0;
+
+    static FileStamp of(const std::string& fileName);
+
+    bool operator==(const FileStamp& other) const {
+        return exists == other.exists && size == other.size && modifiedNs == other.modifiedNs &&
+               changedNs == other.changedNs && inode == other.inode && device == other.device;
+    }
+    bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+// Thrown by CatalogSync::merge when both sides changed a record - added,
+// edited or removed it - with different results. Neither version is
+// dropped: ours is left as it was and the file is not written.
+class MergeConflict : public std::runtime_error
+{
+public:
+    explicit MergeConflict(std::vector<int> ids);
+    const std::vector<int>& ids() const { return conflictIds; }
+
+private:
+    std::vector<int> conflictIds;
+};
+
+// Remembers what a file-backed repository last read from or wrote to its
+// file - a hash per record plus the file's stamp - so that records another
+// process changed since then can be told apart from records changed here.
+class CatalogSync
+{
+public:
+    struct Change
+    {
+        ChangeEvent::Type type;
+        int id;
+    };
+
+    CatalogSync() = default;
+    explicit CatalogSync(std::string fileName) : fileName(std::move(fileName)) {}
+
+    // True if the file was written since the last synced() call
+    bool changedOnDisk() const;
+
+    // Records the file's current contents (as read or just written)
+    void synced(const std::vector<Book>& books);
+
+    // Three-way merge of the file's current contents into ours: every record
+    // the file added, changed or removed since the last sync is applied to
+    // ours. A record both sides changed must have come out the same;
+    // otherwise MergeConflict is thrown before ours is touched.
+    // Returns the changes applied to ours, in file order.
+    std::vector<Change> merge(std::vector<Book>& ours, const std::vector<Book>& theirs) const;
+
+    static std::uint64_t hash(const Book& book);
+
+private:
+    std::string fileName;
+    FileStamp stamp;
+    std::unordered_map<int, std::uint64_t> base; // id -> record hash at the last sync
+};
+
+#endif // CATALOGSYNC_H
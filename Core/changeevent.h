@@ -0,0 +1,24 @@
+#ifndef CHANGEEVENT_H
+#define CHANGEEVENT_H
+
+#include <cstdint>
+#include <functional>
+
+class Book;
+
+// Fine-grained catalog change notification. Runs of changes that were
+// committed together are bracketed by BatchBegin/BatchEnd; Reset means the
+// whole catalog should be re-read.
+struct ChangeEvent
+{
+    enum class Type { Inserted, Updated, Removed, BatchBegin, BatchEnd, Reset };
+
+    Type type;
+    int id = -1;               // book id for Inserted/Updated/Removed
+    std::uint64_t version = 0; // snapshot version the change is visible in (0 at repository level)
+    const Book* book = nullptr; // repository level only: the book as inserted/updated, valid during the call
+};
+
+using ChangeListener = std::function<void(const ChangeEvent&)>;
+
+#endif // CHANGEEVENT_H
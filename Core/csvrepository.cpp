@@ -1,4 +1,6 @@
 #include "csvrepository.h"
+#include "blockfile.h"
+#include "filelock.h"
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
@@ -6,25 +8,55 @@
 
 CSVRepository::CSVRepository() {}
 
-CSVRepository::CSVRepository(std::string fileName) : fileName(std::move(fileName)) {
-    loadFromFile();
+CSVRepository::CSVRepository(std::string fileName, const LoadProgress& progress)
+    : fileName(std::move(fileName)), sync(this->fileName) {
+    ids.attach(this->fileName + ".ids", this->fileName);
+    loadFromFile(progress);
 }
 
 void CSVRepository::add(const Book& book) {
     books.push_back(book);
-    saveToFile();
+    ids.observe(book.getId());
+    notify(ChangeEvent::Type::Inserted, book.getId(), &book);
+    persist([this, id = book.getId()] {
+        books.erase(std::find_if(books.begin(), books.end(), [id](const Book& b) { return b.getId() == id; }));
+        notify(ChangeEvent::Type::Removed, id);
+    });
 }
 
 void CSVRepository::remove(int id) {
-    auto it = std::remove_if(books.begin(), books.end(),
-                             [id](const Book& b) { return b.getId() == id; });
+    auto it = std::find_if(books.begin(), books.end(),
+                           [id](const Book& b) { return b.getId() == id; });
 
     if (it == books.end()) {
         throw std::out_of_range("Book with ID not found in CSV repository");
     }
 
-    books.erase(it, books.end());
-    saveToFile();
+    Book removed = *it;
+    std::size_t index = static_cast<std::size_t>(it - books.begin());
+    books.erase(it);
+    notify(ChangeEvent::Type::Removed, id);
+    persist([this, &removed, index] {
+        books.insert(books.begin() + static_cast<std::ptrdiff_t>(std::min(index, books.size())), removed);
+        notify(ChangeEvent::Type::Inserted, removed.getId(), &removed);
+    });
+}
+
+void CSVRepository::update(const Book& book) {
+    auto it = std::find_if(books.begin(), books.end(),
+                           [&book](const Book& b) { return b.getId() == book.getId(); });
+
+    if (it == books.end()) {
+        throw std::out_of_range("Book with ID not found in CSV repository");
+    }
+
+    Book old = *it;
+    *it = book;
+    notify(ChangeEvent::Type::Updated, book.getId(), &book);
+    persist([this, &old] {
+        *std::find_if(books.begin(), books.end(), [&old](const Book& b) { return b.getId() == old.getId(); }) = old;
+        notify(ChangeEvent::Type::Updated, old.getId(), &old);
+    });
 }
 
 std::vector<Book> CSVRepository::getAll() const {
@@ -39,52 +71,90 @@ std::unique_ptr<Book> CSVRepository::findById(int id) const {
     return nullptr;
 }
 
-void CSVRepository::loadFromFile() {
-    books.clear();
+void CSVRepository::forEach(const std::function<void(const Book&)>& visit) const {
+    for (const auto& b : books) visit(b);
+}
+
+void CSVRepository::loadFromFile(const LoadProgress& progress) {
+    FileLock lock(fileName, FileLock::Mode::Shared);
+
+    compressed = BlockFile::detect(fileName);
+    books = readFile(progress);
+    for (const auto& b : books) ids.observe(b.getId());
+    sync.synced(books);
+}
+
+std::size_t CSVRepository::reload() {
+    FileLock lock(fileName, FileLock::Mode::Shared);
+    if (!sync.changedOnDisk()) return 0;
+
+    std::vector<Book> theirs = readFile(nullptr);
+    auto changes = sync.merge(books, theirs);
+    sync.synced(theirs);
+    notifyMerged(changes);
+    return changes.size();
+}
+
+std::vector<Book> CSVRepository::readFile(const LoadProgress& progress) const {
+    if (BlockFile::detect(fileName)) {
+        std::istringstream in{BlockFile::read(fileName)};
+        return readRecords(in, progress);
+    }
+
     std::ifstream in{fileName};
 
     if (!in.is_open()) {
         // File might not exist yet — don't throw
-        return;
+        return {};
     }
 
-    std::string line;
-    while (std::getline(in, line)) {
-        std::stringstream ss(line);
-        std::string item;
-        Book book;
-
-        try {
-            std::getline(ss, item, ',');
-            if (item.empty()) continue;
-            book.setId(std::stoi(item));
-
-            std::getline(ss, item, ',');
-            book.setTitle(item);
+    return readRecords(in, progress);
+}
 
-            std::getline(ss, item, ',');
-            book.setAuthor(item);
+std::vector<Book> CSVRepository::readRecords(std::istream& in, const LoadProgress& progress) {
+    const std::size_t progressInterval = 4096; // lines between progress reports
+
+    // tellg() returns -1 on a stream that cannot seek, and once the last line
+    // has hit end of file; the total is then unknown (0) or the position is
+    // the last one known (the total at end of file)
+    std::size_t total = 0;
+    if (progress) {
+        in.seekg(0, std::ios::end);
+        auto end = in.tellg();
+        if (end != std::streampos(-1)) total = static_cast<std::size_t>(end);
+        in.clear();
+        in.seekg(0, std::ios::beg);
+    }
 
-            std::getline(ss, item, ',');
-            book.setGenre(item);
+    std::vector<Book> books;
+    std::string line;
+    std::size_t lineCount = 0;
+    std::size_t position = 0;
+    while (std::getline(in, line)) {
+        if (progress && ++lineCount % progressInterval == 0) {
+            auto at = in.tellg();
+            if (at != std::streampos(-1)) position = static_cast<std::size_t>(at);
+            else if (in.eof()) position = total;
+            if (!progress(total ? std::min(position, total) : position, total)) throw LoadCancelled();
+        }
 
-            std::getline(ss, item, ',');
-            book.setYear(std::stoi(item));
+        if (line.empty() || line[0] == ',' || line[0] == '\r') continue;
 
-            books.push_back(book);
+        try {
+            books.push_back(parseLine(line));
         } catch (...) {
             // Skip malformed lines
             continue;
         }
     }
+
+    if (progress && !progress(total, total)) throw LoadCancelled();
+    return books;
 }
 
-void CSVRepository::saveToFile() const {
-    std::ofstream out{fileName};
-    if (!out.is_open()) {
-        throw std::runtime_error("Failed to open CSV file for writing.");
-    }
+namespace {
 
+void writeRecords(std::ostream& out, const std::vector<Book>& books) {
     for (const auto& b : books) {
         out << b.getId() << ","
             << b.getTitle() << ","
@@ -93,3 +163,63 @@ void CSVRepository::saveToFile() const {
             << b.getYear() << "\n";
     }
 }
+
+// Leading number of the field; whatever follows it is ignored, as the
+// loader always has
+int parseField(const std::string& text, const char* field) {
+    try {
+        return std::stoi(text);
+    } catch (const std::exception&) {
+        throw std::invalid_argument(std::string("Invalid ") + field + ": '" + text + "'");
+    }
+}
+
+}
+
+Book CSVRepository::parseLine(const std::string& line) {
+    std::string fields[5];
+    std::size_t start = 0;
+    for (int i = 0; i < 5; ++i) {
+        std::size_t comma = line.find(',', start);
+        if (comma == std::string::npos && i < 4) {
+            throw std::invalid_argument("Expected 5 fields, found " + std::to_string(i + 1));
+        }
+        fields[i] = line.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        start = comma + 1;
+    }
+
+    Book book;
+    book.setId(parseField(fields[0], "id"));
+    book.setTitle(fields[1]);
+    book.setAuthor(fields[2]);
+    book.setGenre(fields[3]);
+    book.setYear(parseField(fields[4], "year"));
+    return book;
+}
+
+void CSVRepository::saveToFile() const {
+    if (compressed) {
+        std::ostringstream out;
+        writeRecords(out, books);
+        BlockFile::write(fileName, out.str());
+        return;
+    }
+
+    std::ofstream out{fileName};
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open CSV file for writing.");
+    }
+
+    writeRecords(out, books);
+}
+
+void CSVRepository::writeBack() {
+    FileLock lock(fileName, FileLock::Mode::Exclusive);
+
+    // Another process wrote since we last synced: take its changes first
+    if (sync.changedOnDisk()) notifyMerged(sync.merge(books, readFile(nullptr)));
+
+    saveToFile();
+    sync.synced(books);
+    ids.save();
+}
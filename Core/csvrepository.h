@@ -3,23 +3,36 @@
 
 #include "repository.h"
 
+#include <iosfwd>
+
 class CSVRepository : public Repository
 {
 public:
     CSVRepository();
-    CSVRepository(std::string fileName);
+    CSVRepository(std::string fileName, const LoadProgress& progress = nullptr); // progress counts bytes
     ~CSVRepository() override = default;
 
     void add(const Book& book) override;
     void remove(int id) override;
+    void update(const Book& book) override;
     std::vector<Book> getAll() const override;
     std::unique_ptr<Book> findById(int id) const override;
+    void forEach(const std::function<void(const Book&)>& visit) const override;
+    std::size_t reload() override;
+
+    // One "id,title,author,genre,year" record; throws std::invalid_argument
+    // naming the offending field. Shared with the bulk importer.
+    static Book parseLine(const std::string& line);
 private:
     std::string fileName;
     std::vector<Book> books;
+    CatalogSync sync;
 
-    void loadFromFile();
-    void saveToFile() const;
+    void loadFromFile(const LoadProgress& progress);
+    std::vector<Book> readFile(const LoadProgress& progress) const;
+    static std::vector<Book> readRecords(std::istream& in, const LoadProgress& progress);
+    void saveToFile() const override;
+    void writeBack() override;
 };
 
 #endif // CSVREPOSITORY_H
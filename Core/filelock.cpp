@@ -0,0 +1,39 @@
+#include "filelock.h"
+
+#include <stdexcept>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+FileLock::FileLock(const std::string& fileName, Mode mode) {
+#ifndef _WIN32
+    if (fileName.empty()) return;
+
+    std::string lockFile = fileName + ".lock";
+    fd = ::open(lockFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open lock file " + lockFile);
+    }
+
+    int operation = mode == Mode::Exclusive ? LOCK_EX : LOCK_SH;
+    while (::flock(fd, operation) != 0) {
+        if (errno == EINTR) continue;
+        ::close(fd);
+        fd = -1;
+        throw std::runtime_error("Failed to lock " + lockFile);
+    }
+#else
+    (void)fileName;
+    (void)mode;
+#endif
+}
+
+FileLock::~FileLock() {
+#ifndef _WIN32
+    if (fd >= 0) ::close(fd); // closing releases the lock
+#endif
+}
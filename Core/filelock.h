@@ -0,0 +1,27 @@
+#ifndef FILELOCK_H
+#define FILELOCK_H
+
+#include <string>
+
+// Advisory lock on a catalog file, held for the lifetime of the object.
+// The lock is taken on a "<file>.lock" side file rather than the catalog
+// itself, because some saves replace the catalog by renaming a new file over
+// it. Readers share the lock and writers hold it exclusively, so processes
+// that cooperate never read a half-written catalog. Blocks until acquired;
+// a no-op for an empty file name and on platforms without flock().
+class FileLock
+{
+public:
+    enum class Mode { Shared, Exclusive };
+
+    FileLock(const std::string& fileName, Mode mode);
+    ~FileLock();
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+private:
+    int fd = -1;
+};
+
+#endif // FILELOCK_H
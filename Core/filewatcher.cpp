@@ -0,0 +1,100 @@
+#include "filewatcher.h"
+
+#include "catalogsync.h"
+
+#include <filesystem>
+#include <chrono>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher(std::string fileName, std::function<void()> onChange)
+    : watched(std::move(fileName)), onChange(std::move(onChange)) {
+#ifdef __linux__
+    std::filesystem::path path(watched);
+    std::string directory = path.has_parent_path() ? path.parent_path().string() : std::string(".");
+
+    inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd >= 0 && ::pipe2(wakeFds, O_CLOEXEC) == 0 &&
+        ::inotify_add_watch(inotifyFd, directory.c_str(),
+                            IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) >= 0) {
+        thread = std::thread(&FileWatcher::watchEvents, this);
+        return;
+    }
+
+    // No inotify (e.g. out of watches); fall back to polling
+    if (inotifyFd >= 0) ::close(inotifyFd);
+    for (int& fd : wakeFds) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+    inotifyFd = -1;
+#endif
+    thread = std::thread(&FileWatcher::pollForChanges, this);
+}
+
+FileWatcher::~FileWatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stopped.notify_all();
+#ifdef __linux__
+    if (wakeFds[1] >= 0) {
+        char wake = 1;
+        [[maybe_unused]] auto written = ::write(wakeFds[1], &wake, 1);
+    }
+#endif
+    thread.join();
+
+#ifdef __linux__
+    if (inotifyFd >= 0) ::close(inotifyFd);
+    for (int fd : wakeFds) {
+        if (fd >= 0) ::close(fd);
+    }
+#endif
+}
+
+void FileWatcher::watchEvents() {
+#ifdef __linux__
+    std::string name = std::filesystem::path(watched).filename().string();
+    alignas(inotify_event) char buffer[16 * 1024];
+
+    for (;;) {
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakeFds[0], POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0) continue; // EINTR
+        if (fds[1].revents) return;
+
+        // Drain everything queued so a burst of writes is reported once
+        bool matched = false;
+        ssize_t length;
+        while ((length = ::read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length;) {
+                auto* event = reinterpret_cast<inotify_event*>(p);
+                if (event->len > 0 && name == event->name) matched = true;
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (matched) onChange();
+    }
+#endif
+}
+
+void FileWatcher::pollForChanges() {
+    FileStamp last = FileStamp::of(watched);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopped.wait_for(lock, std::chrono::seconds(1), [this] { return stopping; })) {
+        FileStamp current = FileStamp::of(watched);
+        if (current == last) continue;
+        last = current;
+
+        lock.unlock();
+        onChange();
+        lock.lock();
+    }
+}
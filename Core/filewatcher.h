@@ -0,0 +1,43 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Calls onChange on the watcher's own thread whenever the file is written,
+// created, replaced or deleted - by any process, this one included. On Linux
+// the containing directory is watched with inotify, so saves that rename a
+// new file over the old one are seen too; a burst of events is reported
+// once. Elsewhere the file's size and modification time are polled once a
+// second.
+class FileWatcher
+{
+public:
+    FileWatcher(std::string fileName, std::function<void()> onChange);
+    ~FileWatcher(); // stops the thread; onChange is not called afterwards
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    const std::string& fileName() const { return watched; }
+
+private:
+    std::string watched;
+    std::function<void()> onChange;
+    std::thread thread;
+
+    int inotifyFd = -1;
+    int wakeFds[2] = {-1, -1};
+
+    std::mutex mutex;
+    std::condition_variable stopped;
+    bool stopping = false;
+
+    void watchEvents();
+    void pollForChanges();
+};
+
+#endif // FILEWATCHER_H
@@ -0,0 +1,124 @@
+#include "idallocator.h"
+#include "filelock.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+IdAllocator::IdAllocator() {}
+
+IdAllocator::IdAllocator(std::string stateFile) {
+    attach(std::move(stateFile));
+}
+
+void IdAllocator::attach(std::string stateFile, std::string lockedFile) {
+    FileLock fileLock(lockedFile, FileLock::Mode::Shared);
+    std::lock_guard<std::mutex> lock(mutex);
+    this->stateFile = std::move(stateFile);
+    this->lockedFile = std::move(lockedFile);
+    load();
+}
+
+int IdAllocator::allocate() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (reuse && !freeIds.empty()) {
+            int id = *freeIds.begin();
+            freeIds.erase(freeIds.begin());
+            return id;
+        }
+        if (lockedFile.empty()) {
+            dirty = true;
+            return ++hwm;
+        }
+        if (blockNext < blockEnd) return ++blockNext;
+    }
+
+    // The file lock first: writeBack() holds it while saving, which takes the mutex
+    FileLock fileLock(lockedFile, FileLock::Mode::Exclusive);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (blockNext < blockEnd) return ++blockNext; // another thread claimed a block meanwhile
+    blockNext = claim(BlockSize);
+    blockEnd = hwm;
+    return blockNext;
+}
+
+int IdAllocator::reserve(int count) {
+    if (count <= 0) throw std::invalid_argument("Reservation size must be positive");
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (blockEnd - blockNext >= count) {
+            int first = blockNext + 1;
+            blockNext += count;
+            return first;
+        }
+    }
+
+    FileLock fileLock(lockedFile, FileLock::Mode::Exclusive);
+    std::lock_guard<std::mutex> lock(mutex);
+    return claim(count);
+}
+
+int IdAllocator::claim(int count) {
+    // Past anything another process handed out, and persisted before it is used
+    load();
+    int first = hwm + 1;
+    hwm += count;
+    dirty = true;
+    saveLocked();
+    return first;
+}
+
+void IdAllocator::observe(int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (id > hwm) {
+        hwm = id;
+        dirty = true;
+    }
+    if (id > blockNext && id <= blockEnd) blockNext = id; // taken out of the claimed block
+    if (freeIds.erase(id)) dirty = true;
+}
+
+void IdAllocator::release(int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (reuse && id > 0 && id <= hwm) freeIds.insert(id);
+}
+
+void IdAllocator::setReuse(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    reuse = enabled;
+    if (!reuse) freeIds.clear();
+}
+
+int IdAllocator::highWaterMark() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hwm;
+}
+
+void IdAllocator::save() {
+    std::lock_guard<std::mutex> lock(mutex);
+    saveLocked();
+}
+
+void IdAllocator::load() {
+    if (stateFile.empty()) return;
+
+    std::ifstream in{stateFile};
+    int persisted = 0;
+    if (in >> persisted) hwm = std::max(hwm, persisted);
+}
+
+void IdAllocator::saveLocked() {
+    if (!dirty || stateFile.empty()) return;
+
+    // Another process may have moved the mark on since we read it
+    load();
+
+    std::ofstream out{stateFile};
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open id state file for writing.");
+    }
+    out << hwm << "\n";
+    dirty = false;
+}
@@ -0,0 +1,59 @@
+#ifndef IDALLOCATOR_H
+#define IDALLOCATOR_H
+
+#include <string>
+#include <set>
+#include <mutex>
+
+// Hands out book ids in O(1) from a high-water mark. The mark is kept in a
+// small side file next to the catalog so that ids of deleted books are not
+// handed out again after a restart. Optionally, ids given back through
+// release() are reused (lowest first). All calls are thread-safe.
+//
+// Several processes may share a catalog: when attached with the catalog's
+// name, ids are claimed from the side file BlockSize at a time, under the
+// catalog's exclusive FileLock and persisted before the first one is handed
+// out, so no two processes hand out the same id. allocate() and small
+// reserve() calls are served from the claimed block in memory; ids left in
+// it when the process ends are never used. Reused ids are only tracked per
+// process.
+class IdAllocator
+{
+public:
+    static constexpr int BlockSize = 64;
+
+    IdAllocator();
+    explicit IdAllocator(std::string stateFile);
+
+    // Loads the persisted mark, if any. lockedFile is the catalog whose
+    // FileLock guards the side file; without one, allocation is per process.
+    void attach(std::string stateFile, std::string lockedFile = std::string());
+
+    int allocate();
+    int reserve(int count);               // first id of a contiguous block, persisted immediately
+    void observe(int id);                 // make sure an existing id is never handed out
+    void release(int id);
+    void setReuse(bool enabled);
+
+    int highWaterMark() const;
+    // Writes the mark if it changed since the last save, never lowering the
+    // one on disk. Callers that write the catalog hold its lock around this.
+    void save();
+
+private:
+    mutable std::mutex mutex;
+    std::string stateFile;
+    std::string lockedFile;
+    int hwm = 0;
+    int blockNext = 0;  // claimed ids not handed out yet: (blockNext, blockEnd]
+    int blockEnd = 0;
+    bool reuse = false;
+    bool dirty = false;
+    std::set<int> freeIds;
+
+    void load();
+    void saveLocked();
+    int claim(int count); // under the file lock: count ids past every process's mark
+};
+
+#endif // IDALLOCATOR_H
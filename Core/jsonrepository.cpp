@@ -1,4 +1,6 @@
 #include "jsonrepository.h"
+#include "blockfile.h"
+#include "filelock.h"
 #include <QFile>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -9,25 +11,55 @@
 
 JSONRepository::JSONRepository() {}
 
-JSONRepository::JSONRepository(const QString& fileName)
-    : fileName(fileName) {
-    loadFromFile();
+JSONRepository::JSONRepository(const QString& fileName, const LoadProgress& progress)
+    : fileName(fileName), sync(fileName.toStdString()) {
+    ids.attach(fileName.toStdString() + ".ids", fileName.toStdString());
+    loadFromFile(progress);
 }
 
 void JSONRepository::add(const Book& book) {
     books.push_back(book);
-    saveToFile();
+    ids.observe(book.getId());
+    notify(ChangeEvent::Type::Inserted, book.getId(), &book);
+    persist([this, id = book.getId()] {
+        books.erase(std::find_if(books.begin(), books.end(), [id](const Book& b) { return b.getId() == id; }));
+        notify(ChangeEvent::Type::Removed, id);
+    });
 }
 
 void JSONRepository::remove(int id) {
-    auto it = std::remove_if(books.begin(), books.end(),
-                             [id](const Book& b) { return b.getId() == id; });
+    auto it = std::find_if(books.begin(), books.end(),
+                           [id](const Book& b) { return b.getId() == id; });
 
-    if (it == books.end())
+    if (it == books.end()) {
         throw std::out_of_range("Book with ID not found");
+    }
 
-    books.erase(it, books.end());
-    saveToFile();
+    Book removed = *it;
+    std::size_t index = static_cast<std::size_t>(it - books.begin());
+    books.erase(it);
+    notify(ChangeEvent::Type::Removed, id);
+    persist([this, &removed, index] {
+        books.insert(books.begin() + static_cast<std::ptrdiff_t>(std::min(index, books.size())), removed);
+        notify(ChangeEvent::Type::Inserted, removed.getId(), &removed);
+    });
+}
+
+void JSONRepository::update(const Book& book) {
+    auto it = std::find_if(books.begin(), books.end(),
+                           [&book](const Book& b) { return b.getId() == book.getId(); });
+
+    if (it == books.end()) {
+        throw std::out_of_range("Book with ID not found");
+    }
+
+    Book old = *it;
+    *it = book;
+    notify(ChangeEvent::Type::Updated, book.getId(), &book);
+    persist([this, &old] {
+        *std::find_if(books.begin(), books.end(), [&old](const Book& b) { return b.getId() == old.getId(); }) = old;
+        notify(ChangeEvent::Type::Updated, old.getId(), &old);
+    });
 }
 
 std::vector<Book> JSONRepository::getAll() const {
@@ -42,17 +74,48 @@ std::unique_ptr<Book> JSONRepository::findById(int id) const {
     return nullptr;
 }
 
-void JSONRepository::loadFromFile() {
-    books.clear();
+void JSONRepository::forEach(const std::function<void(const Book&)>& visit) const {
+    for (const auto& book : books) visit(book);
+}
 
-    QFile file(fileName);
-    if (!file.exists()) return; // Silent if no file yet (valid case)
-    if (!file.open(QIODevice::ReadOnly)) {
-        throw std::runtime_error("Failed to open JSON file for reading.");
-    }
+void JSONRepository::loadFromFile(const LoadProgress& progress) {
+    FileLock lock(fileName.toStdString(), FileLock::Mode::Shared);
 
-    QByteArray data = file.readAll();
-    file.close();
+    compressed = BlockFile::detect(fileName.toStdString());
+    books = readFile(progress);
+    for (const auto& book : books) ids.observe(book.getId());
+    sync.synced(books);
+}
+
+std::size_t JSONRepository::reload() {
+    FileLock lock(fileName.toStdString(), FileLock::Mode::Shared);
+    if (!sync.changedOnDisk()) return 0;
+
+    std::vector<Book> theirs = readFile(nullptr);
+    auto changes = sync.merge(books, theirs);
+    sync.synced(theirs);
+    notifyMerged(changes);
+    return changes.size();
+}
+
+std::vector<Book> JSONRepository::readFile(const LoadProgress& progress) const {
+    const int progressInterval = 4096; // records between progress reports
+
+    std::vector<Book> books;
+    QByteArray data;
+    if (BlockFile::detect(fileName.toStdString())) {
+        std::string content = BlockFile::read(fileName.toStdString());
+        data = QByteArray(content.data(), static_cast<int>(content.size()));
+    } else {
+        QFile file(fileName);
+        if (!file.exists()) return books; // Silent if no file yet (valid case)
+        if (!file.open(QIODevice::ReadOnly)) {
+            throw std::runtime_error("Failed to open JSON file for reading.");
+        }
+
+        data = file.readAll();
+        file.close();
+    }
 
     QJsonParseError parseError;
     QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
@@ -66,7 +129,14 @@ void JSONRepository::loadFromFile() {
     }
 
     QJsonArray array = doc.array();
-    for (const QJsonValue& val : array) {
+    const std::size_t total = static_cast<std::size_t>(array.size());
+    if (progress && !progress(0, total)) throw LoadCancelled();
+
+    books.reserve(total);
+    for (int i = 0; i < array.size(); ++i) {
+        if (progress && i > 0 && i % progressInterval == 0 && !progress(i, total)) throw LoadCancelled();
+
+        const QJsonValue val = array.at(i);
         if (!val.isObject()) continue;
 
         QJsonObject obj = val.toObject();
@@ -85,6 +155,9 @@ void JSONRepository::loadFromFile() {
 
         books.push_back(book);
     }
+
+    if (progress && !progress(total, total)) throw LoadCancelled();
+    return books;
 }
 
 void JSONRepository::saveToFile() const {
@@ -100,6 +173,11 @@ void JSONRepository::saveToFile() const {
     }
 
     QJsonDocument doc(array);
+    if (compressed) {
+        BlockFile::write(fileName.toStdString(), doc.toJson().toStdString());
+        return;
+    }
+
     QFile file(fileName);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
         throw std::runtime_error("Failed to open JSON file for writing.");
@@ -108,3 +186,14 @@ void JSONRepository::saveToFile() const {
     file.write(doc.toJson());
     file.close();
 }
+
+void JSONRepository::writeBack() {
+    FileLock lock(fileName.toStdString(), FileLock::Mode::Exclusive);
+
+    // Another process wrote since we last synced: take its changes first
+    if (sync.changedOnDisk()) notifyMerged(sync.merge(books, readFile(nullptr)));
+
+    saveToFile();
+    sync.synced(books);
+    ids.save();
+}
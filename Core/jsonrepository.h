@@ -13,19 +13,26 @@ class JSONRepository : public Repository
 {
 public:
     JSONRepository();
-    explicit JSONRepository(const QString& fileName);
+    // progress counts records and starts once the document is parsed
+    explicit JSONRepository(const QString& fileName, const LoadProgress& progress = nullptr);
     ~JSONRepository() override = default;
 
     void add(const Book& book) override;
     void remove(int id) override;
+    void update(const Book& book) override;
     std::vector<Book> getAll() const override;
     std::unique_ptr<Book> findById(int id) const override;
+    void forEach(const std::function<void(const Book&)>& visit) const override;
+    std::size_t reload() override;
 private:
     QString fileName;
     std::vector<Book> books;
+    CatalogSync sync;
 
-    void loadFromFile();
-    void saveToFile() const;
+    void loadFromFile(const LoadProgress& progress);
+    std::vector<Book> readFile(const LoadProgress& progress) const;
+    void saveToFile() const override;
+    void writeBack() override;
 };
 
 #endif // JSONREPOSITORY_H
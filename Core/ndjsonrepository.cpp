@@ -0,0 +1,265 @@
+#include "ndjsonrepository.h"
+#include "blockfile.h"
+#include "filelock.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+struct Record
+{
+    int id;
+    std::optional<Book> book; // empty for a tombstone
+};
+
+struct ParsedRange
+{
+    std::vector<Record> records;
+    std::size_t lines = 0;
+};
+
+// Parses the complete lines in data[begin, end); malformed lines are skipped
+// like in the other repositories but still count as lines of the file
+ParsedRange parseRange(const QByteArray& data, std::size_t begin, std::size_t end) {
+    ParsedRange range;
+    while (begin < end) {
+        const char* start = data.constData() + begin;
+        const char* newline = static_cast<const char*>(std::memchr(start, '\n', end - begin));
+        std::size_t length = newline ? static_cast<std::size_t>(newline - start) : end - begin;
+        begin += length + 1;
+        if (length == 0 || (length == 1 && *start == '\r')) continue;
+        ++range.lines;
+
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(QByteArray(start, static_cast<int>(length)), &error);
+        if (error.error != QJsonParseError::NoError || !doc.isObject()) continue;
+
+        QJsonObject obj = doc.object();
+        if (!obj.contains("id")) continue;
+        if (obj.value("deleted").toBool()) {
+            range.records.push_back({obj.value("id").toInt(), std::nullopt});
+            continue;
+        }
+        if (!obj.contains("title") || !obj.contains("author") || !obj.contains("genre") || !obj.contains("year")) {
+            continue;
+        }
+        try {
+            Book book = Book::fromJson(obj);
+            range.records.push_back({book.getId(), std::move(book)});
+        } catch (const std::exception&) {
+            // Invalid field values; skip the record
+        }
+    }
+    return range;
+}
+
+}
+
+NDJSONRepository::NDJSONRepository() {}
+
+NDJSONRepository::NDJSONRepository(const QString& fileName, const LoadProgress& progress)
+    : fileName(fileName) {
+    ids.attach(fileName.toStdString() + ".ids", fileName.toStdString());
+    loadFromFile(progress);
+}
+
+void NDJSONRepository::add(const Book& book) {
+    books.push_back(book);
+    ids.observe(book.getId());
+    append(book.toJson());
+    notify(ChangeEvent::Type::Inserted, book.getId(), &book);
+    persist();
+}
+
+void NDJSONRepository::remove(int id) {
+    auto it = std::find_if(books.begin(), books.end(), [id](const Book& b) { return b.getId() == id; });
+    if (it == books.end())
+        throw std::out_of_range("Book with ID not found");
+
+    books.erase(it);
+    QJsonObject tombstone;
+    tombstone["id"] = id;
+    tombstone["deleted"] = true;
+    append(tombstone);
+    notify(ChangeEvent::Type::Removed, id);
+    persist();
+}
+
+void NDJSONRepository::update(const Book& book) {
+    auto it = std::find_if(books.begin(), books.end(),
+                           [&book](const Book& b) { return b.getId() == book.getId(); });
+    if (it == books.end())
+        throw std::out_of_range("Book with ID not found");
+
+    *it = book;
+    append(book.toJson());
+    notify(ChangeEvent::Type::Updated, book.getId(), &book);
+    persist();
+}
+
+std::vector<Book> NDJSONRepository::getAll() const {
+    return books;
+}
+
+std::unique_ptr<Book> NDJSONRepository::findById(int id) const {
+    for (const auto& book : books) {
+        if (book.getId() == id)
+            return std::make_unique<Book>(book);
+    }
+    return nullptr;
+}
+
+void NDJSONRepository::forEach(const std::function<void(const Book&)>& visit) const {
+    for (const auto& book : books) visit(book);
+}
+
+void NDJSONRepository::compact() {
+    FileLock lock(fileName.toStdString(), FileLock::Mode::Exclusive);
+    rewrite();
+}
+
+void NDJSONRepository::append(const QJsonObject& record) {
+    pendingLines += QJsonDocument(record).toJson(QJsonDocument::Compact).toStdString();
+    pendingLines += '\n';
+    ++lineCount;
+}
+
+void NDJSONRepository::loadFromFile(const LoadProgress& progress) {
+    const std::size_t minRangeSize = 1 << 20; // not worth a thread below this
+
+    FileLock lock(fileName.toStdString(), FileLock::Mode::Shared);
+
+    books.clear();
+    pendingLines.clear();
+    lineCount = 0;
+
+    QByteArray data;
+    storedCompressed = BlockFile::detect(fileName.toStdString());
+    if (storedCompressed) {
+        compressed = true;
+        std::string content = BlockFile::read(fileName.toStdString());
+        data = QByteArray(content.data(), static_cast<int>(content.size()));
+    } else {
+        QFile file(fileName);
+        if (!file.exists()) return; // Silent if no file yet (valid case)
+        if (!file.open(QIODevice::ReadOnly)) {
+            throw std::runtime_error("Failed to open NDJSON file for reading.");
+        }
+        data = file.readAll();
+        file.close();
+    }
+
+    const std::size_t total = static_cast<std::size_t>(data.size());
+    if (progress && !progress(0, total)) throw LoadCancelled();
+
+    // Split at line boundaries, one range per thread
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max<std::size_t>(1, total / minRangeSize));
+    std::vector<std::future<ParsedRange>> ranges;
+    std::vector<std::size_t> rangeEnds;
+    std::size_t begin = 0;
+    for (std::size_t i = 1; i <= threads && begin < total; ++i) {
+        std::size_t end = i == threads ? total : std::max(begin, total * i / threads);
+        while (end < total && data.constData()[end - 1] != '\n') ++end;
+        ranges.push_back(std::async(i == threads ? std::launch::deferred : std::launch::async,
+                                    parseRange, std::cref(data), begin, end));
+        rangeEnds.push_back(end);
+        begin = end;
+    }
+
+    // Replay in file order; the last record for an id wins and an update
+    // keeps the position of the original add
+    std::vector<std::optional<Book>> slots;
+    std::unordered_map<int, std::size_t> slotOf;
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        ParsedRange range = ranges[i].get();
+        lineCount += range.lines;
+        for (auto& record : range.records) {
+            ids.observe(record.id);
+            auto it = slotOf.find(record.id);
+            if (!record.book) {
+                if (it != slotOf.end()) {
+                    slots[it->second].reset();
+                    slotOf.erase(it);
+                }
+            } else if (it != slotOf.end()) {
+                slots[it->second] = std::move(record.book);
+            } else {
+                slotOf.emplace(record.id, slots.size());
+                slots.push_back(std::move(record.book));
+            }
+        }
+        if (progress && !progress(rangeEnds[i], total)) throw LoadCancelled();
+    }
+
+    books.reserve(slotOf.size());
+    for (auto& slot : slots) {
+        if (slot) books.push_back(std::move(*slot));
+    }
+
+    // A torn final line from an interrupted append must not swallow the next record
+    if (total > 0 && data.constData()[total - 1] != '\n') pendingLines = "\n";
+}
+
+void NDJSONRepository::saveToFile() const {
+    FileLock lock(fileName.toStdString(), FileLock::Mode::Exclusive);
+
+    if (compressed != storedCompressed || supersededLines() >= std::max(CompactionMinimum, books.size())) {
+        rewrite();
+        return;
+    }
+    if (pendingLines.empty()) return;
+
+    if (compressed) {
+        BlockFile::append(fileName.toStdString(), pendingLines);
+        pendingLines.clear();
+        return;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        throw std::runtime_error("Failed to open NDJSON file for writing.");
+    }
+    if (file.write(pendingLines.data(), static_cast<qint64>(pendingLines.size())) != static_cast<qint64>(pendingLines.size())) {
+        throw std::runtime_error("Failed to append to NDJSON file.");
+    }
+    file.close();
+    pendingLines.clear();
+}
+
+void NDJSONRepository::rewrite() const {
+    std::string content;
+    for (const auto& book : books) {
+        content += QJsonDocument(book.toJson()).toJson(QJsonDocument::Compact).toStdString();
+        content += '\n';
+    }
+
+    if (compressed) {
+        BlockFile::write(fileName.toStdString(), content);
+        pendingLines.clear();
+        lineCount = books.size();
+        storedCompressed = true;
+        return;
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        throw std::runtime_error("Failed to open NDJSON file for writing.");
+    }
+    file.write(content.data(), static_cast<qint64>(content.size()));
+    if (!file.commit()) {
+        throw std::runtime_error("Failed to write NDJSON file.");
+    }
+    pendingLines.clear();
+    lineCount = books.size();
+    storedCompressed = false;
+}
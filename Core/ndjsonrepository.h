@@ -0,0 +1,52 @@
+#ifndef NDJSONREPOSITORY_H
+#define NDJSONREPOSITORY_H
+
+#include "repository.h"
+
+#include <QString>
+#include <QJsonObject>
+
+#include <string>
+
+// Append-only JSON lines storage. Every mutation appends one record instead
+// of rewriting the file: a book object for add and update (the last one for
+// an id wins) and {"id": N, "deleted": true} for remove. Lines are parsed in
+// parallel on load. Once superseded lines outnumber live books the file is
+// compacted to one line per book. When compressed, every save appends its
+// records as new blocks and compaction packs them into full-size blocks.
+class NDJSONRepository : public Repository
+{
+public:
+    NDJSONRepository();
+    // progress counts bytes of the file
+    explicit NDJSONRepository(const QString& fileName, const LoadProgress& progress = nullptr);
+    ~NDJSONRepository() override = default;
+
+    void add(const Book& book) override;
+    void remove(int id) override;
+    void update(const Book& book) override;
+    std::vector<Book> getAll() const override;
+    std::unique_ptr<Book> findById(int id) const override;
+    void forEach(const std::function<void(const Book&)>& visit) const override;
+
+    // Rewrites the file with one line per live book
+    void compact();
+    std::size_t supersededLines() const { return lineCount - books.size(); }
+
+private:
+    static constexpr std::size_t CompactionMinimum = 1024; // superseded lines before compaction is considered
+
+    QString fileName;
+    std::vector<Book> books;
+
+    mutable std::string pendingLines;  // records not yet appended to the file
+    mutable std::size_t lineCount = 0; // records in the file, including pending ones
+    mutable bool storedCompressed = false; // format of the file on disk
+
+    void append(const QJsonObject& record);
+    void loadFromFile(const LoadProgress& progress);
+    void saveToFile() const override;
+    void rewrite() const;
+};
+
+#endif // NDJSONREPOSITORY_H
@@ -1,3 +1,78 @@
 #include "repository.h"
 
 Repository::Repository() {}
+
+void Repository::forEach(const std::function<void(const Book&)>& visit) const {
+    for (const auto& book : getAll()) visit(book);
+}
+
+std::vector<Book> Repository::findMatching(const std::function<bool(const Book&)>& match) const {
+    std::vector<Book> result;
+    forEach([&result, &match](const Book& book) {
+        if (match(book)) result.push_back(book);
+    });
+    return result;
+}
+
+void Repository::beginBatch() {
+    ++batchDepth;
+}
+
+void Repository::endBatch() {
+    if (batchDepth == 0) return;
+    if (--batchDepth > 0 || !dirty) return;
+
+    writeBack();
+    dirty = false;
+    ids.save();
+}
+
+void Repository::persist() {
+    if (batchDepth > 0) {
+        dirty = true;
+        return;
+    }
+    writeBack();
+    ids.save();
+}
+
+void Repository::persist(const std::function<void()>& undo) {
+    try {
+        persist();
+    } catch (...) {
+        undo();
+        throw;
+    }
+}
+
+void Repository::setCompressed(bool enabled) {
+    if (compressed == enabled) return;
+    compressed = enabled;
+    persist();
+}
+
+int Repository::subscribe(ChangeListener listener) {
+    listeners.emplace_back(++nextSubscription, std::move(listener));
+    return nextSubscription;
+}
+
+void Repository::unsubscribe(int subscription) {
+    for (auto it = listeners.begin(); it != listeners.end(); ++it) {
+        if (it->first == subscription) {
+            listeners.erase(it);
+            return;
+        }
+    }
+}
+
+void Repository::notify(ChangeEvent::Type type, int id, const Book* book) {
+    ChangeEvent event{type, id, 0, book};
+    for (const auto& [subscription, listener] : listeners) listener(event);
+}
+
+void Repository::notifyMerged(const std::vector<CatalogSync::Change>& changes) {
+    for (const auto& change : changes) {
+        if (change.type == ChangeEvent::Type::Inserted) ids.observe(change.id);
+        notify(change.type, change.id);
+    }
+}
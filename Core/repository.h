@@ -2,8 +2,25 @@
 #define REPOSITORY_H
 
 #include "book.h"
+#include "idallocator.h"
+#include "changeevent.h"
+#include "catalogsync.h"
 #include <vector>
 #include <memory>
+#include <utility>
+#include <functional>
+#include <stdexcept>
+#include <cstddef>
+
+// Called periodically while a repository loads its file; returning false
+// abandons the load, and the constructor then throws LoadCancelled
+using LoadProgress = std::function<bool(std::size_t done, std::size_t total)>;
+
+class LoadCancelled : public std::runtime_error
+{
+public:
+    LoadCancelled() : std::runtime_error("Repository load cancelled") {}
+};
 
 class Repository
 {
@@ -13,8 +30,68 @@ public:
 
     virtual void add(const Book& book) = 0;
     virtual void remove(int id) = 0;
+    virtual void update(const Book& book) = 0;
     virtual std::vector<Book> getAll() const = 0;
     virtual std::unique_ptr<Book> findById(int id) const = 0;
+
+    // Visits every book in storage order without copying the catalog.
+    // The default goes through getAll(); in-memory backends override it.
+    virtual void forEach(const std::function<void(const Book&)>& visit) const;
+
+    // Copies of the books that match, in storage order. The default walks
+    // forEach(); partitioned backends search their parts in parallel.
+    virtual std::vector<Book> findMatching(const std::function<bool(const Book&)>& match) const;
+
+    // Batching: while a batch is open, mutations are kept in memory and
+    // written out once by the outermost endBatch(). Batches nest.
+    virtual void beginBatch();
+    virtual void endBatch();
+    bool inBatch() const { return batchDepth > 0; }
+
+    // Id allocation, O(1) and safe to call from any thread
+    int nextId() { return ids.allocate(); }
+    int reserveIds(int count) { return ids.reserve(count); }
+    void releaseId(int id) { ids.release(id); }
+    void setIdReuse(bool enabled) { ids.setReuse(enabled); }
+
+    // Block-compressed storage (see BlockFile). Compressed files are detected
+    // on load; switching rewrites the file in the new format.
+    virtual void setCompressed(bool enabled);
+    bool isCompressed() const { return compressed; }
+
+    // Change notification; listeners run synchronously on the mutating thread
+    int subscribe(ChangeListener listener);
+    void unsubscribe(int subscription);
+
+    // Picks up changes another process made to the file: only records that
+    // differ from what was last read or written are applied, each with its
+    // change event. Returns the number of records changed. Backends that do
+    // not support it return 0.
+    virtual std::size_t reload() { return 0; }
+
+protected:
+    // Implementations attach the allocator to their side file and observe
+    // every id they load or add
+    IdAllocator ids;
+    bool compressed = false;
+
+    // Called by implementations after every mutation. With undo, a failed
+    // write (such as a MergeConflict) first takes the mutation back out, so
+    // the repository stays as it was.
+    void persist();
+    void persist(const std::function<void()>& undo);
+    void notify(ChangeEvent::Type type, int id, const Book* book = nullptr);
+    void notifyMerged(const std::vector<CatalogSync::Change>& changes); // also observes inserted ids
+    virtual void saveToFile() const = 0;
+    // Writes pending changes out. Backends that share their file with other
+    // processes lock it and merge the other side's changes first.
+    virtual void writeBack() { saveToFile(); }
+
+private:
+    int batchDepth = 0;
+    bool dirty = false;
+    int nextSubscription = 0;
+    std::vector<std::pair<int, ChangeListener>> listeners;
 };
 
 #endif // REPOSITORY_H
@@ -0,0 +1,267 @@
+#include "shardedrepository.h"
+
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+// Shard placement must not change between builds or platforms, so neither
+// std::hash is used here
+std::uint64_t mixId(int id) {
+    std::uint64_t x = static_cast<std::uint32_t>(id);
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+std::uint64_t hashText(const std::string& text) {
+    std::uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : text) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+}
+
+ShardedRepository::ShardedRepository(const std::string& fileName, std::size_t shardCount, Partition partition,
+                                     const ShardFactory& openShard, const LoadProgress& progress)
+    : partition(partition), count(shardCount) {
+    if (shardCount == 0) throw std::invalid_argument("A sharded repository needs at least one shard");
+
+    ids.attach(fileName + ".ids", fileName);
+    std::size_t total = shardCount;
+    while (std::filesystem::exists(shardFileName(fileName, total))) ++total;
+    openShards(fileName, total, openShard, progress);
+
+    for (std::size_t k = 0; k < shards.size(); ++k) {
+        shards[k]->forEach([this, k](const Book& book) {
+            ids.observe(book.getId());
+            if (this->partition == Partition::ByGenre) shardOfId[book.getId()] = k;
+        });
+        watchShard(k);
+    }
+    compressed = shards.front()->isCompressed();
+
+    moveMisplacedBooks();
+    retireSurplusShards(fileName);
+}
+
+std::string ShardedRepository::shardFileName(const std::string& fileName, std::size_t index) {
+    std::filesystem::path path(fileName);
+    std::string name = path.stem().string() + "." + std::to_string(index) + path.extension().string();
+    return (path.parent_path() / name).string();
+}
+
+void ShardedRepository::openShards(const std::string& fileName, std::size_t total, const ShardFactory& openShard,
+                                   const LoadProgress& progress) {
+    std::mutex progressMutex;
+    std::vector<std::pair<std::size_t, std::size_t>> counts(total); // done/total per shard
+    std::atomic<bool> cancelled{false};
+
+    std::vector<std::future<std::unique_ptr<Repository>>> pending;
+    for (std::size_t k = 0; k < total; ++k) {
+        pending.push_back(std::async(std::launch::async, [&, k] {
+            LoadProgress shardProgress;
+            if (progress) {
+                shardProgress = [&, k](std::size_t done, std::size_t total) {
+                    std::lock_guard<std::mutex> lock(progressMutex);
+                    counts[k] = {done, total};
+                    std::size_t allDone = 0, allTotal = 0;
+                    for (const auto& [shardDone, shardTotal] : counts) {
+                        allDone += shardDone;
+                        allTotal += shardTotal;
+                    }
+                    if (!cancelled && !progress(allDone, allTotal)) cancelled = true;
+                    return !cancelled;
+                };
+            }
+            return openShard(shardFileName(fileName, k), shardProgress);
+        }));
+    }
+
+    // Wait for every shard before reporting a failure; the loaders use locals of this frame
+    std::exception_ptr error;
+    for (auto& shard : pending) {
+        try {
+            shards.push_back(shard.get());
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void ShardedRepository::retireSurplusShards(const std::string& fileName) {
+    // Their books were moved out by moveMisplacedBooks()
+    for (std::size_t k = count; k < shards.size(); ++k) std::filesystem::remove(shardFileName(fileName, k));
+    shards.resize(count);
+}
+
+void ShardedRepository::watchShard(std::size_t index) {
+    // Shard events (including changes merged in from other processes) are
+    // passed on; the id -> shard map follows them
+    shards[index]->subscribe([this, index](const ChangeEvent& event) {
+        if (event.type == ChangeEvent::Type::Inserted) {
+            ids.observe(event.id);
+            if (partition == Partition::ByGenre) shardOfId[event.id] = index;
+        } else if (event.type == ChangeEvent::Type::Removed && partition == Partition::ByGenre) {
+            auto it = shardOfId.find(event.id);
+            if (it != shardOfId.end() && it->second == index) shardOfId.erase(it);
+        }
+        if (!moving) notify(event.type, event.id, event.book);
+    });
+}
+
+void ShardedRepository::moveMisplacedBooks() {
+    std::vector<std::pair<std::size_t, Book>> misplaced;
+    for (std::size_t k = 0; k < shards.size(); ++k) {
+        shards[k]->forEach([this, k, &misplaced](const Book& book) {
+            if (homeShard(book) != k) misplaced.emplace_back(k, book);
+        });
+    }
+    if (misplaced.empty()) return;
+
+    beginBatch();
+    moving = true;
+    try {
+        for (const auto& [from, book] : misplaced) {
+            shards[from]->remove(book.getId());
+            shards[homeShard(book)]->add(book);
+        }
+    } catch (...) {
+        moving = false;
+        endBatch();
+        throw;
+    }
+    moving = false;
+    endBatch();
+}
+
+std::size_t ShardedRepository::homeShard(const Book& book) const {
+    std::uint64_t h = partition == Partition::ById ? mixId(book.getId()) : hashText(book.getGenre());
+    return static_cast<std::size_t>(h % count);
+}
+
+std::size_t ShardedRepository::findShard(int id) const {
+    if (partition == Partition::ById) return static_cast<std::size_t>(mixId(id) % count);
+
+    auto it = shardOfId.find(id);
+    if (it == shardOfId.end()) throw std::out_of_range("Book with ID not found in sharded repository");
+    return it->second;
+}
+
+void ShardedRepository::add(const Book& book) {
+    shards[homeShard(book)]->add(book);
+    persist();
+}
+
+void ShardedRepository::remove(int id) {
+    shards[findShard(id)]->remove(id);
+    persist();
+}
+
+void ShardedRepository::update(const Book& book) {
+    std::size_t from = findShard(book.getId());
+    std::size_t to = homeShard(book);
+    if (from == to) {
+        shards[from]->update(book);
+        persist();
+        return;
+    }
+
+    // The genre moved the book to another shard: the remove and the add are
+    // written by one batch, and listeners see a single update
+    auto old = shards[from]->findById(book.getId());
+    beginBatch();
+    moving = true;
+    try {
+        shards[from]->remove(book.getId());
+        try {
+            shards[to]->add(book);
+        } catch (...) {
+            shards[from]->add(*old);
+            throw;
+        }
+    } catch (...) {
+        moving = false;
+        endBatch();
+        throw;
+    }
+    moving = false;
+    notify(ChangeEvent::Type::Updated, book.getId(), &book);
+    endBatch();
+}
+
+std::vector<Book> ShardedRepository::getAll() const {
+    std::vector<Book> all;
+    for (const auto& shard : shards) {
+        std::vector<Book> part = shard->getAll();
+        all.insert(all.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+    }
+    return all;
+}
+
+std::unique_ptr<Book> ShardedRepository::findById(int id) const {
+    if (partition == Partition::ByGenre && !shardOfId.count(id)) return nullptr;
+    return shards[findShard(id)]->findById(id);
+}
+
+void ShardedRepository::forEach(const std::function<void(const Book&)>& visit) const {
+    for (const auto& shard : shards) shard->forEach(visit);
+}
+
+std::vector<Book> ShardedRepository::findMatching(const std::function<bool(const Book&)>& match) const {
+    std::vector<std::future<std::vector<Book>>> parts;
+    for (const auto& shard : shards) {
+        const Repository* part = shard.get();
+        parts.push_back(std::async(std::launch::async, [part, &match] { return part->findMatching(match); }));
+    }
+
+    std::vector<Book> result;
+    for (auto& part : parts) {
+        std::vector<Book> found = part.get();
+        result.insert(result.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    }
+    return result;
+}
+
+void ShardedRepository::beginBatch() {
+    Repository::beginBatch();
+    for (auto& shard : shards) shard->beginBatch();
+}
+
+void ShardedRepository::endBatch() {
+    if (!inBatch()) return;
+
+    // Shards that were not touched in the batch have nothing to write
+    std::exception_ptr error;
+    for (auto& shard : shards) {
+        try {
+            shard->endBatch();
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    Repository::endBatch();
+    if (error) std::rethrow_exception(error);
+}
+
+void ShardedRepository::setCompressed(bool enabled) {
+    for (auto& shard : shards) shard->setCompressed(enabled);
+    compressed = enabled;
+}
+
+std::size_t ShardedRepository::reload() {
+    std::size_t changed = 0;
+    for (auto& shard : shards) changed += shard->reload();
+    return changed;
+}
@@ -0,0 +1,69 @@
+#ifndef SHARDEDREPOSITORY_H
+#define SHARDEDREPOSITORY_H
+
+#include "repository.h"
+
+#include <string>
+#include <unordered_map>
+
+// Spreads the catalog over several shard files, each an ordinary repository
+// of its own ("library.csv" with 4 shards is library.0.csv ... library.3.csv).
+// A book's shard is picked from a hash of its id or of its genre. Shards load
+// in parallel, a mutation rewrites only the shard it touches, and searches run
+// over every shard at once. Books found in the wrong shard are moved to the
+// right one on load; shard files beyond the shard count (left by a larger
+// count) are emptied into the others and deleted.
+class ShardedRepository : public Repository
+{
+public:
+    enum class Partition { ById, ByGenre };
+
+    // Opens one shard; progress is passed on to the shard's constructor
+    using ShardFactory = std::function<std::unique_ptr<Repository>(const std::string& fileName,
+                                                                   const LoadProgress& progress)>;
+
+    // progress sums the shards' own progress units; throws
+    // std::invalid_argument if shardCount is 0
+    ShardedRepository(const std::string& fileName, std::size_t shardCount, Partition partition,
+                      const ShardFactory& openShard, const LoadProgress& progress = nullptr);
+    ~ShardedRepository() override = default;
+
+    void add(const Book& book) override;
+    void remove(int id) override;
+    void update(const Book& book) override;
+    std::vector<Book> getAll() const override;
+    std::unique_ptr<Book> findById(int id) const override;
+    void forEach(const std::function<void(const Book&)>& visit) const override;
+    // Searches the shards in parallel, so match must be safe to call from
+    // several threads at once
+    std::vector<Book> findMatching(const std::function<bool(const Book&)>& match) const override;
+
+    void beginBatch() override;
+    void endBatch() override;
+    void setCompressed(bool enabled) override;
+    std::size_t reload() override;
+
+    std::size_t shardCount() const { return count; }
+    const Repository& shard(std::size_t index) const { return *shards.at(index); }
+
+    // "library.csv", 2 -> "library.2.csv"
+    static std::string shardFileName(const std::string& fileName, std::size_t index);
+
+private:
+    Partition partition;
+    std::size_t count;
+    std::vector<std::unique_ptr<Repository>> shards;
+    std::unordered_map<int, std::size_t> shardOfId; // ByGenre only; ById shards are computed
+    bool moving = false;                            // a cross-shard move reports one Updated
+
+    std::size_t homeShard(const Book& book) const;
+    std::size_t findShard(int id) const;            // throws std::out_of_range for unknown ids
+    void openShards(const std::string& fileName, std::size_t total, const ShardFactory& openShard,
+                    const LoadProgress& progress);
+    void watchShard(std::size_t index);
+    void moveMisplacedBooks();
+    void retireSurplusShards(const std::string& fileName);
+    void saveToFile() const override {}             // every shard writes its own file
+};
+
+#endif // SHARDEDREPOSITORY_H
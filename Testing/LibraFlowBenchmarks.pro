@@ -0,0 +1,18 @@
+# Benchmark executable, entry point in benchmarks.cpp. The table model is the
+# only UI code it needs, and it depends on QtCore alone.
+
+TEMPLATE = app
+TARGET = LibraFlowBenchmarks
+
+include(../libraflow.pri)
+
+INCLUDEPATH += $$PWD $$PWD/../UI
+
+SOURCES += \
+    benchmarks.cpp \
+    cataloggenerator.cpp \
+    ../UI/booktablemodel.cpp
+
+HEADERS += \
+    cataloggenerator.h \
+    ../UI/booktablemodel.h
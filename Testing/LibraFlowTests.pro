@@ -0,0 +1,19 @@
+# Test executable: every suite, entry point in tests.cpp
+
+TEMPLATE = app
+TARGET = LibraFlowTests
+
+include(../libraflow.pri)
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    tests.cpp \
+    testframework.cpp \
+    librarytests.cpp \
+    cataloggenerator.cpp
+
+HEADERS += \
+    testframework.h \
+    librarytests.h \
+    cataloggenerator.h
@@ -0,0 +1,390 @@
+// Performance benchmarks over synthetic catalogs (see CatalogGenerator):
+//
+//   benchmarks [--sizes LIST] [--filter TEXT] [--min-time SECONDS] [--seed N]
+//
+// LIST holds catalog sizes separated by commas, with optional k/M suffixes
+// (default 1k,100k,1M; 10M is supported but needs several GB of memory).
+// Only benchmarks whose name contains TEXT run. Each benchmark repeats its
+// operation until it has run for at least --min-time (default 0.3 s).
+//
+// Results go to standard output as one JSON object per line, always with the
+// same keys in the same order, e.g.
+//
+//   {"benchmark":"csv.load","books":100000,"iterations":4,"ns_per_op":81234567,"min_ns":80011223,"max_ns":83344556,"bytes":4123456}
+//
+// Times are per operation; bytes is the file size for load and save
+// benchmarks and 0 otherwise. Catalog files are created and deleted in the
+// working directory, so run it from a scratch directory like the tests.
+
+#include "cataloggenerator.h"
+#include "controller.h"
+#include "csvrepository.h"
+#include "jsonrepository.h"
+#include "exporter.h"
+#include "filter.h"
+#include "booktablemodel.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Settings
+{
+    std::vector<std::size_t> sizes{1000, 100000, 1000000};
+    std::string filter;
+    double minSeconds = 0.3;
+    std::uint64_t seed = 42;
+};
+
+const std::size_t MaxIterations = 1000000;
+
+// Results are added here so that the compiler cannot drop unused work
+std::size_t sink = 0;
+
+const char* const csvFile = "bench.csv";
+const char* const compressedFile = "bench.compressed.csv";
+const char* const jsonFile = "bench.json";
+
+int usage() {
+    std::cerr << "usage: benchmarks [--sizes LIST] [--filter TEXT] [--min-time SECONDS] [--seed N]\n"
+              << "LIST: catalog sizes separated by commas, e.g. 1k,100k,1M,10M\n";
+    return 2;
+}
+
+// "250", "100k", "1M"; 0 if malformed
+std::size_t parseSize(const std::string& text) {
+    std::size_t digits = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) ++digits;
+    if (digits == 0 || digits + 1 < text.size()) return 0;
+
+    std::size_t value = std::stoull(text.substr(0, digits));
+    if (digits == text.size()) return value;
+    switch (text[digits]) {
+    case 'k': case 'K': return value * 1000;
+    case 'm': case 'M': return value * 1000000;
+    }
+    return 0;
+}
+
+std::uint64_t fileSize(const std::string& fileName) {
+    std::ifstream in(fileName, std::ios::binary | std::ios::ate);
+    return in ? static_cast<std::uint64_t>(in.tellg()) : 0;
+}
+
+void removeCatalog(const std::string& fileName) {
+    std::remove(fileName.c_str());
+    std::remove((fileName + ".ids").c_str());
+    std::remove((fileName + ".lock").c_str());
+}
+
+void writeCatalog(const std::string& fileName, const std::vector<Book>& books, ExportFormat format) {
+    removeCatalog(fileName);
+    std::ofstream out(fileName, std::ios::binary);
+    exportBooks(books, out, format);
+    if (!out) throw std::runtime_error("Failed to write " + fileName);
+}
+
+// Spreads the iterations of a benchmark over the catalog; distinct for the
+// first `books` iterations
+int pickId(std::size_t iteration, std::size_t books) {
+    return static_cast<int>((iteration * 7919) % books) + 1;
+}
+
+class Runner
+{
+public:
+    Runner(std::size_t books, const Settings& settings) : books(books), settings(settings) {}
+
+    bool wanted(const std::string& name) const {
+        return settings.filter.empty() || name.find(settings.filter) != std::string::npos;
+    }
+    bool wantedAny(std::initializer_list<std::string> names) const {
+        return std::any_of(names.begin(), names.end(), [this](const std::string& name) { return wanted(name); });
+    }
+
+    // Times op(i) for i = 0, 1, ... until the minimum time has passed, or
+    // exactly `iterations` times when given. prepare(i) runs before each
+    // call and is not timed. Returns how often op ran (0 if filtered out).
+    std::size_t run(const std::string& name, const std::function<void(std::size_t)>& op,
+                    const std::function<void(std::size_t)>& prepare = nullptr,
+                    std::size_t iterations = 0, std::size_t maxIterations = MaxIterations) {
+        if (!wanted(name)) return 0;
+        Timing timing = measure(op, prepare, iterations, maxIterations);
+        report(name, timing.done, timing.total / timing.done, timing.fastest, timing.slowest);
+        return timing.done;
+    }
+
+    // The same repetitions as run(), but not reported: setup that other
+    // benchmarks need when this one is filtered out
+    std::size_t runUnreported(const std::function<void(std::size_t)>& op, std::size_t maxIterations = MaxIterations) {
+        return measure(op, nullptr, 0, maxIterations).done;
+    }
+
+    // Size of the file the next report refers to
+    void setBytes(std::uint64_t value) { bytes = value; }
+
+private:
+    struct Timing
+    {
+        std::size_t done = 0;
+        double total = 0;
+        double fastest = std::numeric_limits<double>::max();
+        double slowest = 0;
+    };
+
+    std::size_t books;
+    const Settings& settings;
+    std::uint64_t bytes = 0;
+
+    Timing measure(const std::function<void(std::size_t)>& op, const std::function<void(std::size_t)>& prepare,
+                   std::size_t iterations, std::size_t maxIterations) const {
+        using Clock = std::chrono::steady_clock;
+        Timing timing;
+        while (iterations ? timing.done < iterations
+                          : (timing.done == 0 || (timing.total < settings.minSeconds * 1e9 && timing.done < maxIterations))) {
+            if (prepare) prepare(timing.done);
+            auto start = Clock::now();
+            op(timing.done);
+            double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            timing.total += elapsed;
+            timing.fastest = std::min(timing.fastest, elapsed);
+            timing.slowest = std::max(timing.slowest, elapsed);
+            ++timing.done;
+        }
+        return timing;
+    }
+
+    void report(const std::string& name, std::size_t iterations, double mean, double fastest, double slowest) {
+        std::cout << "{\"benchmark\":\"" << name << "\""
+                  << ",\"books\":" << books
+                  << ",\"iterations\":" << iterations
+                  << ",\"ns_per_op\":" << std::llround(mean)
+                  << ",\"min_ns\":" << std::llround(fastest)
+                  << ",\"max_ns\":" << std::llround(slowest)
+                  << ",\"bytes\":" << bytes << "}" << std::endl;
+        bytes = 0;
+    }
+};
+
+// Load and save of one repository file. A save is one changed book written
+// back, which is what every mutation outside a batch costs.
+template <typename Open>
+void benchmarkStorage(Runner& runner, const std::string& prefix, const std::string& fileName,
+                      std::size_t count, Open open) {
+    runner.setBytes(fileSize(fileName));
+    runner.run(prefix + ".load", [&](std::size_t) { open(); });
+
+    if (!runner.wanted(prefix + ".save")) return;
+    std::unique_ptr<Repository> repo = open();
+    runner.setBytes(fileSize(fileName));
+    runner.run(prefix + ".save", [&](std::size_t i) {
+        auto book = repo->findById(pickId(i, count));
+        book->setYear(book->getYear() == 2000 ? 2001 : 2000);
+        repo->update(*book);
+    });
+}
+
+void benchmarkRepository(Runner& runner, const std::vector<Book>& books) {
+    std::size_t count = books.size();
+
+    writeCatalog(csvFile, books, ExportFormat::Csv);
+    benchmarkStorage(runner, "csv", csvFile, count,
+                     [] { return std::make_unique<CSVRepository>(csvFile); });
+
+    if (runner.wantedAny({"csv.compressed.load", "csv.compressed.save"})) {
+        // Same catalog in block-compressed form: less to read, more to decode
+        writeCatalog(compressedFile, books, ExportFormat::Csv);
+        CSVRepository(compressedFile).setCompressed(true);
+        benchmarkStorage(runner, "csv.compressed", compressedFile, count,
+                         [] { return std::make_unique<CSVRepository>(compressedFile); });
+        removeCatalog(compressedFile);
+    }
+
+    if (runner.wantedAny({"json.load", "json.save"})) {
+        writeCatalog(jsonFile, books, ExportFormat::JsonArray);
+        benchmarkStorage(runner, "json", jsonFile, count,
+                         [] { return std::make_unique<JSONRepository>(QString(jsonFile)); });
+        removeCatalog(jsonFile);
+    }
+
+    if (runner.wantedAny({"csv.findById", "csv.remove"})) {
+        writeCatalog(csvFile, books, ExportFormat::Csv);
+        CSVRepository repo(csvFile);
+        runner.run("csv.findById", [&](std::size_t i) {
+            sink += repo.findById(pickId(i, count))->getYear();
+        });
+        // Every remove rewrites the file; at most half the catalog goes
+        runner.run("csv.remove", [&](std::size_t i) { repo.remove(pickId(i, count)); },
+                   nullptr, 0, std::max<std::size_t>(1, count / 2));
+    }
+    removeCatalog(csvFile);
+}
+
+void benchmarkController(Runner& runner, const std::vector<Book>& books) {
+    if (!runner.wantedAny({"controller.filterBooks.genre", "controller.filterBooks.author",
+                           "controller.filterBooks.year", "controller.filterBooks.title",
+                           "controller.filterBooks.yearRange", "controller.filterBooks.combined",
+                           "controller.update", "controller.undo", "controller.redo", "table.refresh",
+                           "table.refresh.sorted", "table.refresh.filtered", "snapshot.publish"})) return;
+
+    std::size_t count = books.size();
+    writeCatalog(csvFile, books, ExportFormat::Csv);
+    Controller controller(std::make_unique<CSVRepository>(csvFile));
+
+    // The Filter strategies, plus the title and year range conditions the
+    // filter panel builds
+    std::vector<std::pair<std::string, std::function<bool(const Book&)>>> filters;
+    auto genre = std::make_shared<GenreFilter>("History");
+    auto author = std::make_shared<AuthorFilter>(CatalogGenerator::authorName(0));
+    auto year = std::make_shared<YearFilter>(2020);
+    filters.emplace_back("genre", [genre](const Book& book) { return genre->matches(book); });
+    filters.emplace_back("author", [author](const Book& book) { return author->matches(book); });
+    filters.emplace_back("year", [year](const Book& book) { return year->matches(book); });
+    filters.emplace_back("title", [](const Book& book) { return book.getTitle().find("Dragon") != std::string::npos; });
+    filters.emplace_back("yearRange", [](const Book& book) { return book.getYear() >= 1990 && book.getYear() <= 2010; });
+    filters.emplace_back("combined", [genre](const Book& book) {
+        return genre->matches(book) && book.getYear() >= 1990 && book.getYear() <= 2010;
+    });
+    for (const auto& filter : filters) {
+        runner.run("controller.filterBooks." + filter.first,
+                   [&](std::size_t) { sink += controller.filterBooks(filter.second).size(); });
+    }
+
+    // Undo and redo replay the updates, so all three run equally often; the
+    // updates still run, unreported, when only undo or redo is wanted. The
+    // history must keep every update, and each touches a different book.
+    std::size_t maxUpdates = std::max<std::size_t>(1, count / 2);
+    controller.setHistoryLimits(maxUpdates, std::numeric_limits<std::size_t>::max());
+    auto beforeUpdates = controller.snapshot();
+    auto updateBook = [&](std::size_t i) {
+        auto book = controller.findBook(pickId(i, count));
+        book->setYear(book->getYear() == 2000 ? 2001 : 2000);
+        controller.updateBook(*book);
+    };
+    std::size_t updates = runner.run("controller.update", updateBook, nullptr, 0, maxUpdates);
+    if (!updates && runner.wantedAny({"controller.undo", "controller.redo"}))
+        updates = runner.runUnreported(updateBook, maxUpdates);
+    if (updates) {
+        auto afterUpdates = controller.snapshot();
+        auto sameYears = [&](const CatalogSnapshot& expected) {
+            auto current = controller.snapshot();
+            for (std::size_t i = 0; i < updates; ++i) {
+                int id = pickId(i, count);
+                if (current->findById(id)->getYear() != expected.findById(id)->getYear()) return false;
+            }
+            return true;
+        };
+        // Redo needs the updates undone first, timed or not
+        if (!runner.run("controller.undo", [&](std::size_t) { controller.undo(); }, nullptr, updates)) {
+            for (std::size_t i = 0; i < updates; ++i) controller.undo();
+        }
+        if (!sameYears(*beforeUpdates)) throw std::runtime_error("controller.undo did not undo every update");
+        if (runner.run("controller.redo", [&](std::size_t) { controller.redo(); }, nullptr, updates) &&
+            !sameYears(*afterUpdates)) {
+            throw std::runtime_error("controller.redo did not redo every update");
+        }
+    }
+
+    // MainWindow::refreshTable hands the current snapshot to the table model.
+    // Sorted views walk the snapshot's sort order, which a new snapshot builds
+    // on first use, so those get a fresh copy of the catalog every time.
+    BookTableModel model;
+    auto current = controller.snapshot();
+    runner.run("table.refresh", [&](std::size_t) { model.setSnapshot(controller.snapshot()); });
+
+    std::shared_ptr<const CatalogSnapshot> fresh;
+    auto copySnapshot = [&](std::size_t i) {
+        fresh.reset();
+        fresh = std::make_shared<CatalogSnapshot>(current->version() + i + 1, current->books());
+    };
+    model.sort(BookTableModel::TitleColumn);
+    runner.run("table.refresh.sorted", [&](std::size_t) { model.setSnapshot(fresh); }, copySnapshot);
+    model.sort(-1);
+    model.setFilter(filters.front().second);
+    runner.run("table.refresh.filtered", [&](std::size_t) { model.setSnapshot(controller.snapshot()); });
+    // Controller::publish after one update: the changed chunk is copied and
+    // the rest is shared with the previous snapshot
+    runner.run("snapshot.publish", [&](std::size_t i) {
+        Book changed = current->at(i % current->size());
+        changed.setYear(changed.getYear() == 2000 ? 2001 : 2000);
+        fresh = current->withChanges(current->version() + i + 1, {{changed.getId(), &changed}});
+    });
+
+    removeCatalog(csvFile);
+}
+
+void benchmarkSize(std::size_t count, const Settings& settings) {
+    Runner runner(count, settings);
+
+    std::vector<Book> books;
+    runner.run("generate", [&](std::size_t) {
+        books.clear();
+        books = CatalogGenerator(settings.seed).generate(count);
+    }, nullptr, 0, 10);
+    if (books.empty()) books = CatalogGenerator(settings.seed).generate(count);
+
+    benchmarkRepository(runner, books);
+    benchmarkController(runner, books);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) return usage();
+        std::string value = argv[++i];
+
+        if (option == "--sizes") {
+            settings.sizes.clear();
+            std::stringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                std::size_t size = parseSize(item);
+                if (size == 0) return usage();
+                settings.sizes.push_back(size);
+            }
+            if (settings.sizes.empty()) return usage();
+        } else if (option == "--filter") {
+            settings.filter = value;
+        } else if (option == "--min-time") {
+            settings.minSeconds = std::atof(value.c_str());
+        } else if (option == "--seed") {
+            settings.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+            return usage();
+        }
+    }
+
+    try {
+        for (std::size_t size : settings.sizes) benchmarkSize(size, settings);
+        std::cerr << "checksum " << sink << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "benchmarks: " << e.what() << "\n";
+        removeCatalog(csvFile);
+        removeCatalog(compressedFile);
+        removeCatalog(jsonFile);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "cataloggenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+const char* const firstNames[] = {
+    "Anna", "Ben", "Clara", "David", "Elena", "Felix", "Grace", "Henry", "Iris", "James",
+    "Karen", "Leo", "Maria", "Nathan", "Olivia", "Paul", "Quinn", "Rosa", "Samuel", "Tara",
+    "Ursula", "Victor", "Wendy", "Xavier", "Yara", "Zoe", "Arthur", "Beatrice", "Conrad", "Diana",
+    "Edgar", "Fiona", "George", "Helen", "Isaac", "Julia", "Kevin", "Lucy", "Martin", "Nora",
+    "Oscar", "Penelope", "Robert", "Sophie", "Thomas", "Ursa", "Walter", "Yvonne"
+};
+
+const char* const lastNames[] = {
+    "Adams", "Baker", "Carter", "Dalton", "Ellis", "Fischer", "Garcia", "Hughes", "Ibsen", "Jensen",
+    "Keller", "Lambert", "Morgan", "Nolan", "O'Brien", "Parker", "Quill", "Reed", "Schmidt", "Turner",
+    "Underwood", "Vance", "Walsh", "Young", "Zimmer", "Abbott", "Brooks", "Crane", "Dubois", "Evans",
+    "Ford", "Grant", "Hayes", "Irving", "Jordan", "Kowalski", "Lowe", "Marsh", "Novak", "Owens",
+    "Price", "Russo", "Stone", "Thorne", "Vogel", "Wilde", "Yates", "Zeller"
+};
+
+const char* const titleWords[] = {
+    "Shadow", "Empire", "Garden", "River", "Night", "Stars", "Winter", "Crown", "Silent", "Storm",
+    "Lost", "City", "Heart", "Iron", "Glass", "Dragon", "House", "Secret", "Last", "Golden",
+    "Ocean", "Fire", "Memory", "Dark", "Light", "Kingdom", "Song", "War", "Summer", "Forest",
+    "Edge", "Return", "Journey", "Stone", "Hidden", "Mountain", "Letters", "Daughter", "Machine", "Time",
+    "Beyond", "Tower", "Wild", "Blood", "Paper", "Salt", "Echo", "Voyage", "North", "Broken",
+    "Bright", "Colony", "Harbor", "Fallen", "Orbit", "Promise", "Sea", "Dust", "Thief", "Legacy",
+    "of", "the", "and", "in"
+};
+
+struct WeightedGenre { const char* name; int weight; };
+
+const WeightedGenre genreWeights[] = {
+    {"Fantasy", 30}, {"SF", 25}, {"Romance", 20}, {"Drama", 15}, {"History", 10}
+};
+
+// Titles of one to eight words
+const int wordCountWeights[] = {8, 22, 28, 20, 11, 6, 3, 2};
+
+const std::size_t firstNameCount = std::size(firstNames);
+const std::size_t lastNameCount = std::size(lastNames);
+const int earliestYear = 1450;
+
+}
+
+const std::size_t CatalogGenerator::MaxAuthors = firstNameCount * 26 * lastNameCount;
+
+CatalogGenerator::CatalogGenerator(std::uint64_t seed)
+    : CatalogGenerator(seed, Options())
+{
+}
+
+CatalogGenerator::CatalogGenerator(std::uint64_t seed, Options options)
+    : options(options), random(seed), nextId(options.firstId)
+{
+    if (options.authors == 0 || options.authors > MaxAuthors) {
+        throw std::invalid_argument("Author count must be between 1 and " + std::to_string(MaxAuthors));
+    }
+    if (options.latestYear < earliestYear) {
+        throw std::invalid_argument("Latest year must not be before " + std::to_string(earliestYear));
+    }
+
+    authorWeights.reserve(options.authors);
+    double total = 0;
+    for (std::size_t rank = 0; rank < options.authors; ++rank) {
+        total += 1.0 / std::pow(static_cast<double>(rank + 1), options.zipfExponent);
+        authorWeights.push_back(total);
+    }
+}
+
+Book CatalogGenerator::next()
+{
+    double pick = uniform() * authorWeights.back();
+    std::size_t rank = std::upper_bound(authorWeights.begin(), authorWeights.end(), pick) - authorWeights.begin();
+    rank = std::min(rank, authorWeights.size() - 1);
+
+    std::string bookTitle = title();
+    std::string bookGenre = genre();
+    int bookYear = year();
+    return Book(bookTitle, authorName(rank), bookGenre, bookYear, nextId++);
+}
+
+std::vector<Book> CatalogGenerator::generate(std::size_t count)
+{
+    std::vector<Book> books;
+    books.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) books.push_back(next());
+    return books;
+}
+
+std::string CatalogGenerator::authorName(std::size_t rank)
+{
+    if (rank >= MaxAuthors) throw std::out_of_range("Author rank out of range");
+
+    // Scatter the ranks so that popular authors are not alphabetical neighbours
+    std::size_t index = (rank * 7919 + 104729) % MaxAuthors;
+    std::string name = firstNames[index % firstNameCount];
+    index /= firstNameCount;
+    name += ' ';
+    name += static_cast<char>('A' + index % 26);
+    name += ". ";
+    name += lastNames[index / 26];
+    return name;
+}
+
+double CatalogGenerator::uniform()
+{
+    return (random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+std::size_t CatalogGenerator::below(std::size_t bound)
+{
+    return static_cast<std::size_t>(random() % bound);
+}
+
+std::string CatalogGenerator::title()
+{
+    int total = 0;
+    for (int weight : wordCountWeights) total += weight;
+    int pick = static_cast<int>(below(total));
+    std::size_t words = 1;
+    for (int weight : wordCountWeights) {
+        if (pick < weight) break;
+        pick -= weight;
+        ++words;
+    }
+
+    // Fillers ("of", "the", ...) never start a title
+    const std::size_t nounCount = std::size(titleWords) - 4;
+    std::string text = below(10) < 3 ? "The " : "";
+    text += titleWords[below(nounCount)];
+    for (std::size_t i = 1; i < words; ++i) {
+        text += ' ';
+        text += titleWords[below(std::size(titleWords))];
+    }
+    return text;
+}
+
+std::string CatalogGenerator::genre()
+{
+    int total = 0;
+    for (const auto& genre : genreWeights) total += genre.weight;
+    int pick = static_cast<int>(below(total));
+    for (const auto& genre : genreWeights) {
+        if (pick < genre.weight) return genre.name;
+        pick -= genre.weight;
+    }
+    return genreWeights[0].name;
+}
+
+int CatalogGenerator::year()
+{
+    // Exponentially distributed age: most books are recent, a few are old
+    double age = -options.meanAge * std::log(1.0 - uniform());
+    int year = options.latestYear - static_cast<int>(age);
+    return std::max(year, earliestYear);
+}
@@ -0,0 +1,57 @@
+#ifndef CATALOGGENERATOR_H
+#define CATALOGGENERATOR_H
+
+#include "book.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Deterministic synthetic catalogs for benchmarks and tests. The same seed
+// and options always give the same books: only the raw output of
+// std::mt19937_64 is used, not the standard distributions, whose results
+// differ between standard libraries.
+//
+// Authors follow a Zipf distribution (a few prolific authors and a long
+// tail), titles have one to eight words with most around three, genres are
+// unevenly popular, and publication years are skewed towards recent decades.
+// Ids count up from firstId.
+class CatalogGenerator
+{
+public:
+    struct Options
+    {
+        std::size_t authors = 20000;   // distinct authors, at most MaxAuthors
+        double zipfExponent = 1.07;    // larger means fewer, more prolific authors
+        double meanAge = 18;           // mean age of a book in years
+        int latestYear = 2025;
+        int firstId = 1;
+    };
+
+    static const std::size_t MaxAuthors;
+
+    explicit CatalogGenerator(std::uint64_t seed);
+    CatalogGenerator(std::uint64_t seed, Options options); // throws std::invalid_argument
+
+    Book next();
+    std::vector<Book> generate(std::size_t count);
+
+    // Rank 0 is the most prolific author
+    static std::string authorName(std::size_t rank);
+
+private:
+    Options options;
+    std::mt19937_64 random;
+    std::vector<double> authorWeights; // cumulative Zipf weights by rank
+    int nextId;
+
+    double uniform(); // [0, 1)
+    std::size_t below(std::size_t bound);
+    std::string title();
+    std::string genre();
+    int year();
+};
+
+#endif // CATALOGGENERATOR_H
@@ -2,10 +2,94 @@
 #include "book.h"
 #include "csvrepository.h"
 #include "jsonrepository.h"
+#include "ndjsonrepository.h"
 #include "controller.h"
+#include "writerpipeline.h"
+#include "metrics.h"
+#include "csvimporter.h"
+#include "blockfile.h"
+#include "converter.h"
+#include "batchprocessor.h"
+#include "queryserver.h"
+#include "filewatcher.h"
+#include "shardedrepository.h"
+#include "replication.h"
+#include "deltasync.h"
+#include "cataloggenerator.h"
+#include "exporter.h"
 #include <fstream>
+#include <sstream>
 #include <memory>
 #include <cstdio> // For std::remove
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// In-memory repository that counts how often it is written out
+class CountingRepository : public Repository {
+public:
+    mutable int saves = 0; // counted by the const saveToFile()
+    bool failAdds = false;
+    int failAddOf = 0; // only the add of this id fails
+
+    CountingRepository() = default;
+    // Every save also writes the books to fileName as CSV
+    explicit CountingRepository(std::string fileName) : fileName(std::move(fileName)) {}
+
+    void add(const Book& book) override {
+        if (failAdds || (failAddOf != 0 && book.getId() == failAddOf)) throw std::runtime_error("Add failed");
+        books.push_back(book);
+        notify(ChangeEvent::Type::Inserted, book.getId());
+        persist();
+    }
+    void remove(int id) override {
+        auto it = std::find_if(books.begin(), books.end(), [id](const Book& b) { return b.getId() == id; });
+        if (it == books.end()) throw std::out_of_range("Book with ID not found");
+        books.erase(it);
+        notify(ChangeEvent::Type::Removed, id);
+        persist();
+    }
+    void update(const Book& book) override {
+        auto it = std::find_if(books.begin(), books.end(), [&book](const Book& b) { return b.getId() == book.getId(); });
+        if (it == books.end()) throw std::out_of_range("Book with ID not found");
+        *it = book;
+        notify(ChangeEvent::Type::Updated, book.getId());
+        persist();
+    }
+    std::vector<Book> getAll() const override { return books; }
+    std::unique_ptr<Book> findById(int id) const override {
+        for (const auto& b : books)
+            if (b.getId() == id) return std::make_unique<Book>(b);
+        return nullptr;
+    }
+
+private:
+    std::vector<Book> books;
+    std::string fileName;
+
+    void saveToFile() const override {
+        ++saves;
+        if (fileName.empty()) return;
+        std::ofstream out(fileName);
+        exportBooks(books, out, ExportFormat::Csv);
+    }
+};
+
+}
 
 // ========== Book Tests ==========
 BookTests::BookTests() : TestFramework("Book") {}
@@ -44,6 +128,7 @@ void BookTests::registerTests() {
             throw std::runtime_error("Valid author rejected");
         }
     });
+
 }
 
 // ========== CSV Repository Tests ==========
@@ -85,6 +170,423 @@ void CSVRepositoryTests::registerTests() {
 
         std::remove(filename.c_str());
     });
+
+    addTest("Update In Place", [] {
+        const std::string filename = "test_update.csv";
+        std::ofstream out(filename);
+        out << "1,1984,George Orwell,SF,1949\n";
+        out << "2,Dune,Frank Herbert,SF,1965\n";
+        out << "3,Emma,Jane Austen,Romance,1815\n";
+        out.close();
+
+        {
+            CSVRepository repo(filename);
+            repo.update(Book("Dune Messiah", "Frank Herbert", "SF", 1969, 2));
+
+            auto books = repo.getAll();
+            if (books.size() != 3) throw std::runtime_error("Update changed book count");
+            if (books[1].getId() != 2) throw std::runtime_error("Update moved the book");
+            if (books[1].getTitle() != "Dune Messiah") throw std::runtime_error("Update not applied");
+        }
+
+        CSVRepository reloaded(filename);
+        auto book = reloaded.findById(2);
+        if (!book || book->getYear() != 1969) throw std::runtime_error("Update not persisted");
+
+        std::remove(filename.c_str());
+    });
+
+    addTest("Id Allocation", [] {
+        const std::string filename = "test_ids.csv";
+        const std::string idFile = filename + ".ids";
+        std::ofstream out(filename);
+        out << "1,1984,George Orwell,SF,1949\n";
+        out << "5,Dune,Frank Herbert,SF,1965\n";
+        out.close();
+
+        {
+            CSVRepository repo(filename);
+            if (repo.nextId() != 6) throw std::runtime_error("Allocation ignores loaded ids");
+            if (repo.reserveIds(10) != 7) throw std::runtime_error("Reservation start wrong");
+            if (repo.nextId() != 17) throw std::runtime_error("Reservation not skipped");
+
+            // Served from the claimed block, without touching the side file
+            FileStamp claimed = FileStamp::of(idFile);
+            for (int expected = 18; expected < 28; ++expected) {
+                if (repo.nextId() != expected) throw std::runtime_error("Block allocation out of order");
+            }
+            if (FileStamp::of(idFile) != claimed) throw std::runtime_error("Side file written per id");
+        }
+
+        // Ids are claimed in blocks, persisted before the first is handed out;
+        // the rest of the block is not handed out again
+        CSVRepository reloaded(filename);
+        if (reloaded.nextId() != 6 + IdAllocator::BlockSize) throw std::runtime_error("High-water mark not persisted");
+
+        std::remove(filename.c_str());
+        std::remove(idFile.c_str());
+    });
+
+    addTest("Observed Ids Are Persisted", [] {
+        const std::string filename = "test_observed_ids.csv";
+        std::ofstream(filename).close();
+
+        {
+            CSVRepository repo(filename);
+            repo.add(Book("Dune", "Frank Herbert", "SF", 1965, 50));
+            repo.remove(50);
+        }
+
+        CSVRepository reloaded(filename);
+        if (reloaded.nextId() != 51) throw std::runtime_error("Id of a deleted book handed out again");
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".ids").c_str());
+    });
+
+    addTest("Id Reuse", [] {
+        const std::string filename = "test_id_reuse.csv";
+        std::ofstream(filename).close();
+
+        CSVRepository repo(filename);
+        repo.add(Book("Dune", "Frank Herbert", "SF", 1965, 3));
+        repo.releaseId(2);
+        if (repo.nextId() != 4) throw std::runtime_error("Released id reused while reuse is off");
+
+        repo.setIdReuse(true);
+        repo.releaseId(2);
+        if (repo.nextId() != 2) throw std::runtime_error("Released id not reused");
+        if (repo.nextId() != 5) throw std::runtime_error("Allocation after reuse wrong");
+
+        std::remove(filename.c_str());
+    });
+
+    addTest("Update Non-existent Book", [] {
+        const std::string filename = "test_update_nonexistent.csv";
+        std::ofstream(filename).close();
+
+        CSVRepository repo(filename);
+        try {
+            repo.update(Book("Dune", "Frank Herbert", "SF", 1965, 42));
+            throw std::runtime_error("Updating nonexistent book did not throw");
+        } catch (const std::out_of_range&) {
+            // Expected
+        }
+
+        std::remove(filename.c_str());
+    });
+
+    addTest("Trailing Fields Are Ignored", [] {
+        const std::string filename = "test_trailing.csv";
+        std::ofstream out(filename);
+        out << "1,Dune,Frank Herbert,SF,1965,signed copy\n"
+            << "2,Emma,Jane Austen,Romance,1815 (reprint)\n";
+        out.close();
+
+        CSVRepository repo(filename);
+        auto books = repo.getAll();
+        if (books.size() != 2 || books[0].getYear() != 1965 || books[1].getYear() != 1815)
+            throw std::runtime_error("Rows with trailing content rejected");
+        std::remove(filename.c_str());
+    });
+
+    addTest("Parallel Bulk Import", [] {
+        const std::string filename = "test_import.csv";
+        std::ofstream out(filename);
+        out << "1,Dune,Frank Herbert,SF,1965\n"
+            << "2,Emma,Jane Austen,Romance,1815\r\n"
+            << "\n"
+            << "1,Dune Again,Frank Herbert,SF,1965\n"   // duplicate in file
+            << "3,Bad,Author9,SF,2000\n"                // invalid author
+            << "4,Solaris,Stanislaw Lem,SF,MCMLXI\n"    // invalid year
+            << "5,Existing,Some One,SF,1999\n"          // already in the repository
+            << "6,Ubik,Philip Dick,SF,1969";            // no final newline
+        out.close();
+
+        CountingRepository repo;
+        repo.add(Book("Existing", "Some One", "SF", 1999, 5));
+
+        CsvImporter::Options options;
+        options.chunkSize = 16; // smaller than a line, so chunks are stitched together
+        options.threads = 3;
+        ImportReport report = CsvImporter(options).importFile(filename, repo);
+        std::remove(filename.c_str());
+
+        if (report.rows != 7 || report.imported != 3) throw std::runtime_error("Wrong import counts");
+        if (report.duplicates != 2 || report.invalid != 2) throw std::runtime_error("Wrong rejection counts");
+        if (repo.getAll().size() != 4 || !repo.findById(6)) throw std::runtime_error("Imported books missing");
+        if (repo.saves != 2) throw std::runtime_error("Import was not a single write");
+
+        std::vector<std::size_t> lines;
+        for (const auto& error : report.errors) lines.push_back(error.line);
+        if (lines != std::vector<std::size_t>{4, 5, 6, 7}) throw std::runtime_error("Error lines wrong");
+        if (report.errors[1].message != "Invalid author") throw std::runtime_error("Error message lost");
+
+        // A failed add takes the whole import back out
+        std::ofstream(filename) << "7,Emma,Jane Austen,Romance,1815\n"
+                                << "8,Persuasion,Jane Austen,Romance,1817\n"
+                                << "9,Ubik,Philip Dick,SF,1969\n";
+        repo.failAddOf = 9;
+        try {
+            CsvImporter().importFile(filename, repo);
+            throw std::logic_error("Failed import reported success");
+        } catch (const std::runtime_error& e) {
+            if (std::string(e.what()) != "Add failed") throw;
+        }
+        std::remove(filename.c_str());
+        if (repo.getAll().size() != 4 || repo.findById(7) || repo.findById(8))
+            throw std::runtime_error("Failed import left books behind");
+    });
+
+    addTest("Load Progress and Cancellation", [] {
+        const std::string filename = "test_progress.csv";
+        std::ofstream out(filename);
+        for (int id = 1; id <= 10000; ++id) out << id << ",Dune,Frank Herbert,SF,1965\n";
+        out.close();
+
+        std::size_t reports = 0, lastDone = 0, lastTotal = 0;
+        CSVRepository repo(filename, [&](std::size_t done, std::size_t total) {
+            if (done < lastDone) throw std::runtime_error("Progress went backwards");
+            ++reports;
+            lastDone = done;
+            lastTotal = total;
+            return true;
+        });
+        if (repo.getAll().size() != 10000) throw std::runtime_error("Load with progress failed");
+        if (reports < 2 || lastDone != lastTotal || lastTotal == 0) throw std::runtime_error("Progress not reported");
+
+        try {
+            CSVRepository cancelled(filename, [](std::size_t, std::size_t) { return false; });
+            throw std::runtime_error("Cancelled load completed");
+        } catch (const LoadCancelled&) {
+            // Expected
+        }
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".ids").c_str());
+    });
+
+    addTest("Progress When Last Line Ends the File", [] {
+        // 4096 lines, the last one without a newline: the final report comes
+        // after end of file, where tellg() no longer works
+        const std::string filename = "test_progress_eof.csv";
+        std::ofstream out(filename);
+        for (int id = 1; id <= 4096; ++id) out << (id > 1 ? "\n" : "") << id << ",Dune,Frank Herbert,SF,1965";
+        out.close();
+
+        bool sane = true;
+        CSVRepository repo(filename, [&](std::size_t done, std::size_t total) {
+            if (total == 0 || done > total) sane = false;
+            return true;
+        });
+        if (repo.getAll().size() != 4096) throw std::runtime_error("Load failed");
+        if (!sane) throw std::runtime_error("Bogus progress after end of file");
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".ids").c_str());
+    });
+
+    addTest("Block-Compressed Storage", [] {
+        const std::string filename = "test_compressed.csv";
+        {
+            CSVRepository repo(filename);
+            repo.beginBatch();
+            for (int id = 1; id <= 5000; ++id) repo.add(Book("Dune", "Frank Herbert", "SF", 1965, id));
+            repo.endBatch();
+            repo.setCompressed(true);
+        }
+        if (!BlockFile::detect(filename)) throw std::runtime_error("File not compressed");
+
+        // Detected on load and kept compressed on the next write
+        {
+            CSVRepository repo(filename);
+            if (!repo.isCompressed() || repo.getAll().size() != 5000) throw std::runtime_error("Compressed load failed");
+            repo.remove(1);
+        }
+        CSVRepository reloaded(filename);
+        if (reloaded.getAll().size() != 4999 || reloaded.getAll().front().getId() != 2)
+            throw std::runtime_error("Compressed save failed");
+
+        // Many small blocks, appended to and inflated in parallel
+        std::string content;
+        for (int i = 0; i < 2000; ++i) content += std::to_string(i) + ",";
+        BlockFile::write(filename, content.substr(0, 5000), 512);
+        BlockFile::append(filename, content.substr(5000), 512);
+        if (BlockFile::read(filename) != content) throw std::runtime_error("Block round trip failed");
+
+        // An append cut short leaves the container as it was, and the next one carries on
+        {
+            std::ofstream file(filename, std::ios::binary | std::ios::app);
+            file << "partial block and no trailer";
+        }
+        if (BlockFile::read(filename) != content) throw std::runtime_error("Interrupted append not recovered");
+        BlockFile::append(filename, "tail", 512);
+        if (BlockFile::read(filename) != content + "tail") throw std::runtime_error("Append after interruption failed");
+
+        // Stream reads seek without inflating from the start
+        {
+            BlockFile::ReadBuffer buffer(filename);
+            std::istream in(&buffer);
+            std::string piece(10, '\0');
+            in.seekg(6000);
+            in.read(&piece[0], 10);
+            if (piece != content.substr(6000, 10) || in.tellg() != std::streampos(6010)) throw std::runtime_error("Seek failed");
+            in.seekg(-4, std::ios::end);
+            in.read(&piece[0], 4);
+            if (piece.compare(0, 4, "tail") != 0) throw std::runtime_error("Seek from end failed");
+        }
+
+        // A damaged block is reported, not silently skipped
+        {
+            std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(20);
+            file.write("XXXX", 4);
+        }
+        try {
+            BlockFile::read(filename);
+            throw std::logic_error("Damaged block not detected");
+        } catch (const std::runtime_error&) {
+            // Expected
+        }
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".ids").c_str());
+    });
+
+    addTest("External Changes Are Merged", [] {
+        const std::string filename = "test_shared.csv";
+        std::remove(filename.c_str());
+
+        // Two repositories on one file stand in for two processes
+        CSVRepository first(filename);
+        first.beginBatch();
+        for (int id = 1; id <= 3; ++id) first.add(Book("Dune", "Frank Herbert", "SF", 1965, id));
+        first.endBatch();
+        CSVRepository second(filename);
+
+        std::vector<ChangeEvent> events;
+        second.subscribe([&events](const ChangeEvent& event) { events.push_back(event); });
+        if (second.reload() != 0) throw std::runtime_error("Unchanged file reloaded");
+
+        // Only the record that changed is applied
+        first.update(Book("Dune Messiah", "Frank Herbert", "SF", 1969, 2));
+        if (second.reload() != 1 || events.size() != 1 ||
+            events[0].type != ChangeEvent::Type::Updated || events[0].id != 2 ||
+            second.findById(2)->getTitle() != "Dune Messiah") {
+            throw std::runtime_error("External update not applied");
+        }
+
+        // Writing over a file changed elsewhere keeps both sides' changes
+        events.clear();
+        first.remove(1);
+        second.add(Book("Emma", "Jane Austen", "Romance", 1815, 4));
+        if (events.size() != 2 || events[1].type != ChangeEvent::Type::Removed || events[1].id != 1)
+            throw std::runtime_error("External removal not merged before the write");
+
+        CSVRepository merged(filename);
+        std::vector<int> ids;
+        for (const auto& book : merged.getAll()) ids.push_back(book.getId());
+        if (ids != std::vector<int>{2, 3, 4}) throw std::runtime_error("Update lost in concurrent writes");
+
+        // A record both sides changed differently is a conflict, not a lost
+        // update. The losing mutation is taken back out of memory.
+        first.update(Book("Children of Dune", "Frank Herbert", "SF", 1976, 3));
+        try {
+            second.update(Book("God Emperor of Dune", "Frank Herbert", "SF", 1981, 3));
+            throw std::logic_error("Conflicting update accepted");
+        } catch (const MergeConflict& conflict) {
+            if (conflict.ids() != std::vector<int>{3}) throw std::runtime_error("Wrong conflict reported");
+        }
+        if (CSVRepository(filename).findById(3)->getTitle() != "Children of Dune" ||
+            second.findById(3)->getTitle() != "Dune") {
+            throw std::runtime_error("Conflicting update not rolled back");
+        }
+        try {
+            second.remove(3);
+            throw std::logic_error("Removal of a changed record accepted");
+        } catch (const MergeConflict&) {}
+        if (!second.findById(3)) throw std::runtime_error("Conflicting removal not rolled back");
+        if (second.reload() != 1 || second.findById(3)->getTitle() != "Children of Dune")
+            throw std::runtime_error("Other side's version not loaded after the conflict");
+
+        // Through a controller: nothing is published or recorded for undo
+        {
+            Controller shared(std::make_unique<CSVRepository>(filename));
+            first.update(Book("Dune Messiah", "Frank Herbert", "SF", 1970, 2));
+            try {
+                shared.updateBook(Book("Dune Messiah", "Frank Herbert", "SF", 1971, 2));
+                throw std::logic_error("Conflicting update accepted by the controller");
+            } catch (const MergeConflict&) {}
+            shared.undo(); // nothing to undo
+            if (shared.findBook(2)->getYear() != 1969 || shared.findStoredBook(2)->getYear() != 1969)
+                throw std::runtime_error("Controller out of step after a conflict");
+            if (shared.reloadFromDisk() != 1 || shared.findBook(2)->getYear() != 1970)
+                throw std::runtime_error("Controller did not load the other version");
+        }
+        second.reload();
+
+        // Ids handed out on both sides never collide, so both adds survive
+        int firstId = first.nextId();
+        int secondId = second.nextId();
+        if (firstId == secondId || std::min(firstId, secondId) <= 4) throw std::runtime_error("Concurrent allocations collide");
+        first.add(Book("Emma", "Jane Austen", "Romance", 1815, firstId));
+        second.add(Book("Persuasion", "Jane Austen", "Romance", 1817, secondId));
+        if (CSVRepository(filename).getAll().size() != 5) throw std::runtime_error("Concurrent add lost");
+
+        // The same id added on both sides is a conflict; the file keeps the other side's book
+        first.add(Book("Dune", "Frank Herbert", "SF", 1965, 20));
+        try {
+            second.add(Book("Emma", "Jane Austen", "Romance", 1815, 20));
+            throw std::logic_error("Conflicting add accepted");
+        } catch (const MergeConflict& conflict) {
+            if (conflict.ids() != std::vector<int>{20}) throw std::runtime_error("Wrong conflict reported");
+        }
+        if (CSVRepository(filename).findById(20)->getTitle() != "Dune")
+            throw std::runtime_error("Conflicting add overwrote the file");
+
+        // A same-size rewrite is noticed even if the timestamp does not move
+        CatalogSync sync(filename);
+        sync.synced(CSVRepository(filename).getAll());
+        auto modified = std::filesystem::last_write_time(filename);
+        std::string text;
+        {
+            std::ifstream in(filename, std::ios::binary);
+            text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        text[text.size() - 2] = text[text.size() - 2] == '0' ? '1' : '0';
+        std::ofstream(filename, std::ios::binary | std::ios::trunc) << text;
+        std::filesystem::last_write_time(filename, modified);
+        if (!sync.changedOnDisk()) throw std::runtime_error("Same-size rewrite missed");
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".lock").c_str());
+    });
+
+    addTest("File Watcher", [] {
+        const std::string filename = "test_watched.csv";
+        std::remove(filename.c_str());
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        int notifications = 0;
+        {
+            FileWatcher watcher(filename, [&] {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++notifications;
+                changed.notify_all();
+            });
+
+            CSVRepository repo(filename);
+            repo.add(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!changed.wait_for(lock, std::chrono::seconds(5), [&] { return notifications > 0; }))
+                throw std::runtime_error("Write not reported");
+        }
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".lock").c_str());
+    });
 }
 
 JSONRepositoryTests::JSONRepositoryTests() : TestFramework("JSON Repository") {}
@@ -105,6 +607,338 @@ void JSONRepositoryTests::registerTests() {
 
         std::remove(filename.c_str()); // Clean up
     });
+
+    addTest("JSON Update", [] {
+        const std::string filename = "test_update.json";
+        {
+            JSONRepository repo(QString::fromStdString(filename));
+            repo.add(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+            repo.add(Book("Emma", "Jane Austen", "Romance", 1815, 2));
+            repo.update(Book("Dune", "Frank Herbert", "Fantasy", 1965, 1));
+        }
+
+        JSONRepository repo(QString::fromStdString(filename));
+        auto loaded = repo.getAll();
+        if (loaded.size() != 2 || loaded[0].getId() != 1) throw std::runtime_error("Update moved the book");
+        if (loaded[0].getGenre() != "Fantasy") throw std::runtime_error("Update not persisted");
+
+        std::remove(filename.c_str());
+    });
+}
+
+NDJSONRepositoryTests::NDJSONRepositoryTests() : TestFramework("NDJSON Repository") {}
+
+void NDJSONRepositoryTests::registerTests() {
+    auto countLines = [](const std::string& filename) {
+        std::ifstream in(filename);
+        std::size_t lines = 0;
+        for (std::string line; std::getline(in, line);) ++lines;
+        return lines;
+    };
+
+    addTest("Append-Only Mutations", [countLines] {
+        const std::string filename = "test_books.ndjson";
+        {
+            NDJSONRepository repo(QString::fromStdString(filename));
+            repo.add(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+            repo.add(Book("Emma", "Jane Austen", "Romance", 1815, 2));
+            repo.add(Book("Solaris", "Stanislaw Lem", "SF", 1961, 3));
+            repo.update(Book("Dune", "Frank Herbert", "Fantasy", 1965, 1));
+            repo.remove(2);
+            if (repo.supersededLines() != 3) throw std::runtime_error("Superseded lines miscounted");
+        }
+        if (countLines(filename) != 5) throw std::runtime_error("Mutations were not appended");
+
+        NDJSONRepository repo(QString::fromStdString(filename));
+        auto loaded = repo.getAll();
+        if (loaded.size() != 2 || loaded[0].getId() != 1 || loaded[1].getId() != 3) throw std::runtime_error("Replay order wrong");
+        if (loaded[0].getGenre() != "Fantasy") throw std::runtime_error("Replacement record ignored");
+        if (repo.nextId() != 4) throw std::runtime_error("Ids not observed");
+
+        repo.compact();
+        if (countLines(filename) != 2 || repo.supersededLines() != 0) throw std::runtime_error("Compaction kept superseded lines");
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".ids").c_str());
+    });
+
+    addTest("Parallel Load and Auto-Compaction", [countLines] {
+        const std::string filename = "test_large.ndjson";
+        {
+            std::ofstream out(filename);
+            for (int id = 1; id <= 40000; ++id)
+                out << "{\"author\":\"Frank Herbert\",\"genre\":\"SF\",\"id\":" << id << ",\"title\":\"Dune\",\"year\":1965}\n";
+            for (int id = 1; id <= 40000; id += 2) out << "{\"deleted\":true,\"id\":" << id << "}\n";
+            out << "not json\n";
+            out << "{\"author\":\"Frank Herbert\",\"genre\":\"SF\",\"id\":7,\"ti"; // torn final append
+        }
+
+        NDJSONRepository repo(QString::fromStdString(filename));
+        auto loaded = repo.getAll();
+        if (loaded.size() != 20000 || loaded.front().getId() != 2 || loaded.back().getId() != 40000)
+            throw std::runtime_error("Parallel replay wrong");
+
+        // The next write compacts, and the torn line does not corrupt it
+        repo.add(Book("Emma", "Jane Austen", "Romance", 1815, 40001));
+        if (countLines(filename) != 20001) throw std::runtime_error("File not compacted");
+
+        NDJSONRepository reloaded(QString::fromStdString(filename));
+        if (reloaded.getAll().size() != 20001 || !reloaded.findById(40001)) throw std::runtime_error("Compacted file unreadable");
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".ids").c_str());
+    });
+
+    addTest("Compressed Appends", [] {
+        const std::string filename = "test_compressed.ndjson";
+        {
+            NDJSONRepository repo(QString::fromStdString(filename));
+            repo.add(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+            repo.setCompressed(true);
+            repo.add(Book("Emma", "Jane Austen", "Romance", 1815, 2));
+            repo.remove(1);
+        }
+        if (!BlockFile::detect(filename)) throw std::runtime_error("File not compressed");
+
+        NDJSONRepository repo(QString::fromStdString(filename));
+        auto loaded = repo.getAll();
+        if (!repo.isCompressed() || loaded.size() != 1 || loaded[0].getId() != 2) throw std::runtime_error("Compressed replay wrong");
+        if (repo.supersededLines() != 2) throw std::runtime_error("Appends were not kept as records");
+
+        repo.setCompressed(false);
+        if (BlockFile::detect(filename)) throw std::runtime_error("File still compressed");
+        if (NDJSONRepository(QString::fromStdString(filename)).getAll().size() != 1) throw std::runtime_error("Plain rewrite unreadable");
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".ids").c_str());
+    });
+}
+
+ConverterTests::ConverterTests() : TestFramework("Format Converter") {}
+
+void ConverterTests::registerTests() {
+    addTest("Streaming Conversion", [] {
+        const std::string csvFile = "test_convert.csv";
+        const std::string jsonFile = "test_convert.json";
+        const std::string ndjsonFile = "test_convert.ndjson";
+        {
+            CSVRepository repo(csvFile);
+            repo.add(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+            repo.add(Book("Say \"Hi\" {ok}]", "Philip Dick", "SF", 1969, 2));
+            repo.add(Book("Emma", "Jane Austen", "Romance", 1815, 3));
+        }
+        { std::ofstream(csvFile, std::ios::app) << "not,a,book\n"; }
+
+        // CSV -> JSON -> compressed NDJSON -> CSV, each read back by its repository
+        ConversionReport report = FormatConverter().convert(csvFile, jsonFile);
+        if (report.records != 3 || report.skipped != 1) throw std::runtime_error("CSV source miscounted");
+        if (JSONRepository(QString::fromStdString(jsonFile)).getAll().size() != 3) throw std::runtime_error("JSON output unreadable");
+
+        FormatConverter::Options options;
+        options.compress = true;
+        FormatConverter(options).convert(jsonFile, ndjsonFile);
+        if (!BlockFile::detect(ndjsonFile)) throw std::runtime_error("Destination not compressed");
+
+        std::remove(csvFile.c_str());
+        report = FormatConverter().convert(ndjsonFile, csvFile);
+        auto books = CSVRepository(csvFile).getAll();
+        if (report.records != 3 || books.size() != 3 || books[1].getTitle() != "Say \"Hi\" {ok}]")
+            throw std::runtime_error("Round trip lost records");
+
+        // Replaced and deleted records resolve to the last write per id
+        {
+            NDJSONRepository repo(QString::fromStdString(ndjsonFile));
+            repo.update(Book("Emma", "Jane Austen", "Drama", 1815, 3));
+            repo.remove(1);
+            repo.add(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+            repo.remove(2);
+        }
+        report = FormatConverter().convert(ndjsonFile, jsonFile);
+        books = JSONRepository(QString::fromStdString(jsonFile)).getAll();
+        if (report.records != 2 || report.skipped != 0 || books.size() != 2 ||
+            books[0].getId() != 3 || books[0].getGenre() != "Drama" || books[1].getId() != 1) {
+            throw std::runtime_error("Superseded records not resolved");
+        }
+
+        // The same from a plain stream; a torn line is skipped, not a record
+        std::istringstream in("{\"id\":4,\"title\":\"Emma\",\"author\":\"Jane Austen\",\"genre\":\"Romance\",\"year\":1815}\n"
+                              "{\"id\":4,\"deleted\":true}\n"
+                              "{\"id\":5,\"title\":\"Dune\",\"author\":\"Frank Herbert\",\"genre\":\"SF\",\"year\":1965}\n"
+                              "{\"id\":4,\"tit");
+        std::ostringstream out;
+        report = FormatConverter().convert(in, StorageFormat::Ndjson, out, StorageFormat::Csv);
+        if (report.records != 1 || report.skipped != 1 || out.str().find("5,") != 0)
+            throw std::runtime_error("Stream conversion did not resolve records: " + out.str());
+
+        // The tools open catalogs by the same extensions
+        auto opened = FormatConverter::openRepository(jsonFile);
+        if (!dynamic_cast<JSONRepository*>(opened.get()) || opened->getAll().size() != 2)
+            throw std::runtime_error("Catalog opened with the wrong repository");
+        opened.reset();
+        try {
+            FormatConverter::openRepository("test_convert.txt");
+            throw std::logic_error("Unknown extension accepted");
+        } catch (const std::invalid_argument&) {}
+
+        for (const auto& file : {csvFile, jsonFile, ndjsonFile}) {
+            std::remove(file.c_str());
+            std::remove((file + ".ids").c_str());
+        }
+    });
+}
+
+ShardedRepositoryTests::ShardedRepositoryTests() : TestFramework("Sharded Repository") {}
+
+void ShardedRepositoryTests::registerTests() {
+    auto openCsv = [](const std::string& file, const LoadProgress& progress) -> std::unique_ptr<Repository> {
+        return std::make_unique<CSVRepository>(file, progress);
+    };
+    auto removeShards = [](const std::string& filename, std::size_t count) {
+        for (std::size_t k = 0; k < count; ++k) {
+            std::string shard = ShardedRepository::shardFileName(filename, k);
+            std::remove(shard.c_str());
+            std::remove((shard + ".lock").c_str());
+        }
+    };
+
+    addTest("Id Partition", [openCsv, removeShards] {
+        const std::string filename = "test_sharded.csv";
+        removeShards(filename, 4);
+        {
+            ShardedRepository repo(filename, 4, ShardedRepository::Partition::ById, openCsv);
+            repo.beginBatch();
+            for (int id = 1; id <= 100; ++id) repo.add(Book("Dune", "Frank Herbert", "SF", 1965, id));
+            repo.endBatch();
+
+            for (std::size_t k = 0; k < 4; ++k) {
+                if (repo.shard(k).getAll().empty()) throw std::runtime_error("Shard left empty");
+            }
+
+            // Only the shard holding the book is rewritten
+            std::vector<FileStamp> before;
+            for (std::size_t k = 0; k < 4; ++k) before.push_back(FileStamp::of(ShardedRepository::shardFileName(filename, k)));
+            repo.update(Book("Dune Messiah", "Frank Herbert", "SF", 1969, 42));
+            int rewritten = 0;
+            for (std::size_t k = 0; k < 4; ++k) {
+                if (FileStamp::of(ShardedRepository::shardFileName(filename, k)) != before[k]) ++rewritten;
+            }
+            if (rewritten != 1) throw std::runtime_error("Update rewrote " + std::to_string(rewritten) + " shards");
+
+            auto matches = repo.findMatching([](const Book& b) { return b.getId() % 10 == 0; });
+            if (matches.size() != 10 || repo.findById(42)->getTitle() != "Dune Messiah")
+                throw std::runtime_error("Fan-out query failed");
+        }
+
+        // Fewer shards: the surplus shard is loaded too and emptied into the others
+        std::size_t reported = 0;
+        {
+            ShardedRepository repo(filename, 3, ShardedRepository::Partition::ById, openCsv,
+                                   [&reported](std::size_t done, std::size_t) { reported = done; return true; });
+            if (repo.getAll().size() != 100 || reported == 0) throw std::runtime_error("Sharded load failed");
+            for (int id = 1; id <= 100; ++id) {
+                if (!repo.findById(id)) throw std::runtime_error("Book not moved to its shard");
+            }
+            repo.remove(7);
+        }
+        ShardedRepository reopened(filename, 3, ShardedRepository::Partition::ById, openCsv);
+        if (reopened.getAll().size() != 99 || reopened.findById(7)) throw std::runtime_error("Removal not persisted");
+
+        if (std::ifstream(ShardedRepository::shardFileName(filename, 3)).is_open())
+            throw std::runtime_error("Surplus shard file not deleted");
+
+        try {
+            ShardedRepository cancelled(filename, 3, ShardedRepository::Partition::ById, openCsv,
+                                        [](std::size_t, std::size_t) { return false; });
+            throw std::logic_error("Cancelled load completed");
+        } catch (const LoadCancelled&) {
+            // Expected
+        }
+
+        removeShards(filename, 4);
+    });
+
+    addTest("Genre Partition", [openCsv, removeShards] {
+        const std::string filename = "test_genres.csv";
+        removeShards(filename, 3);
+        {
+            ShardedRepository repo(filename, 3, ShardedRepository::Partition::ByGenre, openCsv);
+            const char* genres[] = {"SF", "Romance", "History", "Fantasy"};
+            for (int id = 1; id <= 40; ++id) repo.add(Book("Title", "Author", genres[id % 4], 2000, id));
+
+            std::vector<ChangeEvent> events;
+            repo.subscribe([&events](const ChangeEvent& event) { events.push_back(event); });
+
+            // A genre change may move the book; listeners still see one update
+            for (int id = 1; id <= 40; ++id) repo.update(Book("Title", "Author", "Drama", 2000, id));
+            if (events.size() != 40) throw std::runtime_error("Moves reported as several events");
+            for (const auto& event : events) {
+                if (event.type != ChangeEvent::Type::Updated) throw std::runtime_error("Move not reported as update");
+            }
+
+            std::size_t nonEmpty = 0;
+            for (std::size_t k = 0; k < 3; ++k) nonEmpty += !repo.shard(k).getAll().empty();
+            if (nonEmpty != 1 || repo.findById(17)->getGenre() != "Drama")
+                throw std::runtime_error("Books not gathered in the genre's shard");
+
+            repo.remove(17);
+            if (repo.findById(17)) throw std::runtime_error("Removed book still found");
+            try {
+                repo.remove(17);
+                throw std::logic_error("Removing an unknown id succeeded");
+            } catch (const std::out_of_range&) {
+                // Expected
+            }
+        }
+
+        ShardedRepository reopened(filename, 3, ShardedRepository::Partition::ByGenre, openCsv);
+        if (reopened.getAll().size() != 39 || !reopened.findById(18)) throw std::runtime_error("Genre shards not reloaded");
+
+        removeShards(filename, 3);
+    });
+
+    addTest("Moves Between Shards", [] {
+        const std::string filename = "test_moves.csv";
+        std::mutex mutex;
+        std::map<std::string, CountingRepository*> parts;
+        auto openMemory = [&](const std::string& file, const LoadProgress&) -> std::unique_ptr<Repository> {
+            auto repo = std::make_unique<CountingRepository>();
+            std::lock_guard<std::mutex> lock(mutex);
+            parts[file] = repo.get();
+            return repo;
+        };
+        ShardedRepository repo(filename, 2, ShardedRepository::Partition::ByGenre, openMemory);
+        CountingRepository* shards[] = {parts.at(ShardedRepository::shardFileName(filename, 0)),
+                                        parts.at(ShardedRepository::shardFileName(filename, 1))};
+
+        // A genre that lives in the other shard than SF
+        repo.add(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+        std::size_t from = shards[0]->findById(1) ? 0 : 1;
+        std::string genre;
+        int probe = 2;
+        for (const char* candidate : {"Romance", "Drama", "Fantasy", "History"}) {
+            repo.add(Book("Probe", "Author", candidate, 2000, probe));
+            if (!shards[from]->findById(probe++)) genre = candidate;
+        }
+        if (genre.empty()) throw std::runtime_error("All genres in one shard");
+
+        // Both shards are written once per move
+        int saves[] = {shards[0]->saves, shards[1]->saves};
+        repo.update(Book("Dune", "Frank Herbert", genre, 1965, 1));
+        if (shards[0]->saves != saves[0] + 1 || shards[1]->saves != saves[1] + 1 || !shards[1 - from]->findById(1))
+            throw std::runtime_error("Move not written as one batch");
+
+        // A failed add puts the book back where it was
+        shards[from]->failAdds = true;
+        try {
+            repo.update(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+            throw std::logic_error("Failed move reported success");
+        } catch (const std::runtime_error&) {
+            // Expected
+        }
+        auto book = repo.findById(1);
+        if (!book || book->getGenre() != genre || !shards[1 - from]->findById(1))
+            throw std::runtime_error("Failed move lost the book");
+    });
 }
 
 ControllerTests::ControllerTests() : TestFramework("Controller") {}
@@ -143,6 +977,312 @@ void ControllerTests::registerTests() {
         std::remove(filename.c_str());
     });
 
+    addTest("Update with Undo/Redo", [] {
+        std::string filename = "test_update_undo.csv";
+        std::ofstream(filename).close();
+        Controller controller(std::make_unique<CSVRepository>(filename));
+
+        controller.addBook(Book("Book1", "Author One", "SF", 2000, 1));
+        controller.addBook(Book("Book2", "Author Two", "Drama", 2001, 2));
+        controller.updateBook(Book("Book1 Revised", "Author One", "SF", 2002, 1));
+
+        if (controller.getAllBooks()[0].getTitle() != "Book1 Revised") throw std::runtime_error("Update failed");
+
+        controller.undo();
+        auto books = controller.getAllBooks();
+        if (books[0].getId() != 1 || books[0].getTitle() != "Book1") throw std::runtime_error("Undo failed");
+
+        controller.redo();
+        if (controller.findBook(1)->getYear() != 2002) throw std::runtime_error("Redo failed");
+
+        std::remove(filename.c_str());
+    });
+
+    addTest("Undo History Entry Limit", [] {
+        std::string filename = "test_history_limit.csv";
+        std::ofstream(filename).close();
+        Controller controller(std::make_unique<CSVRepository>(filename));
+        controller.setHistoryLimits(2, CommandHistory::DefaultMaxBytes);
+
+        controller.addBook(Book("Book1", "Author", "SF", 2000, 1));
+        controller.addBook(Book("Book2", "Author", "SF", 2000, 2));
+        controller.addBook(Book("Book3", "Author", "SF", 2000, 3));
+
+        controller.undo();
+        controller.undo();
+        controller.undo(); // oldest entry was evicted, nothing left to undo
+        if (controller.getAllBooks().size() != 1) throw std::runtime_error("History not capped by entry count");
+
+        std::remove(filename.c_str());
+    });
+
+    addTest("Undo History Byte Limit", [] {
+        std::string filename = "test_history_bytes.csv";
+        std::ofstream(filename).close();
+        Controller controller(std::make_unique<CSVRepository>(filename));
+        controller.setHistoryLimits(100, 1); // room for the newest entry only
+
+        controller.addBook(Book("Book1", "Author", "SF", 2000, 1));
+        controller.addBook(Book("Book2", "Author", "SF", 2000, 2));
+
+        controller.undo();
+        controller.undo();
+        if (controller.getAllBooks().size() != 1) throw std::runtime_error("History not capped by size");
+
+        controller.redo();
+        if (controller.getAllBooks().size() != 2) throw std::runtime_error("Redo after cap failed");
+
+        std::remove(filename.c_str());
+    });
+
+    addTest("Lowering History Limits After Undo", [] {
+        std::string filename = "test_history_shrink.csv";
+        std::ofstream(filename).close();
+        Controller controller(std::make_unique<CSVRepository>(filename));
+
+        for (int id = 1; id <= 4; ++id) controller.addBook(Book("Book" + std::to_string(id), "Author", "SF", 2000, id));
+        controller.undo();
+        controller.undo();
+        controller.undo(); // one entry to undo, three to redo
+
+        controller.setHistoryLimits(2, CommandHistory::DefaultMaxBytes);
+        controller.redo();
+        controller.redo(); // the newest redo entries were dropped
+        auto books = controller.getAllBooks();
+        if (books.size() != 2 || !controller.findBook(2) || controller.findBook(3))
+            throw std::runtime_error("Redo chain broken by lowering the limits");
+
+        controller.undo();
+        controller.undo();
+        if (!controller.getAllBooks().empty()) throw std::runtime_error("Undo entries lost");
+
+        std::remove(filename.c_str());
+    });
+
+    addTest("Update Delta Keeps Other Fields", [] {
+        std::string filename = "test_update_delta.csv";
+        std::ofstream(filename).close();
+        Controller controller(std::make_unique<CSVRepository>(filename));
+
+        controller.addBook(Book("Book1", "Author One", "SF", 2000, 1));
+        controller.updateBook(Book("Book1", "Author One", "SF", 2010, 1));
+        controller.undo();
+
+        auto book = controller.findBook(1);
+        if (book->getYear() != 2000 || book->getTitle() != "Book1") throw std::runtime_error("Delta undo failed");
+
+        std::remove(filename.c_str());
+    });
+
+    addTest("Batch Flushes Once", [] {
+        CountingRepository repo;
+        repo.beginBatch();
+        repo.add(Book("Book1", "Author", "SF", 2000, 1));
+        repo.add(Book("Book2", "Author", "SF", 2000, 2));
+        repo.update(Book("Book2", "Author", "Drama", 2000, 2));
+        if (repo.saves != 0) throw std::runtime_error("Batch wrote early");
+        repo.endBatch();
+        if (repo.saves != 1) throw std::runtime_error("Batch did not write exactly once");
+    });
+
+    addTest("Bulk Remove Is One Undo Step", [] {
+        auto repo = std::make_unique<CountingRepository>();
+        CountingRepository* counter = repo.get();
+        Controller controller(std::move(repo));
+
+        controller.addBook(Book("Book1", "Author", "SF", 2000, 1));
+        controller.addBook(Book("Book2", "Author", "Drama", 2000, 2));
+        controller.addBook(Book("Book3", "Author", "SF", 2000, 3));
+
+        int before = counter->saves;
+        auto removed = controller.removeMatching([](const Book& b) { return b.getGenre() == "SF"; });
+        if (removed != 2 || controller.getAllBooks().size() != 1) throw std::runtime_error("Bulk remove failed");
+        if (counter->saves != before + 1) throw std::runtime_error("Bulk remove wrote more than once");
+
+        controller.undo();
+        if (controller.getAllBooks().size() != 3) throw std::runtime_error("Bulk undo failed");
+        controller.redo();
+        if (controller.getAllBooks().size() != 1) throw std::runtime_error("Bulk redo failed");
+    });
+
+    addTest("Bulk Set Genre and Year", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        controller.addBook(Book("Book1", "Author", "SF", 2000, 1));
+        controller.addBook(Book("Book2", "Author", "SF", 2001, 2));
+
+        if (controller.setGenre({1, 2, 99}, "History") != 2) throw std::runtime_error("Wrong update count");
+        controller.setYear({1, 2}, 1990);
+
+        for (const auto& b : controller.getAllBooks())
+            if (b.getGenre() != "History" || b.getYear() != 1990) throw std::runtime_error("Bulk update failed");
+
+        controller.undo(); // years
+        controller.undo(); // genres
+        if (controller.findBook(2)->getGenre() != "SF" || controller.findBook(2)->getYear() != 2001)
+            throw std::runtime_error("Bulk undo failed");
+    });
+
+    addTest("Bulk Update Rolls Back on Error", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        controller.addBook(Book("Book1", "Author", "SF", 2000, 1));
+        controller.addBook(Book("Book2", "Author", "SF", 2000, 2));
+
+        try {
+            controller.setYear({1, 2}, 3000);
+            throw std::runtime_error("Invalid year accepted");
+        } catch (const std::invalid_argument&) {}
+
+        if (controller.inTransaction()) throw std::runtime_error("Transaction left open");
+        for (const auto& b : controller.getAllBooks())
+            if (b.getYear() != 2000) throw std::runtime_error("Rollback failed");
+    });
+
+    addTest("Snapshots Are Immutable", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        controller.addBook(Book("Book1", "Author", "SF", 2000, 1));
+
+        auto before = controller.snapshot();
+        controller.addBook(Book("Book2", "Author", "SF", 2000, 2));
+        auto after = controller.snapshot();
+
+        if (before->size() != 1 || after->size() != 2) throw std::runtime_error("Snapshot changed under reader");
+        if (after->version() <= before->version()) throw std::runtime_error("Version did not advance");
+        if (!after->findById(2) || before->findById(2)) throw std::runtime_error("Snapshot lookup failed");
+    });
+
+    addTest("Snapshot Sort Orders", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        controller.addBook(Book("Carrie", "King", "Drama", 1974, 3));
+        controller.addBook(Book("Anathem", "Stephenson", "SF", 2008, 1));
+        controller.addBook(Book("Beloved", "Morrison", "Drama", 1974, 2));
+
+        auto snapshot = controller.snapshot();
+        const auto& books = snapshot->books();
+        auto ids = [&books](const std::vector<std::uint32_t>& order) {
+            std::vector<int> result;
+            for (auto position : order) result.push_back(books[position].getId());
+            return result;
+        };
+
+        if (snapshot->hasSortOrder(SortField::Id)) throw std::runtime_error("Order built before use");
+        if (ids(snapshot->sortOrder(SortField::Id)) != std::vector<int>{1, 2, 3}) throw std::runtime_error("Id order wrong");
+        if (!snapshot->hasSortOrder(SortField::Id) || snapshot->hasSortOrder(SortField::Title))
+            throw std::runtime_error("Built orders not reported");
+        if (ids(snapshot->sortOrder(SortField::Title)) != std::vector<int>{1, 2, 3}) throw std::runtime_error("Title order wrong");
+        // Equal years keep catalog order
+        if (ids(snapshot->sortOrder(SortField::Year)) != std::vector<int>{3, 2, 1}) throw std::runtime_error("Year order wrong");
+        if (&snapshot->sortOrder(SortField::Year) != &snapshot->sortOrder(SortField::Year)) throw std::runtime_error("Order not cached");
+
+        auto order = SortIndex::radixOrder({5, -3, 70000, 0, -70000, 5});
+        if (order != std::vector<std::uint32_t>{4, 1, 3, 0, 5, 2}) throw std::runtime_error("Radix order wrong");
+    });
+
+    addTest("Snapshots Share Unchanged Chunks", [] {
+        auto repo = std::make_unique<CountingRepository>();
+        auto* raw = repo.get();
+        Controller controller(std::move(repo));
+        const int count = static_cast<int>(CatalogSnapshot::ChunkSize * 2 + 100);
+        for (int id = 1; id <= count; ++id) controller.addBook(Book("Title", "Author", "SF", 1900 + id % 100, id));
+
+        auto before = controller.snapshot();
+        Book changed = *before->findById(count);
+        changed.setYear(1850);
+        controller.updateBook(changed);
+        controller.removeBook(5);
+        controller.addBook(Book("Later", "Author", "Drama", 2001, count + 1));
+        auto after = controller.snapshot();
+
+        // The first chunk lost a book and was copied; the middle one is shared
+        std::size_t middle = CatalogSnapshot::ChunkSize + 10;
+        if (&before->at(middle) != &after->at(middle - 1)) throw std::runtime_error("Unchanged chunk was copied");
+        if (before->findById(count)->getYear() == 1850 || before->size() != static_cast<std::size_t>(count))
+            throw std::runtime_error("Earlier snapshot changed");
+
+        std::vector<int> snapshotIds, repoIds;
+        for (const auto& book : *after) snapshotIds.push_back(book.getId());
+        for (const auto& book : raw->getAll()) repoIds.push_back(book.getId());
+        if (snapshotIds != repoIds || after->size() != repoIds.size()) throw std::runtime_error("Snapshot does not match the catalog");
+        if (after->findById(5) || after->positionOf(5) != CatalogSnapshot::npos) throw std::runtime_error("Removed book still found");
+        if (after->findById(count)->getYear() != 1850) throw std::runtime_error("Update not published");
+        if (after->positionOf(count + 1) != after->size() - 1 || after->at(after->size() - 1).getTitle() != "Later")
+            throw std::runtime_error("Insert not appended");
+        if (after->at(after->sortOrder(SortField::Year).front()).getYear() != 1850) throw std::runtime_error("Sort order wrong");
+    });
+
+    addTest("Cancellable Snapshot Select", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        controller.addBook(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+        controller.addBook(Book("Emma", "Jane Austen", "Romance", 1815, 2));
+        controller.addBook(Book("Solaris", "Stanislaw Lem", "SF", 1961, 3));
+
+        auto snapshot = controller.snapshot();
+        std::vector<std::uint32_t> positions;
+        auto isSF = [](const Book& b) { return b.getGenre() == "SF"; };
+
+        if (!snapshot->select(isSF, nullptr, positions)) throw std::runtime_error("Select failed");
+        if (positions != std::vector<std::uint32_t>{0, 2}) throw std::runtime_error("Wrong positions selected");
+
+        if (snapshot->select(isSF, [] { return true; }, positions)) throw std::runtime_error("Cancelled select completed");
+        if (!positions.empty()) throw std::runtime_error("Cancelled select left a result");
+    });
+
+    addTest("Transaction Published on Commit", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        controller.beginTransaction();
+        controller.addBook(Book("Book1", "Author", "SF", 2000, 1));
+        if (!controller.getAllBooks().empty()) throw std::runtime_error("Uncommitted change visible");
+        controller.commitTransaction();
+        if (controller.getAllBooks().size() != 1) throw std::runtime_error("Committed change not visible");
+    });
+
+    addTest("Concurrent Readers", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        std::atomic<bool> done{false};
+        std::atomic<bool> consistent{true};
+
+        std::thread reader([&] {
+            std::size_t lastSize = 0;
+            while (!done) {
+                auto snap = controller.snapshot();
+                auto matches = controller.filterBooks([](const Book& b) { return b.getGenre() == "SF"; });
+                if (snap->size() < lastSize || snap->books().size() != snap->size()) consistent = false;
+                lastSize = snap->size();
+                (void)matches;
+            }
+        });
+
+        for (int id = 1; id <= 200; ++id) controller.addBook(Book("Book", "Author", "SF", 2000, id));
+        done = true;
+        reader.join();
+
+        if (!consistent) throw std::runtime_error("Reader observed an inconsistent snapshot");
+        if (controller.snapshot()->size() != 200) throw std::runtime_error("Final snapshot incomplete");
+    });
+
+    addTest("Change Events", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        std::vector<ChangeEvent> events;
+        controller.subscribe([&events](const ChangeEvent& e) { events.push_back(e); });
+
+        controller.addBook(Book("Book1", "Author", "SF", 2000, 1));
+        controller.addBook(Book("Book2", "Author", "SF", 2000, 2));
+        controller.updateBook(Book("Book2", "Author", "Drama", 2000, 2));
+        if (events.size() != 3 || events[0].type != ChangeEvent::Type::Inserted ||
+            events[2].type != ChangeEvent::Type::Updated || events[2].id != 2)
+            throw std::runtime_error("Single changes not reported");
+        if (events[2].version != controller.snapshot()->version()) throw std::runtime_error("Event version mismatch");
+
+        events.clear();
+        controller.removeMatching([](const Book&) { return true; });
+        if (events.size() != 4 || events.front().type != ChangeEvent::Type::BatchBegin ||
+            events[1].type != ChangeEvent::Type::Removed || events.back().type != ChangeEvent::Type::BatchEnd)
+            throw std::runtime_error("Batch not bracketed");
+
+        events.clear();
+        controller.undo();
+        if (events.size() != 4 || events[1].type != ChangeEvent::Type::Inserted) throw std::runtime_error("Undo not reported");
+    });
+
     addTest("Undo with No History", [] {
         Controller controller(std::make_unique<CSVRepository>());
         try {
@@ -209,3 +1349,498 @@ void FilterTests::registerTests() {
         std::remove(filename.c_str());
     });
 }
+
+WriterPipelineTests::WriterPipelineTests() : TestFramework("Writer Pipeline") {}
+
+void WriterPipelineTests::registerTests() {
+    addTest("Concurrent Producers", [] {
+        std::string filename = "test_pipeline_producers.csv";
+        auto repo = std::make_unique<CountingRepository>(filename);
+        CountingRepository* counter = repo.get();
+        Controller controller(std::move(repo));
+        WriterPipeline pipeline(controller);
+
+        // Hold the writer until every producer has submitted, so the queue
+        // has to be drained in groups
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        auto gate = pipeline.submit([released](Controller&) { released.wait(); });
+
+        const int producers = 4, perProducer = 100;
+        const int submissions = producers * perProducer;
+        std::vector<std::atomic<int>> fired(submissions);
+        std::atomic<int> failures{0};
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                for (int i = 0; i < perProducer; ++i) {
+                    int index = p * perProducer + i;
+                    Book book("Book", "Author", "SF", 2000, index + 1);
+                    pipeline.submit([book](Controller& c) { c.addBook(book); },
+                                    [&fired, &failures, index](std::exception_ptr error) {
+                                        if (error) ++failures;
+                                        ++fired[index];
+                                    });
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        release.set_value();
+        gate.get();
+        pipeline.stop();
+
+        for (const auto& count : fired)
+            if (count != 1) throw std::runtime_error("Callback did not fire exactly once");
+        if (failures != 0) throw std::runtime_error("Mutation reported a failure");
+        if (counter->saves >= submissions) throw std::runtime_error("Mutations were not group-committed");
+
+        CSVRepository reloaded(filename);
+        if (reloaded.getAll().size() != static_cast<size_t>(submissions)) throw std::runtime_error("Records missing after reload");
+        std::remove(filename.c_str());
+    });
+
+    addTest("Failure Is Reported Per Mutation", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        WriterPipeline pipeline(controller);
+
+        auto ok = pipeline.submitAdd(Book("Book1", "Author", "SF", 2000, 1));
+        auto bad = pipeline.submit([](Controller&) { throw std::invalid_argument("rejected"); });
+        auto ok2 = pipeline.submitAdd(Book("Book2", "Author", "SF", 2000, 2));
+
+        ok.get();
+        ok2.get();
+        try {
+            bad.get();
+            throw std::runtime_error("Failed mutation reported success");
+        } catch (const std::invalid_argument&) {}
+
+        if (controller.getAllBooks().size() != 2) throw std::runtime_error("Good mutations lost");
+    });
+
+    addTest("Stop Drains Queue", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        std::vector<std::future<void>> futures;
+        {
+            WriterPipeline pipeline(controller);
+            for (int id = 1; id <= 50; ++id) futures.push_back(pipeline.submitAdd(Book("Book", "Author", "SF", 2000, id)));
+        }
+        for (auto& f : futures) f.get();
+        if (controller.getAllBooks().size() != 50) throw std::runtime_error("Queue not drained on stop");
+    });
+
+    addTest("Stop Racing with Submit", [] {
+        // Every request is either written or refused; none is left waiting
+        for (int round = 0; round < 50; ++round) {
+            Controller controller(std::make_unique<CountingRepository>());
+            WriterPipeline pipeline(controller);
+            std::vector<std::future<void>> futures[4];
+            std::vector<std::thread> producers;
+            for (int p = 0; p < 4; ++p) {
+                producers.emplace_back([&pipeline, &futures, p] {
+                    for (int i = 0; i < 25; ++i)
+                        futures[p].push_back(pipeline.submitAdd(Book("Book", "Author", "SF", 2000, p * 100 + i + 1)));
+                });
+            }
+            pipeline.stop();
+            for (auto& t : producers) t.join();
+
+            std::size_t written = 0;
+            for (auto& list : futures) {
+                for (auto& f : list) {
+                    if (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                        throw std::runtime_error("Request left waiting after stop");
+                    try {
+                        f.get();
+                        ++written;
+                    } catch (const std::logic_error&) {}
+                }
+            }
+            if (controller.getAllBooks().size() != written) throw std::runtime_error("Refused request was written");
+        }
+    });
+
+}
+
+MetricsTests::MetricsTests() : TestFramework("Metrics") {}
+
+void MetricsTests::registerTests() {
+    addTest("Latency Metrics", [] {
+        LatencyHistogram histogram;
+        for (std::uint64_t micros = 1; micros <= 1000; ++micros) histogram.record(micros);
+
+        if (histogram.count() != 1000 || histogram.last() != 1000 || histogram.max() != 1000)
+            throw std::runtime_error("Histogram totals wrong");
+        auto p50 = histogram.percentile(50);
+        auto p99 = histogram.percentile(99);
+        if (p50 < 500 || p50 > 500 + 500 / 8) throw std::runtime_error("p50 out of bucket precision");
+        if (p99 < 990 || p99 > 1000) throw std::runtime_error("p99 out of bucket precision");
+
+        std::string stalled;
+        Metrics::setStallHandler(0, [&stalled](const std::string& operation, std::uint64_t) { stalled = operation; });
+        Controller controller(std::make_unique<CountingRepository>());
+        controller.addBook(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+        Metrics::setStallHandler(0, nullptr);
+
+        if (Metrics::histogram("Controller::addBook").count() == 0) throw std::runtime_error("Controller call not timed");
+        if (stalled != "Controller::addBook") throw std::runtime_error("Stall not reported for the outermost call");
+    });
+
+    addTest("Per-Site Timers", [] {
+        auto before = Metrics::histogram("Test::siteTimer").count();
+        for (int i = 0; i < 3; ++i) {
+            SCOPED_TIMER("Test::siteTimer");
+        }
+        if (Metrics::histogram("Test::siteTimer").count() != before + 3) throw std::runtime_error("Site timer not recorded");
+        if (Metrics::lastOperation() != "Test::siteTimer") throw std::runtime_error("Last operation not updated");
+
+        auto site = Metrics::site("Test::siteTimer");
+        if (site.histogram != &Metrics::histogram("Test::siteTimer")) throw std::runtime_error("Site resolves to another histogram");
+    });
+}
+
+ExportTests::ExportTests() : TestFramework("Export") {}
+
+void ExportTests::registerTests() {
+    addTest("Streaming Export", [] {
+        Controller controller(std::make_unique<CountingRepository>());
+        controller.addBook(Book("Dune", "Frank Herbert", "SF", 1965, 1));
+        controller.addBook(Book("Emma", "Jane Austen", "Romance", 1815, 2));
+        controller.addBook(Book("Say \"Hi\"\\", "Philip Dick", "SF", 1969, 3));
+        auto isSF = [](const Book& b) { return b.getGenre() == "SF"; };
+
+        std::ostringstream csv;
+        if (controller.exportBooks(csv, ExportFormat::Csv, isSF) != 2) throw std::runtime_error("Wrong CSV count");
+        if (csv.str() != "1,Dune,Frank Herbert,SF,1965\n3,Say \"Hi\"\\,Philip Dick,SF,1969\n")
+            throw std::runtime_error("CSV export differs from repository format");
+
+        std::ostringstream ndjson;
+        controller.exportBooks(ndjson, ExportFormat::Ndjson);
+        std::string lines = ndjson.str();
+        if (std::count(lines.begin(), lines.end(), '\n') != 3) throw std::runtime_error("NDJSON is not one book per line");
+        if (lines.find("\"title\":\"Say \\\"Hi\\\"\\\\\"") == std::string::npos) throw std::runtime_error("JSON escaping wrong");
+
+        // A JSON export reads back through the JSON repository
+        const std::string filename = "test_export.json";
+        {
+            std::ofstream out(filename, std::ios::binary);
+            controller.exportBooks(out, ExportFormat::JsonArray, isSF);
+        }
+        {
+            JSONRepository reloaded(QString::fromStdString(filename));
+            auto book = reloaded.findById(3);
+            if (reloaded.getAll().size() != 2 || !book || book->getTitle() != "Say \"Hi\"\\")
+                throw std::runtime_error("JSON export did not round-trip");
+        }
+        std::remove(filename.c_str());
+        std::remove((filename + ".ids").c_str());
+
+        std::ostringstream empty;
+        controller.exportBooks(empty, ExportFormat::JsonArray, [](const Book&) { return false; });
+        if (empty.str() != "[]\n") throw std::runtime_error("Empty JSON export malformed");
+    });
+}
+
+StartupProfileTests::StartupProfileTests() : TestFramework("Startup Profile") {}
+
+void StartupProfileTests::registerTests() {
+    addTest("Startup Profile", [] {
+        StartupProfile::mark("test phase one");
+        StartupProfile::mark("test phase two");
+        StartupProfile::mark("test phase one"); // already recorded; ignored
+
+        auto phases = StartupProfile::phases();
+        auto one = std::find_if(phases.begin(), phases.end(), [](const auto& p) { return p.name == "test phase one"; });
+        auto two = std::find_if(phases.begin(), phases.end(), [](const auto& p) { return p.name == "test phase two"; });
+        if (one == phases.end() || two != one + 1 || two->millis < one->millis)
+            throw std::runtime_error("Phases not recorded once, in order");
+        if (StartupProfile::report().find("test phase two") == std::string::npos) throw std::runtime_error("Report incomplete");
+    });
+}
+
+BatchProcessorTests::BatchProcessorTests() : TestFramework("Batch Processor") {}
+
+void BatchProcessorTests::registerTests() {
+    addTest("Batch Processor", [] {
+        auto repo = std::make_unique<CountingRepository>();
+        CountingRepository* storage = repo.get();
+        Controller controller(std::move(repo));
+        BatchProcessor processor(controller);
+
+        std::istringstream script(
+            "# two adds and an update, committed as one write\n"
+            "add title=\"Dune\" author=\"Frank Herbert\" genre=SF year=1965\n"
+            "add id=7 title=\"Say \\\"Hi\\\"\" author=\"Jane Austen\" genre=Romance year=1815\n"
+            "update id=1 genre=Fantasy\n"
+            "add id=7 title=Again author=\"Jane Austen\" genre=Romance year=1815\n"
+            "filter author=AUSTEN format=ndjson\n"
+            "count year=1900-2000\n"
+            "remove id=99\n"
+            "frobnicate\n");
+        std::ostringstream out;
+        BatchReport report = processor.run(script, out);
+
+        const std::string expected =
+            "ok 1\nok 7\nok\nerror Book 7 already exists\n"
+            "{\"id\":7,\"title\":\"Say \\\"Hi\\\"\",\"author\":\"Jane Austen\",\"genre\":\"Romance\",\"year\":1815}\nok 1\n"
+            "ok 1\nerror No book with id 99\nerror Unknown command: frobnicate\n";
+        if (out.str() != expected) throw std::runtime_error("Unexpected answers:\n" + out.str());
+        if (report.commands != 8 || report.failed != 3) throw std::runtime_error("Report miscounted");
+        if (storage->saves != 1) throw std::runtime_error("Mutations were not group-committed");
+        if (controller.findBook(1)->getGenre() != "Fantasy") throw std::runtime_error("Grouped update lost");
+
+        // Atomic runs roll back everything after a failure
+        BatchProcessor::Options options;
+        options.atomic = true;
+        std::istringstream failing("remove genre=Fantasy\nupdate id=99 year=2000\nremove id=7\n");
+        std::ostringstream ignored;
+        BatchProcessor(controller, options).run(failing, ignored);
+        if (controller.getAllBooks().size() != 2) throw std::runtime_error("Atomic run not rolled back");
+    });
+}
+
+SocketServerTests::SocketServerTests() : TestFramework("Socket Server") {}
+
+void SocketServerTests::registerTests() {
+    addTest("Socket Server Pipelining", [] {
+        const std::string socketPath = "test_server.sock";
+        Controller controller(std::make_unique<CountingRepository>());
+        QueryServer::Options options;
+        options.workers = 2;
+        QueryServer server(controller, socketPath, options);
+        std::thread serving([&server] { server.run(); });
+
+        auto request = [&socketPath](const std::string& lines) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            std::strcpy(address.sun_path, socketPath.c_str());
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            for (int attempt = 0; connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0; ++attempt) {
+                if (attempt == 200) throw std::runtime_error("Server not listening");
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            // Everything at once: the answers must still come back in order
+            if (send(fd, lines.data(), lines.size(), 0) != static_cast<ssize_t>(lines.size())) throw std::runtime_error("Send failed");
+            shutdown(fd, SHUT_WR);
+            std::string answers;
+            char buffer[4096];
+            ssize_t received;
+            while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) answers.append(buffer, received);
+            close(fd);
+            return answers;
+        };
+
+        std::string answers = request(
+            "add id=1 title=Dune author=\"Frank Herbert\" genre=SF year=1965\n"
+            "count genre=SF\n"
+            "update id=1 genre=Fantasy\n"
+            "count genre=SF\n"
+            "filter genre=Fantasy\n"
+            "begin\n"
+            "export test_server.csv\n"
+            "import test_server.csv\n");
+
+        // Only the server's user may connect
+        struct stat socketInfo;
+        if (stat(socketPath.c_str(), &socketInfo) != 0 || (socketInfo.st_mode & 0777) != 0600)
+            throw std::runtime_error("Socket is accessible to other users");
+        server.stop();
+        serving.join();
+
+        const std::string expected = "ok 1\nok 1\nok\nok 0\n1,Dune,Frank Herbert,Fantasy,1965\nok 1\n"
+                                     "error Transactions are not available over the server\n"
+                                     "error Import and export are not available over the server\n"
+                                     "error Import and export are not available over the server\n";
+        if (answers != expected) throw std::runtime_error("Unexpected answers:\n" + answers);
+        if (access(socketPath.c_str(), F_OK) == 0) throw std::runtime_error("Socket file left behind");
+        if (access("test_server.csv", F_OK) == 0) throw std::runtime_error("Export wrote a file");
+    });
+}
+
+ReplicationTests::ReplicationTests() : TestFramework("Replication") {}
+
+void ReplicationTests::registerTests() {
+    addTest("Replication Log", [] {
+        const std::string filename = "test_primary.csv";
+        const std::string base = "test_replica";
+        std::remove(filename.c_str());
+
+        auto catalogOf = [](const std::vector<Book>& books) {
+            std::vector<std::string> rows;
+            for (const auto& b : books) rows.push_back(std::to_string(b.getId()) + "," + b.getTitle() + "," + b.getGenre());
+            std::sort(rows.begin(), rows.end());
+            return rows;
+        };
+
+        Controller primary(std::make_unique<CSVRepository>(filename));
+        for (int id = 1; id <= 3; ++id) primary.addBook(Book("Dune", "Frank Herbert", "SF", 1965, id));
+
+        std::vector<std::string> errors;
+        ReplicationLog::Options options;
+        options.snapshotInterval = 5;
+        options.onError = [&errors](const std::string& message) { errors.push_back(message); };
+        ReplicationLog log(primary, base, options);
+
+        auto replicaRepository = std::make_unique<ReplicaRepository>(base);
+        ReplicaRepository* replica = replicaRepository.get();
+        Controller reporting(std::move(replicaRepository));
+        if (replica->version() != primary.snapshot()->version() ||
+            catalogOf(reporting.snapshot()->books()) != catalogOf(primary.snapshot()->books())) {
+            throw std::runtime_error("Replica did not start from the snapshot");
+        }
+
+        // A committed transaction arrives as one set of log records
+        primary.beginTransaction();
+        primary.updateBook(Book("Dune Messiah", "Frank Herbert", "SF", 1969, 2));
+        primary.removeBook(1);
+        primary.addBook(Book("Emma", "Jane Austen", "Romance", 1815, 4));
+        primary.commitTransaction();
+        if (reporting.reloadFromDisk() != 3 || reporting.reloadFromDisk() != 0 ||
+            catalogOf(reporting.snapshot()->books()) != catalogOf(primary.snapshot()->books())) {
+            throw std::runtime_error("Log records not applied");
+        }
+        if (replica->lagMillis() > 10000 || Metrics::histogram("Replica lag").count() < 3)
+            throw std::runtime_error("Replication lag not measured");
+
+        try {
+            reporting.addBook(Book("Persuasion", "Jane Austen", "Romance", 1817, 9));
+            throw std::logic_error("Replica accepted a write");
+        } catch (const std::logic_error& e) {
+            if (std::string(e.what()) != "Replica is read-only") throw;
+        }
+
+        // Fall behind past two log restarts: caught up from the snapshot
+        std::vector<ChangeEvent> events;
+        reporting.subscribe([&events](const ChangeEvent& event) { events.push_back(event); });
+        for (int id = 10; id < 22; ++id) primary.addBook(Book("Emma", "Jane Austen", "Romance", 1815, id));
+        log.waitForSnapshot();
+        if (log.snapshotVersion() <= replica->version()) throw std::runtime_error("Log not restarted");
+        reporting.reloadFromDisk();
+        bool reset = std::any_of(events.begin(), events.end(),
+                                 [](const ChangeEvent& e) { return e.type == ChangeEvent::Type::Reset; });
+        if (replica->catchUps() != 1 || !reset || replica->version() != primary.snapshot()->version() ||
+            catalogOf(reporting.snapshot()->books()) != catalogOf(primary.snapshot()->books())) {
+            throw std::runtime_error("Replica did not catch up");
+        }
+
+        // Removals and a re-add of a removed id in one reload
+        primary.beginTransaction();
+        primary.removeBook(10);
+        primary.removeBook(11);
+        primary.addBook(Book("Emma", "Jane Austen", "Romance", 1815, 10));
+        primary.updateBook(Book("Mansfield Park", "Jane Austen", "Romance", 1814, 12));
+        primary.commitTransaction();
+        log.waitForSnapshot();
+        reporting.reloadFromDisk();
+        if (replica->version() != primary.snapshot()->version() ||
+            catalogOf(reporting.getAllBooks()) != catalogOf(primary.snapshot()->books())) {
+            throw std::runtime_error("Removals not applied");
+        }
+
+        // A snapshot that cannot be written is reported, and logging carries on
+        std::filesystem::create_directory(ReplicationLog::snapshotFile(base) + ".tmp");
+        try {
+            log.writeSnapshot();
+            throw std::logic_error("Snapshot failure not thrown");
+        } catch (const std::runtime_error&) {
+        }
+        std::filesystem::remove(ReplicationLog::snapshotFile(base) + ".tmp");
+        if (errors.size() != 1) throw std::runtime_error("Snapshot failure not reported");
+        primary.removeBook(13);
+        if (reporting.reloadFromDisk() != 1) throw std::runtime_error("Log stopped after a failed snapshot");
+        log.writeSnapshot();
+        if (errors.size() != 1) throw std::runtime_error("Recovered snapshot reported");
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".lock").c_str());
+        std::remove(ReplicationLog::snapshotFile(base).c_str());
+        std::remove(ReplicationLog::logFile(base).c_str());
+    });
+}
+
+HashTreeSyncTests::HashTreeSyncTests() : TestFramework("Hash Tree Sync") {}
+
+void HashTreeSyncTests::registerTests() {
+    addTest("Hash Tree Sync", [] {
+        std::vector<Book> source;
+        for (int id = 1; id <= 20000; ++id) source.push_back(Book("Dune", "Frank Herbert", "SF", 1965, id));
+        std::vector<Book> target = source;
+
+        source[99].setTitle("Dune Messiah");        // id 100
+        source[15000].setYear(1970);                 // id 15001
+        source.erase(source.begin() + 12000);        // id 12001 is only in the target
+        source.push_back(Book("Emma", "Jane Austen", "Romance", 1815, 30000));
+        target.erase(target.begin() + 5000);         // id 5001 is only in the source
+        std::reverse(target.begin(), target.end());  // storage order does not matter
+
+        HashTree sourceTree(source);
+        HashTree targetTree(target);
+        HashTree::Stats stats;
+        SyncDelta delta = sourceTree.diff(targetTree, &stats);
+
+        std::vector<int> added, updated;
+        for (const auto& book : delta.added) added.push_back(book.getId());
+        for (const auto& book : delta.updated) updated.push_back(book.getId());
+        if (added != std::vector<int>{5001, 30000} || updated != std::vector<int>{100, 15001} ||
+            delta.removed != std::vector<int>{12001}) {
+            throw std::runtime_error("Wrong delta: " + delta.summary());
+        }
+        if (stats.recordsCompared > 500) throw std::runtime_error("Unchanged ranges were compared record by record");
+        if (!sourceTree.diff(HashTree(source)).empty()) throw std::runtime_error("Identical catalogs differ");
+
+        // Applied in one transaction, undone in one step
+        const std::string filename = "test_sync.csv";
+        {
+            std::ofstream out(filename);
+            exportBooks(target, out, ExportFormat::Csv);
+        }
+        Controller controller(std::make_unique<CSVRepository>(filename));
+        if (applyDelta(controller, delta) != 5 ||
+            HashTree(controller.snapshot()->books()).rootHash() != sourceTree.rootHash()) {
+            throw std::runtime_error("Delta not applied");
+        }
+        controller.undo();
+        if (HashTree(controller.snapshot()->books()).rootHash() != targetTree.rootHash())
+            throw std::runtime_error("Sync not undone in one step");
+
+        // The same delta as a batch script
+        std::stringstream script, answers;
+        delta.writeScript(script);
+        BatchProcessor processor(controller);
+        if (processor.run(script, answers).failed != 0 ||
+            HashTree(controller.snapshot()->books()).rootHash() != sourceTree.rootHash()) {
+            throw std::runtime_error("Sync script failed:\n" + answers.str());
+        }
+
+        std::remove(filename.c_str());
+        std::remove((filename + ".lock").c_str());
+    });
+}
+
+CatalogGeneratorTests::CatalogGeneratorTests() : TestFramework("Catalog Generator") {}
+
+void CatalogGeneratorTests::registerTests() {
+    addTest("Synthetic Catalog Generator", [] {
+        auto books = CatalogGenerator(7).generate(5000);
+        auto again = CatalogGenerator(7).generate(5000);
+        auto other = CatalogGenerator(8).generate(5000);
+        if (books.size() != 5000) throw std::runtime_error("Wrong catalog size");
+
+        std::size_t differing = 0;
+        std::size_t byTopAuthor = 0, byTenthAuthor = 0, recent = 0;
+        for (std::size_t i = 0; i < books.size(); ++i) {
+            const Book& book = books[i];
+            if (book.getId() != static_cast<int>(i) + 1) throw std::runtime_error("Ids not sequential");
+            if (book.getTitle() != again[i].getTitle() || book.getAuthor() != again[i].getAuthor()
+                || book.getGenre() != again[i].getGenre() || book.getYear() != again[i].getYear()) {
+                throw std::runtime_error("Same seed gave a different catalog");
+            }
+            if (book.getTitle() != other[i].getTitle()) ++differing;
+            if (book.getAuthor() == CatalogGenerator::authorName(0)) ++byTopAuthor;
+            if (book.getAuthor() == CatalogGenerator::authorName(9)) ++byTenthAuthor;
+            if (book.getYear() > 1975) ++recent;
+        }
+        if (differing < 4000) throw std::runtime_error("Seeds do not change the catalog");
+        if (byTopAuthor <= byTenthAuthor * 3) throw std::runtime_error("Authors are not Zipf distributed");
+        if (recent < books.size() * 9 / 10) throw std::runtime_error("Years are not skewed towards recent ones");
+    });
+}
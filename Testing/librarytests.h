@@ -21,6 +21,24 @@ public:
     void registerTests() override;
 };
 
+class NDJSONRepositoryTests : public TestFramework {
+public:
+    NDJSONRepositoryTests();
+    void registerTests() override;
+};
+
+class ConverterTests : public TestFramework {
+public:
+    ConverterTests();
+    void registerTests() override;
+};
+
+class ShardedRepositoryTests : public TestFramework {
+public:
+    ShardedRepositoryTests();
+    void registerTests() override;
+};
+
 class ControllerTests : public TestFramework {
 public:
     ControllerTests();
@@ -33,4 +51,50 @@ public:
     void registerTests() override;
 };
 
+class WriterPipelineTests : public TestFramework {
+public:
+    WriterPipelineTests();
+    void registerTests() override;
+};
+class MetricsTests : public TestFramework {
+public:
+    MetricsTests();
+    void registerTests() override;
+};
+class ExportTests : public TestFramework {
+public:
+    ExportTests();
+    void registerTests() override;
+};
+class StartupProfileTests : public TestFramework {
+public:
+    StartupProfileTests();
+    void registerTests() override;
+};
+class BatchProcessorTests : public TestFramework {
+public:
+    BatchProcessorTests();
+    void registerTests() override;
+};
+class SocketServerTests : public TestFramework {
+public:
+    SocketServerTests();
+    void registerTests() override;
+};
+class ReplicationTests : public TestFramework {
+public:
+    ReplicationTests();
+    void registerTests() override;
+};
+class HashTreeSyncTests : public TestFramework {
+public:
+    HashTreeSyncTests();
+    void registerTests() override;
+};
+class CatalogGeneratorTests : public TestFramework {
+public:
+    CatalogGeneratorTests();
+    void registerTests() override;
+};
+
 #endif // LIBRARY_TESTS_H
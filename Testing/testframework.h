@@ -11,6 +11,7 @@ public:
 
     void runAllTests();
     void printResults() const;
+    bool allPassed() const { return failedTests.empty(); }
 
 protected:
     virtual void registerTests() = 0;
@@ -0,0 +1,53 @@
+#include "librarytests.h"
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <filesystem>
+#include <iostream>
+#include <unistd.h>
+
+// Test executable: runs every suite and exits non-zero if any test failed.
+// The suites run in a fresh scratch directory, which is removed afterwards
+// together with every catalog and side file (.ids, .lock) left in it.
+int main()
+{
+    namespace fs = std::filesystem;
+    const fs::path home = fs::current_path();
+    const fs::path scratch = fs::temp_directory_path() / ("libraflow-tests-" + std::to_string(getpid()));
+    fs::remove_all(scratch);
+    fs::create_directories(scratch);
+    fs::current_path(scratch);
+
+    std::vector<std::unique_ptr<TestFramework>> testSuites;
+    testSuites.emplace_back(std::make_unique<BookTests>());
+    testSuites.emplace_back(std::make_unique<CSVRepositoryTests>());
+    testSuites.emplace_back(std::make_unique<JSONRepositoryTests>());
+    testSuites.emplace_back(std::make_unique<NDJSONRepositoryTests>());
+    testSuites.emplace_back(std::make_unique<ConverterTests>());
+    testSuites.emplace_back(std::make_unique<ShardedRepositoryTests>());
+    testSuites.emplace_back(std::make_unique<ControllerTests>());
+    testSuites.emplace_back(std::make_unique<FilterTests>());
+    testSuites.emplace_back(std::make_unique<WriterPipelineTests>());
+    testSuites.emplace_back(std::make_unique<MetricsTests>());
+    testSuites.emplace_back(std::make_unique<ExportTests>());
+    testSuites.emplace_back(std::make_unique<StartupProfileTests>());
+    testSuites.emplace_back(std::make_unique<BatchProcessorTests>());
+    testSuites.emplace_back(std::make_unique<SocketServerTests>());
+    testSuites.emplace_back(std::make_unique<ReplicationTests>());
+    testSuites.emplace_back(std::make_unique<HashTreeSyncTests>());
+    testSuites.emplace_back(std::make_unique<CatalogGeneratorTests>());
+
+    bool passed = true;
+    for (auto& suite : testSuites) {
+        suite->runAllTests();
+        suite->printResults();
+        passed = passed && suite->allPassed();
+    }
+
+    fs::current_path(home);
+    std::error_code error;
+    fs::remove_all(scratch, error);
+    if (error) std::cerr << "Could not remove " << scratch << ": " << error.message() << "\n";
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+// Headless batch front end:
+//
+//   batch [--atomic] [--stop-on-error] CATALOG [SCRIPT...]
+//
+// Opens CATALOG (.csv, .json or .ndjson; compressed files are detected) and
+// runs the commands in each SCRIPT, or on standard input without one, through
+// BatchProcessor. Answers go to standard output, the throughput summary to
+// standard error. Exits non-zero if any command failed.
+
+#include "batchprocessor.h"
+#include "converter.h"
+
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+int usage() {
+    std::cerr << "usage: batch [--atomic] [--stop-on-error] CATALOG [SCRIPT...]\n"
+              << "catalog formats by extension: .csv, .json, .ndjson\n";
+    return 2;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    BatchProcessor::Options options;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--atomic") == 0) options.atomic = true;
+        else if (std::strcmp(argv[i], "--stop-on-error") == 0) options.stopOnError = true;
+        else if (argv[i][0] == '-') return usage();
+        else files.emplace_back(argv[i]);
+    }
+    if (files.empty()) return usage();
+
+    try {
+        Controller controller(FormatConverter::openRepository(files[0]));
+        BatchProcessor processor(controller, options);
+        std::ios::sync_with_stdio(false);
+
+        BatchReport total;
+        auto runScript = [&](std::istream& in) {
+            BatchReport report = processor.run(in, std::cout);
+            total.commands += report.commands;
+            total.failed += report.failed;
+            total.seconds += report.seconds;
+        };
+        if (files.size() == 1) runScript(std::cin);
+        for (std::size_t i = 1; i < files.size(); ++i) {
+            std::ifstream script(files[i]);
+            if (!script.is_open()) throw std::runtime_error("Failed to open script " + files[i]);
+            runScript(script);
+            if (total.failed > 0 && (options.atomic || options.stopOnError)) break;
+        }
+
+        std::cout.flush();
+        std::cerr << total.summary() << "\n";
+        return total.failed > 0 ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "batch: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,8 @@
+# Headless batch front end (see batch.cpp)
+
+TEMPLATE = app
+TARGET = batch
+
+include(../libraflow.pri)
+
+SOURCES += batch.cpp
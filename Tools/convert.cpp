@@ -0,0 +1,46 @@
+// Command-line catalog converter:
+//
+//   convert [--compress] SOURCE DESTINATION
+//
+// The formats follow from the file extensions (.csv, .json, .ndjson/.jsonl).
+// Compressed sources are detected; --compress writes a block-compressed
+// destination. Prints the conversion summary on success.
+
+#include "converter.h"
+
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int usage() {
+    std::cerr << "usage: convert [--compress] SOURCE DESTINATION\n"
+              << "formats by extension: .csv, .json, .ndjson, .jsonl\n";
+    return 2;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    FormatConverter::Options options;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--compress") == 0) options.compress = true;
+        else if (argv[i][0] == '-') return usage();
+        else files.emplace_back(argv[i]);
+    }
+    if (files.size() != 2) return usage();
+
+    try {
+        ConversionReport report = FormatConverter(options).convert(files[0], files[1]);
+        std::cout << report.summary() << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "convert: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+# Command-line catalog converter (see convert.cpp)
+
+TEMPLATE = app
+TARGET = convert
+
+include(../libraflow.pri)
+
+SOURCES += convert.cpp
@@ -0,0 +1,106 @@
+// Local catalog server:
+//
+//   server [--workers N] [--ship-log BASE] CATALOG SOCKET
+//   server [--workers N] --replica BASE SOCKET
+//
+// Opens CATALOG (.csv, .json or .ndjson) and serves it over the Unix domain
+// socket SOCKET with the batch line protocol (see BatchProcessor) until
+// SIGINT or SIGTERM. Try it with: socat - UNIX-CONNECT:SOCKET
+//
+// --ship-log writes BASE.snapshot and BASE.log for replicas (see
+// ReplicationLog). --replica serves a read-only copy that follows those
+// files as they change, e.g. for reporting next to the desk instance.
+
+#include "queryserver.h"
+#include "replication.h"
+#include "filewatcher.h"
+#include "converter.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+QueryServer* activeServer = nullptr;
+
+void onSignal(int) {
+    if (activeServer) activeServer->stop();
+}
+
+int usage() {
+    std::cerr << "usage: server [--workers N] [--ship-log BASE] CATALOG SOCKET\n"
+              << "       server [--workers N] --replica BASE SOCKET\n"
+              << "catalog formats by extension: .csv, .json, .ndjson\n";
+    return 2;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QueryServer::Options options;
+    std::string shipLog;
+    std::string replicaOf;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) options.workers = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--ship-log") == 0 && i + 1 < argc) shipLog = argv[++i];
+        else if (std::strcmp(argv[i], "--replica") == 0 && i + 1 < argc) replicaOf = argv[++i];
+        else if (argv[i][0] == '-') return usage();
+        else arguments.emplace_back(argv[i]);
+    }
+    if (!replicaOf.empty()) {
+        if (!shipLog.empty() || arguments.size() != 1) return usage();
+        arguments.insert(arguments.begin(), replicaOf);
+    }
+    if (arguments.size() != 2) return usage();
+
+    try {
+        std::unique_ptr<Repository> repository;
+        if (!replicaOf.empty()) repository = std::make_unique<ReplicaRepository>(replicaOf);
+        else repository = FormatConverter::openRepository(arguments[0]);
+        Controller controller(std::move(repository));
+
+        std::unique_ptr<ReplicationLog> log;
+        if (!shipLog.empty()) {
+            ReplicationLog::Options logOptions;
+            logOptions.onError = [](const std::string& message) {
+                std::cerr << "server: replication log: " << message << "\n";
+            };
+            log = std::make_unique<ReplicationLog>(controller, shipLog, logOptions);
+        }
+
+        // A replica applies new log records as soon as the primary writes them
+        std::unique_ptr<FileWatcher> follower;
+        if (!replicaOf.empty()) {
+            follower = std::make_unique<FileWatcher>(ReplicationLog::logFile(replicaOf), [&controller] {
+                try {
+                    controller.reloadFromDisk();
+                } catch (const std::exception& e) {
+                    std::cerr << "server: replication failed: " << e.what() << "\n";
+                }
+            });
+        }
+
+        QueryServer server(controller, arguments[1], options);
+
+        activeServer = &server;
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        std::cerr << "Serving " << arguments[0] << " on " << arguments[1] << "\n";
+        server.run();
+        activeServer = nullptr;
+    } catch (const std::exception& e) {
+        std::cerr << "server: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+# Local multi-client catalog server (see server.cpp)
+
+TEMPLATE = app
+TARGET = server
+
+include(../libraflow.pri)
+
+SOURCES += server.cpp
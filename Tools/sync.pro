@@ -0,0 +1,8 @@
+# Delta sync between two catalogs (see sync.cpp)
+
+TEMPLATE = app
+TARGET = sync
+
+include(../libraflow.pri)
+
+SOURCES += sync.cpp
@@ -0,0 +1,209 @@
+#include "booktablemodel.h"
+
+#include <algorithm>
+
+BookTableModel::BookTableModel(QObject *parent)
+    : QAbstractTableModel(parent)
+    , mapped(false)
+    , loadedRows(0)
+    , sortColumn(-1)
+    , sortOrder(Qt::AscendingOrder)
+{
+}
+
+void BookTableModel::setSnapshot(std::shared_ptr<const CatalogSnapshot> snapshot)
+{
+    this->snapshot = std::move(snapshot);
+    rebuild();
+}
+
+void BookTableModel::setFilter(std::function<bool(const Book&)> filter)
+{
+    this->filter = std::move(filter);
+    rebuild();
+}
+
+void BookTableModel::setFilterResult(std::shared_ptr<const CatalogSnapshot> snapshot, std::function<bool(const Book&)> filter,
+                                     const std::vector<std::uint32_t>& matches)
+{
+    this->snapshot = std::move(snapshot);
+    this->filter = std::move(filter);
+    rebuild(&matches);
+}
+
+void BookTableModel::rebuild(const std::vector<std::uint32_t>* matches)
+{
+    beginResetModel();
+    rows.clear();
+    mapped = false;
+    if (!snapshot) {
+        loadedRows = 0;
+        endResetModel();
+        return;
+    }
+
+    std::vector<char> matched;
+    if (matches) {
+        matched.assign(snapshot->size(), 0);
+        for (auto position : *matches) matched[position] = 1;
+    } else if (filter) {
+        matched.reserve(snapshot->size());
+        for (const auto& book : *snapshot) matched.push_back(filter(book) ? 1 : 0);
+    }
+    auto keep = [this, &matched](size_t i) {
+        if (matched.empty() || matched[i]) rows.push_back(i);
+    };
+
+    if (sortColumn != -1) {
+        // Walk the snapshot's precomputed order; no rows are compared here
+        const auto& order = snapshot->sortOrder(static_cast<SortField>(sortColumn));
+        mapped = true;
+        if (!filter) rows.reserve(order.size());
+        if (sortOrder == Qt::AscendingOrder) {
+            for (auto it = order.begin(); it != order.end(); ++it) keep(*it);
+        } else {
+            for (auto it = order.rbegin(); it != order.rend(); ++it) keep(*it);
+        }
+    } else if (filter) {
+        mapped = true;
+        for (size_t i = 0; i < matched.size(); ++i) keep(i);
+    }
+
+    loadedRows = std::min(totalRows(), FetchBatchSize);
+    endResetModel();
+}
+
+void BookTableModel::applyChanges(std::shared_ptr<const CatalogSnapshot> snapshot, const std::vector<int>& changedIds)
+{
+    // Filtered or sorted rows may move anywhere; rebuild those views
+    if (mapped || !this->snapshot) {
+        setSnapshot(std::move(snapshot));
+        return;
+    }
+
+    size_t oldSize = this->snapshot->size();
+    size_t newSize = snapshot->size();
+
+    bool updatesOnly = (oldSize == newSize);
+    bool appendsOnly = (newSize == oldSize + changedIds.size());
+    for (int id : changedIds) {
+        size_t before = this->snapshot->positionOf(id);
+        size_t after = snapshot->positionOf(id);
+        if (before == CatalogSnapshot::npos || before != after) updatesOnly = false;
+        if (before != CatalogSnapshot::npos || after == CatalogSnapshot::npos || after < oldSize) appendsOnly = false;
+    }
+
+    if (updatesOnly) {
+        this->snapshot = std::move(snapshot);
+        for (int id : changedIds) {
+            int row = rowForId(id);
+            if (row >= 0 && static_cast<size_t>(row) < loadedRows) {
+                emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+            }
+        }
+    } else if (appendsOnly && loadedRows == oldSize) {
+        // At most one fetch batch goes to the view; it fetches the rest on demand
+        size_t shown = std::min(newSize - oldSize, FetchBatchSize);
+        beginInsertRows(QModelIndex(), oldSize, oldSize + shown - 1);
+        this->snapshot = std::move(snapshot);
+        loadedRows = oldSize + shown;
+        endInsertRows();
+    } else if (appendsOnly) {
+        // The new rows are beyond what the view has fetched so far
+        this->snapshot = std::move(snapshot);
+    } else {
+        setSnapshot(std::move(snapshot));
+    }
+}
+
+const Book* BookTableModel::bookAt(int row) const
+{
+    if (!snapshot || row < 0 || static_cast<size_t>(row) >= totalRows()) return nullptr;
+    return &snapshot->at(snapshotIndex(row));
+}
+
+int BookTableModel::rowForId(int id) const
+{
+    if (!snapshot) return -1;
+    size_t position = snapshot->positionOf(id);
+    if (position == CatalogSnapshot::npos) return -1;
+    if (!mapped) return static_cast<int>(position);
+
+    auto it = std::find(rows.begin(), rows.end(), position);
+    return it == rows.end() ? -1 : static_cast<int>(it - rows.begin());
+}
+
+size_t BookTableModel::totalRows() const
+{
+    if (mapped) return rows.size();
+    return snapshot ? snapshot->size() : 0;
+}
+
+int BookTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(loadedRows);
+}
+
+int BookTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant BookTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || static_cast<size_t>(index.row()) >= loadedRows) return QVariant();
+
+    const Book& book = snapshot->at(snapshotIndex(index.row()));
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case IdColumn: return book.getId();
+        case TitleColumn: return QString::fromStdString(book.getTitle());
+        case AuthorColumn: return QString::fromStdString(book.getAuthor());
+        case GenreColumn: return QString::fromStdString(book.getGenre());
+        case YearColumn: return book.getYear();
+        }
+    } else if (role == Qt::TextAlignmentRole) {
+        if (index.column() == IdColumn || index.column() == YearColumn) return int(Qt::AlignCenter);
+    }
+
+    return QVariant();
+}
+
+QVariant BookTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        switch (section) {
+        case IdColumn: return QString("ID");
+        case TitleColumn: return QString("Title");
+        case AuthorColumn: return QString("Author");
+        case GenreColumn: return QString("Genre");
+        case YearColumn: return QString("Year");
+        }
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+bool BookTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && loadedRows < totalRows();
+}
+
+void BookTableModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid()) return;
+
+    size_t count = std::min(FetchBatchSize, totalRows() - loadedRows);
+    if (count == 0) return;
+
+    beginInsertRows(QModelIndex(), loadedRows, loadedRows + count - 1);
+    loadedRows += count;
+    endInsertRows();
+}
+
+void BookTableModel::sort(int column, Qt::SortOrder order)
+{
+    sortColumn = (column >= 0 && column < ColumnCount) ? column : -1;
+    sortOrder = order;
+    rebuild();
+}
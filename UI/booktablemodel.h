@@ -0,0 +1,67 @@
+#ifndef BOOKTABLEMODEL_H
+#define BOOKTABLEMODEL_H
+
+#include <QAbstractTableModel>
+
+#include <memory>
+#include <vector>
+#include <functional>
+
+#include "catalogsnapshot.h"
+
+// Read-only table model over a CatalogSnapshot. Nothing is converted up front:
+// cells are formatted when the view asks for them, and rows are handed to the
+// view in batches through fetchMore() so very large catalogs open instantly.
+// A filtered or sorted view keeps one index per shown row; the plain view
+// keeps nothing per row. Filter and sort order survive snapshot changes.
+class BookTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    // Same order as SortField, so a column converts to its sort field directly
+    enum Column { IdColumn, TitleColumn, AuthorColumn, GenreColumn, YearColumn, ColumnCount };
+
+    explicit BookTableModel(QObject *parent = nullptr);
+
+    void setSnapshot(std::shared_ptr<const CatalogSnapshot> snapshot);
+    void setFilter(std::function<bool(const Book&)> filter); // nullptr shows every book
+    // Same as setSnapshot() + setFilter(), with the matching catalog positions
+    // already computed (e.g. on a worker thread)
+    void setFilterResult(std::shared_ptr<const CatalogSnapshot> snapshot, std::function<bool(const Book&)> filter,
+                         const std::vector<std::uint32_t>& matches);
+    // Moves to a newer snapshot in which only the given books changed
+    void applyChanges(std::shared_ptr<const CatalogSnapshot> snapshot, const std::vector<int>& changedIds);
+
+    const std::function<bool(const Book&)>& filterFunction() const { return filter; }
+    int sortedColumn() const { return sortColumn; } // -1 when unsorted
+
+    const Book* bookAt(int row) const;
+    int rowForId(int id) const;
+    size_t totalRows() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+private:
+    static constexpr size_t FetchBatchSize = 2048;
+
+    std::shared_ptr<const CatalogSnapshot> snapshot;
+    std::function<bool(const Book&)> filter;
+    std::vector<size_t> rows; // view row -> snapshot index, used when mapped is set
+    bool mapped;
+    size_t loadedRows;
+    int sortColumn;
+    Qt::SortOrder sortOrder;
+
+    size_t snapshotIndex(int row) const { return mapped ? rows[row] : static_cast<size_t>(row); }
+    void rebuild(const std::vector<std::uint32_t>* matches = nullptr);
+};
+
+#endif // BOOKTABLEMODEL_H
@@ -4,25 +4,44 @@
 #include <QStatusBar>
 #include <QFileDialog>
 #include <QStandardPaths>
+#include <QTimer>
+#include <QThread>
+#include <QDebug>
 #include <algorithm>
+#include <fstream>
 
 #include "csvrepository.h"
 #include "jsonrepository.h"
+#include "ndjsonrepository.h"
+#include "metrics.h"
+#include <QRunnable>
+
+namespace {
+
+// QThreadPool::start() takes a std::function only from Qt 5.15 on
+class FunctionRunnable : public QRunnable
+{
+public:
+    explicit FunctionRunnable(std::function<void()> work) : work(std::move(work)) {}
+    void run() override { work(); }
+
+private:
+    std::function<void()> work;
+};
+
+}
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
+    , repositoryKind(RepositoryKind::CSV)
     , selectedBookId(-1)
     , isUpdating(false)
+    , changeFlushScheduled(false)
 {
 
     QVBoxLayout* leftLayout = nullptr;
 
-    // Initialize with CSV repository by default
-    controller = std::make_unique<Controller>(
-        std::make_unique<CSVRepository>("library.csv")
-        );
-
     setupUI();
-    refreshTable();
     updateButtonStates();
 
     setWindowTitle("Library Management System");
@@ -30,10 +49,19 @@ MainWindow::MainWindow(QWidget *parent)
     resize(1200, 800);
 
     statusBar()->showMessage("Ready");
+
+    // Initialize with CSV repository by default, loaded in the background
+    openRepository(RepositoryKind::CSV);
 }
 
 MainWindow::~MainWindow()
 {
+    // Loader/import threads and filter queries call back into this window; let them wind down first
+    catalogWatcher.reset();
+    if (pendingLoad) pendingLoad->cancelled = true;
+    for (QThread *thread : workerThreads) thread->wait();
+    ++filterGeneration;
+    filterPool.waitForDone();
 }
 
 void MainWindow::setupUI()
@@ -46,6 +74,8 @@ void MainWindow::setupUI()
     setupActionsGroup();        // ✅ 3. Action buttons
     setupFilterGroup();         // ✅ 4. Filters
     setupTableWidget();         // ✅ 5. Books table (right panel)
+    setupLoadingIndicator();
+    setupLatencyReadout();
 
     leftLayout->addStretch();   // ✅ Pushes everything to the top
 
@@ -55,9 +85,11 @@ void MainWindow::setupUI()
     repoGroup = new QButtonGroup(this);
     repoGroup->addButton(csvRepoRadio);
     repoGroup->addButton(jsonRepoRadio);
+    repoGroup->addButton(ndjsonRepoRadio);
 
     connect(csvRepoRadio, &QRadioButton::toggled, this, &MainWindow::onRepositoryTypeChanged);
     connect(jsonRepoRadio, &QRadioButton::toggled, this, &MainWindow::onRepositoryTypeChanged);
+    connect(ndjsonRepoRadio, &QRadioButton::toggled, this, &MainWindow::onRepositoryTypeChanged);
 }
 
 void MainWindow::setupRepositoryGroup()
@@ -67,17 +99,21 @@ void MainWindow::setupRepositoryGroup()
 
     csvRepoRadio = new QRadioButton("CSV Repository");
     jsonRepoRadio = new QRadioButton("JSON Repository");
+    ndjsonRepoRadio = new QRadioButton("NDJSON Repository");
     csvRepoRadio->setChecked(true);
 
     repoGroup = new QButtonGroup(this);
     repoGroup->addButton(csvRepoRadio);
     repoGroup->addButton(jsonRepoRadio);
+    repoGroup->addButton(ndjsonRepoRadio);
 
     repoLayout->addWidget(csvRepoRadio);
     repoLayout->addWidget(jsonRepoRadio);
+    repoLayout->addWidget(ndjsonRepoRadio);
 
     connect(csvRepoRadio, &QRadioButton::toggled, this, &MainWindow::onRepositoryTypeChanged);
     connect(jsonRepoRadio, &QRadioButton::toggled, this, &MainWindow::onRepositoryTypeChanged);
+    connect(ndjsonRepoRadio, &QRadioButton::toggled, this, &MainWindow::onRepositoryTypeChanged);
 
     leftLayout->addWidget(repositoryGroup); // <--- Add it to layout HERE
 }
@@ -87,6 +123,16 @@ void MainWindow::setupMenuBar()
     QMenuBar *menuBar = this->menuBar();
 
     QMenu *fileMenu = menuBar->addMenu("&File");
+    QAction *importAction = fileMenu->addAction("&Import CSV...");
+    connect(importAction, &QAction::triggered, this, &MainWindow::onImportCsv);
+    QAction *exportAction = fileMenu->addAction("&Export...");
+    connect(exportAction, &QAction::triggered, this, &MainWindow::onExport);
+    fileMenu->addSeparator();
+    compressAction = fileMenu->addAction("&Compress Catalog File");
+    compressAction->setCheckable(true);
+    connect(compressAction, &QAction::triggered, this, &MainWindow::onCompressionToggled);
+    fileMenu->addSeparator();
+
     QAction *exitAction = fileMenu->addAction("E&xit");
     exitAction->setShortcut(QKeySequence::Quit);
     connect(exitAction, &QAction::triggered, this, &QWidget::close);
@@ -99,6 +145,57 @@ void MainWindow::setupMenuBar()
     QAction *redoAction = editMenu->addAction("&Redo");
     redoAction->setShortcut(QKeySequence::Redo);
     connect(redoAction, &QAction::triggered, this, &MainWindow::onRedo);
+
+    QMenu *helpMenu = menuBar->addMenu("&Help");
+    QAction *startupAction = helpMenu->addAction("&Startup Timing");
+    connect(startupAction, &QAction::triggered, this, &MainWindow::onShowStartupTiming);
+}
+
+void MainWindow::setupLoadingIndicator()
+{
+    loadProgress = new QProgressBar();
+    loadProgress->setRange(0, 100);
+    loadProgress->setMaximumWidth(200);
+    loadProgress->hide();
+
+    cancelLoadButton = new QPushButton("Cancel");
+    cancelLoadButton->hide();
+    connect(cancelLoadButton, &QPushButton::clicked, this, &MainWindow::cancelRepositoryLoad);
+
+    statusBar()->addPermanentWidget(loadProgress);
+    statusBar()->addPermanentWidget(cancelLoadButton);
+}
+
+void MainWindow::setupLatencyReadout()
+{
+    const std::uint64_t stallThresholdMicros = 100000;
+
+    latencyLabel = new QLabel();
+    latencyLabel->setStyleSheet("color: #6c757d;");
+    statusBar()->addPermanentWidget(latencyLabel);
+
+    QTimer *readoutTimer = new QTimer(this);
+    connect(readoutTimer, &QTimer::timeout, this, &MainWindow::updateLatencyReadout);
+    readoutTimer->start(1000);
+
+    // Only time spent on the GUI thread blocks the event loop
+    QThread *guiThread = thread();
+    Metrics::setStallHandler(stallThresholdMicros, [guiThread](const std::string& operation, std::uint64_t micros) {
+        if (QThread::currentThread() != guiThread) return;
+        qWarning("Event loop stalled for %.1f ms in %s", micros / 1000.0, operation.c_str());
+    });
+}
+
+void MainWindow::updateLatencyReadout()
+{
+    std::string operation = Metrics::lastOperation();
+    if (operation.empty()) return;
+
+    const LatencyHistogram& histogram = Metrics::histogram(operation);
+    latencyLabel->setText(QString("%1: last %2 ms, p99 %3 ms")
+                              .arg(QString::fromStdString(operation))
+                              .arg(histogram.last() / 1000.0, 0, 'f', 2)
+                              .arg(histogram.percentile(99) / 1000.0, 0, 'f', 2));
 }
 
 void MainWindow::setupMainLayout()
@@ -293,6 +390,14 @@ void MainWindow::setupFilterGroup()
     connect(enableYearFilter, &QCheckBox::toggled, filterYearToSpinBox, &QSpinBox::setEnabled);
 
     connect(applyFilterButton, &QPushButton::clicked, this, &MainWindow::onFilterBooks);
+
+    // Search as you type, once the keystrokes pause
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(150);
+    connect(searchTimer, &QTimer::timeout, this, &MainWindow::startFilterQuery);
+    connect(filterTitleEdit, &QLineEdit::textEdited, searchTimer, qOverload<>(&QTimer::start));
+    connect(filterAuthorEdit, &QLineEdit::textEdited, searchTimer, qOverload<>(&QTimer::start));
     connect(clearFilterButton, &QPushButton::clicked, this, &MainWindow::onClearFilters);
 
     leftLayout->addWidget(filterGroup);
@@ -302,9 +407,9 @@ void MainWindow::setupFilterGroup()
 
 void MainWindow::setupTableWidget()
 {
-    booksTable = new QTableWidget();
-    booksTable->setColumnCount(5);
-    booksTable->setHorizontalHeaderLabels({"ID", "Title", "Author", "Genre", "Year"});
+    booksTable = new QTableView();
+    bookModel = new BookTableModel(this);
+    booksTable->setModel(bookModel);
 
     // Configure table appearance
     booksTable->setSelectionBehavior(QAbstractItemView::SelectRows);
@@ -319,7 +424,7 @@ void MainWindow::setupTableWidget()
     booksTable->setColumnWidth(2, 150); // Author
     booksTable->setColumnWidth(3, 100); // Genre
 
-    connect(booksTable, &QTableWidget::itemSelectionChanged,
+    connect(booksTable->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &MainWindow::onTableSelectionChanged);
 
     mainSplitter->addWidget(booksTable);
@@ -333,30 +438,143 @@ void MainWindow::populateGenreComboBox()
 
 void MainWindow::refreshTable()
 {
-    auto books = controller->getAllBooks();
-    refreshTable(books);
+    SCOPED_TIMER("MainWindow::refreshTable");
+    if (!controller) return;
+
+    auto snapshot = controller->snapshot();
+    pendingChanges.clear();
+    if (sortOrderPending(snapshot)) return;
+    bookModel->setSnapshot(snapshot);
+
+    statusBar()->showMessage(QString("Total books: %1").arg(snapshot->size()));
 }
 
-void MainWindow::refreshTable(const std::vector<Book>& books)
+void MainWindow::subscribeToChanges()
 {
-    booksTable->setRowCount(books.size());
+    {
+        std::lock_guard<std::mutex> lock(incomingMutex);
+        incomingChanges.clear();
+        incomingBatchDepth = 0;
+    }
 
-    for (size_t i = 0; i < books.size(); ++i) {
-        const Book& book = books[i];
+    // Events may come from any writer thread. They are collected until their
+    // batch ends and then hop onto the GUI thread in one call, so a large
+    // group commit posts a single event rather than one per book.
+    controller->subscribe([this](const ChangeEvent& event) {
+        std::vector<ChangeEvent> events;
+        {
+            std::lock_guard<std::mutex> lock(incomingMutex);
+            incomingChanges.push_back(event);
+            if (event.type == ChangeEvent::Type::BatchBegin) ++incomingBatchDepth;
+            else if (event.type == ChangeEvent::Type::BatchEnd && incomingBatchDepth > 0) --incomingBatchDepth;
+            if (incomingBatchDepth > 0) return;
+            events.swap(incomingChanges);
+        }
+        QMetaObject::invokeMethod(this, [this, events] { queueChanges(events); }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::watchCatalogFile()
+{
+    // NDJSON files are append-only logs and are not merged back in
+    catalogWatcher.reset();
+    if (repositoryKind == RepositoryKind::NDJSON) return;
+
+    catalogWatcher = std::make_unique<FileWatcher>(catalogFileName(repositoryKind), [this] {
+        QMetaObject::invokeMethod(this, [this] { onCatalogFileChanged(); }, Qt::QueuedConnection);
+    });
+}
 
-        booksTable->setItem(i, 0, new QTableWidgetItem(QString::number(book.getId())));
-        booksTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(book.getTitle())));
-        booksTable->setItem(i, 2, new QTableWidgetItem(QString::fromStdString(book.getAuthor())));
-        booksTable->setItem(i, 3, new QTableWidgetItem(QString::fromStdString(book.getGenre())));
-        booksTable->setItem(i, 4, new QTableWidgetItem(QString::number(book.getYear())));
+void MainWindow::onCatalogFileChanged()
+{
+    SCOPED_TIMER("MainWindow::onCatalogFileChanged");
+    // Our own saves land here too; reloading finds nothing new in them. While
+    // a load or import runs, the next write merges the changes instead.
+    if (!controller || pendingLoad || importRunning) return;
 
-        // Make ID column read-only and centered
-        booksTable->item(i, 0)->setFlags(booksTable->item(i, 0)->flags() & ~Qt::ItemIsEditable);
-        booksTable->item(i, 0)->setTextAlignment(Qt::AlignCenter);
-        booksTable->item(i, 4)->setTextAlignment(Qt::AlignCenter);
+    try {
+        std::size_t changed = controller->reloadFromDisk();
+        if (changed > 0) {
+            statusBar()->showMessage(QString("Reloaded %1 book(s) changed by another program").arg(changed), 3000);
+        }
+    } catch (const std::exception& e) {
+        qWarning("Reloading the catalog file failed: %s", e.what());
     }
+}
 
-    statusBar()->showMessage(QString("Total books: %1").arg(books.size()));
+void MainWindow::queueChanges(const std::vector<ChangeEvent>& events)
+{
+    pendingChanges.insert(pendingChanges.end(), events.begin(), events.end());
+
+    // Coalesce a burst of events into a single repaint
+    if (!changeFlushScheduled) {
+        changeFlushScheduled = true;
+        QTimer::singleShot(0, this, &MainWindow::applyPendingChanges);
+    }
+}
+
+void MainWindow::applyPendingChanges()
+{
+    SCOPED_TIMER("MainWindow::applyPendingChanges");
+    const size_t maxIncrementalChanges = 256;
+
+    changeFlushScheduled = false;
+    std::vector<ChangeEvent> changes;
+    changes.swap(pendingChanges);
+    if (changes.empty()) return;
+
+    bool reset = std::any_of(changes.begin(), changes.end(), [](const ChangeEvent& e) {
+        return e.type == ChangeEvent::Type::Reset;
+    });
+    if (reset || changes.size() > maxIncrementalChanges) {
+        refreshTable();
+        return;
+    }
+
+    std::vector<int> touched;
+    for (const auto& change : changes) {
+        if (change.id == -1) continue;
+        if (std::find(touched.begin(), touched.end(), change.id) == touched.end()) touched.push_back(change.id);
+    }
+
+    auto snapshot = controller->snapshot();
+    if (sortOrderPending(snapshot)) return;
+    bookModel->applyChanges(snapshot, touched);
+}
+
+bool MainWindow::sortOrderPending(const std::shared_ptr<const CatalogSnapshot>& snapshot)
+{
+    // A sorted table walks the snapshot's sort order, which every new snapshot
+    // builds on first use. That happens on the pool; the table keeps showing
+    // the previous snapshot until the order is ready. Edits arriving during a
+    // build wait for it, so a steady stream of them cannot starve the table.
+    int column = bookModel->sortedColumn();
+    if (column < 0 || snapshot->hasSortOrder(static_cast<SortField>(column))) return false;
+    if (sortOrderBuilding) return true;
+
+    sortOrderBuilding = true;
+    Controller* owner = controller.get();
+    filterPool.start(new FunctionRunnable([this, snapshot, column, owner] {
+        SCOPED_TIMER("MainWindow::buildSortOrder");
+        snapshot->sortOrder(static_cast<SortField>(column));
+
+        QMetaObject::invokeMethod(this, [this, snapshot, column, owner] {
+            sortOrderBuilding = false;
+            if (!controller) return;
+            // Another repository was opened or another column sorted since;
+            // show the current catalog the current way
+            if (controller.get() != owner || bookModel->sortedColumn() != column) {
+                refreshTable();
+                return;
+            }
+
+            bookModel->setSnapshot(snapshot);
+            statusBar()->showMessage(QString("Total books: %1").arg(snapshot->size()));
+            // The catalog moved on while the order was built; catch up with it
+            if (controller->snapshot() != snapshot) refreshTable();
+        }, Qt::QueuedConnection);
+    }));
+    return true;
 }
 
 void MainWindow::clearForm()
@@ -411,14 +629,7 @@ bool MainWindow::validateForm()
 
 int MainWindow::getNextAvailableId()
 {
-    auto books = controller->getAllBooks();
-    int maxId = 0;
-    for (const auto& book : books) {
-        if (book.getId() > maxId) {
-            maxId = book.getId();
-        }
-    }
-    return maxId + 1;
+    return controller->nextId();
 }
 
 void MainWindow::updateButtonStates()
@@ -430,52 +641,43 @@ void MainWindow::updateButtonStates()
 
 std::function<bool(const Book&)> MainWindow::createFilterFunction()
 {
-    return [this](const Book& book) -> bool {
-        std::vector<bool> conditions;
-
-        // Title filter
-        if (enableTitleFilter->isChecked()) {
-            QString filterText = filterTitleEdit->text().trimmed().toLower();
-            QString bookTitle = QString::fromStdString(book.getTitle()).toLower();
-            conditions.push_back(bookTitle.contains(filterText));
-        }
-
-        // Author filter
-        if (enableAuthorFilter->isChecked()) {
-            QString filterText = filterAuthorEdit->text().trimmed().toLower();
-            QString bookAuthor = QString::fromStdString(book.getAuthor()).toLower();
-            conditions.push_back(bookAuthor.contains(filterText));
-        }
-
-        // Genre filter
-        if (enableGenreFilter->isChecked()) {
-            QString selectedGenre = filterGenreCombo->currentText();
-            if (selectedGenre != "Any") {
-                conditions.push_back(QString::fromStdString(book.getGenre()) == selectedGenre);
-            }
-        }
-
-        // Year range filter
-        if (enableYearFilter->isChecked()) {
-            int yearFrom = filterYearFromSpinBox->value();
-            int yearTo = filterYearToSpinBox->value();
-            conditions.push_back(book.getYear() >= yearFrom && book.getYear() <= yearTo);
-        }
-
-        if (conditions.empty()) return true;
+    // Read the widgets once: the filter runs on worker threads and must not
+    // touch them while it scans the catalog
+    bool byTitle = enableTitleFilter->isChecked();
+    bool byAuthor = enableAuthorFilter->isChecked();
+    bool byGenre = enableGenreFilter->isChecked() && filterGenreCombo->currentText() != "Any";
+    bool byYear = enableYearFilter->isChecked();
+    QString titleText = filterTitleEdit->text().trimmed();
+    QString authorText = filterAuthorEdit->text().trimmed();
+    std::string genre = filterGenreCombo->currentText().toStdString();
+    int yearFrom = filterYearFromSpinBox->value();
+    int yearTo = filterYearToSpinBox->value();
+    bool matchAll = andFilterRadio->isChecked();
+
+    return [=](const Book& book) -> bool {
+        int conditions = 0;
+        int satisfied = 0;
+        auto check = [&](bool condition) {
+            ++conditions;
+            if (condition) ++satisfied;
+        };
+
+        if (byTitle) check(QString::fromStdString(book.getTitle()).contains(titleText, Qt::CaseInsensitive));
+        if (byAuthor) check(QString::fromStdString(book.getAuthor()).contains(authorText, Qt::CaseInsensitive));
+        if (byGenre) check(book.getGenre() == genre);
+        if (byYear) check(book.getYear() >= yearFrom && book.getYear() <= yearTo);
+
+        if (conditions == 0) return true;
 
         // Apply AND/OR logic
-        if (andFilterRadio->isChecked()) {
-            return std::all_of(conditions.begin(), conditions.end(), [](bool c) { return c; });
-        } else {
-            return std::any_of(conditions.begin(), conditions.end(), [](bool c) { return c; });
-        }
+        return matchAll ? satisfied == conditions : satisfied > 0;
     };
 }
 
 // Slot implementations
 void MainWindow::onAddBook()
 {
+    SCOPED_TIMER("MainWindow::onAddBook");
     if (!validateForm()) return;
 
     try {
@@ -488,7 +690,6 @@ void MainWindow::onAddBook()
             );
 
         controller->addBook(book);
-        refreshTable();
         clearForm();
 
         statusBar()->showMessage("Book added successfully", 2000);
@@ -499,6 +700,7 @@ void MainWindow::onAddBook()
 
 void MainWindow::onUpdateBook()
 {
+    SCOPED_TIMER("MainWindow::onUpdateBook");
     if (!isUpdating || selectedBookId == -1) return;
     if (!validateForm()) return;
 
@@ -512,7 +714,6 @@ void MainWindow::onUpdateBook()
             );
 
         controller->updateBook(book);
-        refreshTable();
         clearForm();
         updateButtonStates();
 
@@ -524,6 +725,7 @@ void MainWindow::onUpdateBook()
 
 void MainWindow::onRemoveBook()
 {
+    SCOPED_TIMER("MainWindow::onRemoveBook");
     if (selectedBookId == -1) return;
 
     auto book = controller->findBook(selectedBookId);
@@ -538,7 +740,6 @@ void MainWindow::onRemoveBook()
     if (ret == QMessageBox::Yes) {
         try {
             controller->removeBook(selectedBookId);
-            refreshTable();
             clearForm();
             updateButtonStates();
 
@@ -551,8 +752,10 @@ void MainWindow::onRemoveBook()
 
 void MainWindow::onUndo()
 {
+    SCOPED_TIMER("MainWindow::onUndo");
+    if (!controller) return;
+
     controller->undo();
-    refreshTable();
     clearForm();
     updateButtonStates();
     statusBar()->showMessage("Undo completed", 2000);
@@ -560,8 +763,10 @@ void MainWindow::onUndo()
 
 void MainWindow::onRedo()
 {
+    SCOPED_TIMER("MainWindow::onRedo");
+    if (!controller) return;
+
     controller->redo();
-    refreshTable();
     clearForm();
     updateButtonStates();
     statusBar()->showMessage("Redo completed", 2000);
@@ -569,15 +774,50 @@ void MainWindow::onRedo()
 
 void MainWindow::onFilterBooks()
 {
-    auto filterFn = createFilterFunction();
-    auto filteredBooks = controller->filterBooks(filterFn);
-    refreshTable(filteredBooks);
+    SCOPED_TIMER("MainWindow::onFilterBooks");
+    startFilterQuery();
+}
 
-    statusBar()->showMessage(QString("Showing %1 filtered books").arg(filteredBooks.size()), 3000);
+void MainWindow::startFilterQuery()
+{
+    SCOPED_TIMER("MainWindow::startFilterQuery");
+    searchTimer->stop();
+    if (!controller) return;
+
+    // A newer query makes every older one stale; they notice and stop early
+    std::uint64_t generation = ++filterGeneration;
+    auto snapshot = controller->snapshot();
+    auto filter = createFilterFunction();
+    int column = bookModel->sortedColumn();
+
+    filterPool.start(new FunctionRunnable([this, generation, snapshot, filter, column] {
+        SCOPED_TIMER("MainWindow::filterQuery");
+        auto stale = [this, generation] { return filterGeneration.load() != generation; };
+
+        std::vector<std::uint32_t> matches;
+        if (!snapshot->select(filter, stale, matches)) return;
+        // Showing the result walks the sort order; build it here rather than on the GUI thread
+        if (column >= 0) snapshot->sortOrder(static_cast<SortField>(column));
+
+        QMetaObject::invokeMethod(this, [this, generation, snapshot, filter, matches] {
+            SCOPED_TIMER("MainWindow::showFilterResult");
+            if (filterGeneration.load() != generation) return;
+
+            // The catalog moved on while the query ran; run it again on the new one
+            if (!controller || controller->snapshot() != snapshot) {
+                startFilterQuery();
+                return;
+            }
+
+            bookModel->setFilterResult(snapshot, filter, matches);
+            statusBar()->showMessage(QString("Showing %1 filtered books").arg(bookModel->totalRows()), 3000);
+        }, Qt::QueuedConnection);
+    }));
 }
 
 void MainWindow::onClearFilters()
 {
+    SCOPED_TIMER("MainWindow::onClearFilters");
     enableTitleFilter->setChecked(false);
     enableAuthorFilter->setChecked(false);
     enableGenreFilter->setChecked(false);
@@ -591,24 +831,26 @@ void MainWindow::onClearFilters()
 
     andFilterRadio->setChecked(true);
 
-    refreshTable();
+    searchTimer->stop();
+    ++filterGeneration; // drop any query still running
+    bookModel->setFilter(nullptr);
     statusBar()->showMessage("Filters cleared", 2000);
 }
 
 void MainWindow::onTableSelectionChanged()
 {
-    QList<QTableWidgetItem*> selectedItems = booksTable->selectedItems();
-    if (selectedItems.isEmpty()) {
+    SCOPED_TIMER("MainWindow::onTableSelectionChanged");
+    QModelIndexList selectedRows = booksTable->selectionModel()->selectedRows();
+    if (selectedRows.isEmpty()) {
         selectedBookId = -1;
         clearForm();
         updateButtonStates();
         return;
     }
 
-    int row = selectedItems.first()->row();
-    QTableWidgetItem* idItem = booksTable->item(row, 0);
-    if (idItem) {
-        selectedBookId = idItem->text().toInt();
+    const Book* book = bookModel->bookAt(selectedRows.first().row());
+    if (book) {
+        selectedBookId = book->getId();
         populateFormFromSelection();
         updateButtonStates();
     }
@@ -616,19 +858,295 @@ void MainWindow::onTableSelectionChanged()
 
 void MainWindow::onRepositoryTypeChanged()
 {
+    SCOPED_TIMER("MainWindow::onRepositoryTypeChanged");
     if (csvRepoRadio->isChecked()) {
-        controller = std::make_unique<Controller>(
-            std::make_unique<CSVRepository>("library.csv")
-            );
-        statusBar()->showMessage("Switched to CSV repository", 2000);
+        openRepository(RepositoryKind::CSV);
     } else if (jsonRepoRadio->isChecked()) {
-        controller = std::make_unique<Controller>(
-            std::make_unique<JSONRepository>("library.json")
-            );
-        statusBar()->showMessage("Switched to JSON repository", 2000);
+        openRepository(RepositoryKind::JSON);
+    } else if (ndjsonRepoRadio->isChecked()) {
+        openRepository(RepositoryKind::NDJSON);
     }
+}
+
+QString MainWindow::repositoryName(RepositoryKind kind)
+{
+    switch (kind) {
+    case RepositoryKind::CSV: return "CSV";
+    case RepositoryKind::JSON: return "JSON";
+    case RepositoryKind::NDJSON: return "NDJSON";
+    }
+    return QString();
+}
 
+std::string MainWindow::catalogFileName(RepositoryKind kind)
+{
+    switch (kind) {
+    case RepositoryKind::CSV: return "library.csv";
+    case RepositoryKind::JSON: return "library.json";
+    case RepositoryKind::NDJSON: return "library.ndjson";
+    }
+    return std::string();
+}
+
+void MainWindow::openRepository(RepositoryKind kind)
+{
+    if (pendingLoad) {
+        if (pendingLoad->kind == kind) return;
+        pendingLoad->cancelled = true; // superseded; its result is dropped
+    } else if (controller && repositoryKind == kind) {
+        return;
+    }
+
+    auto load = std::make_shared<RepositoryLoad>();
+    load->kind = kind;
+    pendingLoad = load;
+    setLoading(true);
+    statusBar()->showMessage(QString("Opening %1 repository...").arg(repositoryName(kind)));
+
+    // The current controller keeps serving the table until the new one is ready
+    runInBackground([this, load] {
+        auto progress = [this, load](std::size_t done, std::size_t total) {
+            int percent = total ? static_cast<int>(done * 100 / total) : 100;
+            if (load->percent.exchange(percent) != percent) {
+                QMetaObject::invokeMethod(this, [this, load, percent] {
+                    if (load == pendingLoad) loadProgress->setValue(percent);
+                }, Qt::QueuedConnection);
+            }
+            return !load->cancelled;
+        };
+
+        try {
+            std::unique_ptr<Repository> repository;
+            std::string fileName = catalogFileName(load->kind);
+            switch (load->kind) {
+            case RepositoryKind::CSV:
+                repository = std::make_unique<CSVRepository>(fileName, progress);
+                break;
+            case RepositoryKind::JSON:
+                repository = std::make_unique<JSONRepository>(QString::fromStdString(fileName), progress);
+                break;
+            case RepositoryKind::NDJSON:
+                repository = std::make_unique<NDJSONRepository>(QString::fromStdString(fileName), progress);
+                break;
+            }
+            StartupProfile::mark("Catalog file loaded");
+            // The first snapshot is built here too, off the GUI thread
+            load->controller = std::make_unique<Controller>(std::move(repository));
+            StartupProfile::mark("First snapshot built");
+        } catch (const LoadCancelled&) {
+            // Nothing to report
+        } catch (const std::exception& e) {
+            load->error = QString::fromStdString(e.what());
+        }
+        QMetaObject::invokeMethod(this, [this, load] { finishRepositoryLoad(load); }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::runInBackground(std::function<void()> work)
+{
+    QThread *thread = QThread::create(std::move(work));
+    thread->setParent(this);
+    connect(thread, &QThread::finished, this, [this, thread] {
+        workerThreads.removeOne(thread);
+        thread->deleteLater();
+    });
+    workerThreads.append(thread);
+    thread->start();
+}
+
+void MainWindow::onImportCsv()
+{
+    SCOPED_TIMER("MainWindow::onImportCsv");
+    if (!controller || pendingLoad || importRunning) {
+        statusBar()->showMessage("Wait for the current operation to finish before importing", 3000);
+        return;
+    }
+
+    QString fileName = QFileDialog::getOpenFileName(this, "Import CSV", QString(), "CSV files (*.csv);;All files (*)");
+    if (fileName.isEmpty()) return;
+
+    // The controller cannot be swapped out while the import writes to it
+    importRunning = true;
+    repositoryGroup->setEnabled(false);
+    statusBar()->showMessage(QString("Importing %1...").arg(fileName));
+
+    Controller *target = controller.get();
+    runInBackground([this, target, fileName] {
+        ImportReport report;
+        QString error;
+        try {
+            report = target->importCsv(fileName.toStdString());
+        } catch (const std::exception& e) {
+            error = QString::fromStdString(e.what());
+        }
+        QMetaObject::invokeMethod(this, [this, report, error] { finishImport(report, error); }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::onExport()
+{
+    SCOPED_TIMER("MainWindow::onExport");
+    if (!controller) return;
+
+    QString selectedFilter;
+    QString fileName = QFileDialog::getSaveFileName(this, "Export Books", QString(),
+                                                    "CSV files (*.csv);;JSON files (*.json);;NDJSON files (*.ndjson)",
+                                                    &selectedFilter);
+    if (fileName.isEmpty()) return;
+
+    ExportFormat format = ExportFormat::Csv;
+    if (selectedFilter.startsWith("NDJSON")) {
+        format = ExportFormat::Ndjson;
+    } else if (selectedFilter.startsWith("JSON")) {
+        format = ExportFormat::JsonArray;
+    }
+
+    // Exports what the table shows; the snapshot stays valid however long this takes
+    auto snapshot = controller->snapshot();
+    auto filter = bookModel->filterFunction();
+    statusBar()->showMessage(QString("Exporting to %1...").arg(fileName));
+
+    runInBackground([this, snapshot, filter, fileName, format] {
+        std::size_t count = 0;
+        QString error;
+        try {
+            std::ofstream out(fileName.toStdString(), std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) throw std::runtime_error("Failed to open export file for writing.");
+            count = exportBooks(*snapshot, out, format, filter);
+        } catch (const std::exception& e) {
+            error = QString::fromStdString(e.what());
+        }
+
+        QMetaObject::invokeMethod(this, [this, count, error] {
+            if (!error.isEmpty()) {
+                QMessageBox::critical(this, "Error", QString("Export failed: %1").arg(error));
+                return;
+            }
+            statusBar()->showMessage(QString("Exported %1 books").arg(count), 3000);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::finishImport(const ImportReport& report, const QString& error)
+{
+    const std::size_t maxListedErrors = 10;
+
+    importRunning = false;
+    repositoryGroup->setEnabled(true);
+
+    if (!error.isEmpty()) {
+        QMessageBox::critical(this, "Error", QString("Import failed: %1").arg(error));
+        return;
+    }
+
+    QString details = QString::fromStdString(report.summary());
+    for (std::size_t i = 0; i < report.errors.size() && i < maxListedErrors; ++i) {
+        details += QString("\nLine %1: %2").arg(report.errors[i].line).arg(QString::fromStdString(report.errors[i].message));
+    }
+    if (report.duplicates + report.invalid > maxListedErrors) details += "\n...";
+
+    QMessageBox::information(this, "Import Finished", details);
+    statusBar()->showMessage(QString("Imported %1 books").arg(report.imported), 3000);
+}
+
+void MainWindow::onCompressionToggled(bool enabled)
+{
+    SCOPED_TIMER("MainWindow::onCompressionToggled");
+    if (!controller || pendingLoad || importRunning) {
+        compressAction->setChecked(controller && controller->compressedStorage());
+        statusBar()->showMessage("Wait for the current operation to finish before changing storage", 3000);
+        return;
+    }
+
+    try {
+        controller->setCompressedStorage(enabled);
+        statusBar()->showMessage(enabled ? "Catalog file compressed" : "Catalog file stored uncompressed", 2000);
+    } catch (const std::exception& e) {
+        QMessageBox::critical(this, "Error", QString("Failed to change storage: %1").arg(e.what()));
+    }
+    compressAction->setChecked(controller->compressedStorage());
+}
+
+void MainWindow::finishRepositoryLoad(const std::shared_ptr<RepositoryLoad>& load)
+{
+    SCOPED_TIMER("MainWindow::finishRepositoryLoad");
+    if (load != pendingLoad) return; // superseded or cancelled
+
+    pendingLoad.reset();
+    if (!load->controller) {
+        setLoading(false);
+        QMessageBox::critical(this, "Error", QString("Failed to open repository: %1").arg(load->error));
+        restoreRepositorySelection();
+        return;
+    }
+
+    replicationLog.reset(); // subscribed to the controller being replaced
+    controller = std::move(load->controller);
+    repositoryKind = load->kind;
+    if (!replicationBase.empty()) {
+        try {
+            ReplicationLog::Options options;
+            options.onError = [](const std::string& message) {
+                qWarning("Replication log: %s", message.c_str());
+            };
+            replicationLog = std::make_unique<ReplicationLog>(*controller, replicationBase, options);
+        } catch (const std::exception& e) {
+            qWarning("Replication log not written: %s", e.what());
+        }
+    }
+    compressAction->setChecked(controller->compressedStorage());
+    setLoading(false);
+
+    subscribeToChanges();
+    watchCatalogFile();
     refreshTable();
     clearForm();
     updateButtonStates();
+    statusBar()->showMessage(QString("Switched to %1 repository").arg(repositoryName(repositoryKind)), 2000);
+
+    if (!startupComplete) {
+        startupComplete = true;
+        StartupProfile::mark("Catalog shown");
+        if (reportStartup) qInfo("Startup timing:\n%s", StartupProfile::report().c_str());
+    }
+}
+
+void MainWindow::onShowStartupTiming()
+{
+    QString report = QString::fromStdString(StartupProfile::report());
+    QMessageBox box(QMessageBox::Information, "Startup Timing", report, QMessageBox::Ok, this);
+    box.setStyleSheet("QLabel { font-family: monospace; }");
+    box.exec();
+}
+
+void MainWindow::cancelRepositoryLoad()
+{
+    if (!pendingLoad) return;
+
+    pendingLoad->cancelled = true;
+    pendingLoad.reset();
+    setLoading(false);
+    restoreRepositorySelection();
+    statusBar()->showMessage("Repository load cancelled", 2000);
+}
+
+void MainWindow::restoreRepositorySelection()
+{
+    // Re-checking the active kind is a no-op in openRepository()
+    switch (repositoryKind) {
+    case RepositoryKind::CSV: csvRepoRadio->setChecked(true); break;
+    case RepositoryKind::JSON: jsonRepoRadio->setChecked(true); break;
+    case RepositoryKind::NDJSON: ndjsonRepoRadio->setChecked(true); break;
+    }
+}
+
+void MainWindow::setLoading(bool loading)
+{
+    loadProgress->setValue(0);
+    loadProgress->setVisible(loading);
+    cancelLoadButton->setVisible(loading);
+
+    // Without a repository there is nothing to edit yet
+    actionsGroup->setEnabled(controller != nullptr);
+    bookFormGroup->setEnabled(controller != nullptr);
 }
@@ -5,8 +5,7 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGridLayout>
-#include <QTableWidget>
-#include <QTableWidgetItem>
+#include <QTableView>
 #include <QPushButton>
 #include <QLineEdit>
 #include <QComboBox>
@@ -20,8 +19,18 @@
 #include <QRadioButton>
 #include <QSplitter>
 #include <QFrame>
+#include <QProgressBar>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QList>
 #include <memory>
+#include <atomic>
+#include <mutex>
 #include "controller.h"
+#include "booktablemodel.h"
+#include "filewatcher.h"
+#include "replication.h"
 // #include "csvrepository.h"
 // #include "jsonrepository.h"
 #include "book.h"
@@ -37,6 +46,11 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Print the startup phase timings once the first catalog is on screen
+    void setReportStartup(bool enabled) { reportStartup = enabled; }
+    // Ship every committed change to baseName.snapshot/.log for replicas
+    void setReplicationLog(const std::string& baseName) { replicationBase = baseName; }
+
 private slots:
     void onAddBook();
     void onUpdateBook();
@@ -47,6 +61,10 @@ private slots:
     void onClearFilters();
     void onTableSelectionChanged();
     void onRepositoryTypeChanged();
+    void onImportCsv();
+    void onExport();
+    void onCompressionToggled(bool enabled);
+    void onShowStartupTiming();
 
 private:
     void setupUI();
@@ -56,11 +74,43 @@ private:
     void setupActionsGroup();
     void setupFilterGroup();
     void setupTableWidget();
+    void setupLoadingIndicator();
+    void setupLatencyReadout();
+    void updateLatencyReadout();
 
     void setupRepositoryGroup();
 
     void refreshTable();
-    void refreshTable(const std::vector<Book>& books);
+
+    enum class RepositoryKind { CSV, JSON, NDJSON };
+    static QString repositoryName(RepositoryKind kind);
+    static std::string catalogFileName(RepositoryKind kind);
+
+    // A repository being opened on a worker thread
+    struct RepositoryLoad {
+        RepositoryKind kind;
+        std::atomic<bool> cancelled{false};
+        std::atomic<int> percent{-1};
+        std::unique_ptr<Controller> controller; // set by the worker on success
+        QString error;
+    };
+
+    void openRepository(RepositoryKind kind);
+    void finishRepositoryLoad(const std::shared_ptr<RepositoryLoad>& load);
+    void cancelRepositoryLoad();
+    void restoreRepositorySelection();
+    void setLoading(bool loading);
+
+    void startFilterQuery();
+    bool sortOrderPending(const std::shared_ptr<const CatalogSnapshot>& snapshot);
+    void runInBackground(std::function<void()> work);
+    void finishImport(const ImportReport& report, const QString& error);
+
+    void subscribeToChanges();
+    void queueChanges(const std::vector<ChangeEvent>& events);
+    void applyPendingChanges();
+    void watchCatalogFile();
+    void onCatalogFileChanged();
     void clearForm();
     void populateFormFromSelection();
     void populateGenreComboBox();
@@ -115,16 +165,50 @@ private:
     // Repository selection
     QRadioButton *csvRepoRadio;
     QRadioButton *jsonRepoRadio;
+    QRadioButton *ndjsonRepoRadio;
     QButtonGroup *repoGroup;
+    QAction *compressAction;
 
     // Table
-    QTableWidget *booksTable;
+    QTableView *booksTable;
+    BookTableModel *bookModel;
+
+    // Repository loading
+    QProgressBar *loadProgress;
+    QPushButton *cancelLoadButton;
+    RepositoryKind repositoryKind;           // kind of the repository in use
+    std::shared_ptr<RepositoryLoad> pendingLoad;
+    QList<QThread*> workerThreads;            // repository loads and imports
+    bool importRunning = false;
+    bool reportStartup = false;
+    bool startupComplete = false;            // the first catalog has been shown
+    std::unique_ptr<FileWatcher> catalogWatcher; // edits of the open file by other processes
+
+    // Live filtering: debounced keystrokes start a query on the pool
+    QTimer *searchTimer;
+    QThreadPool filterPool;
+    std::atomic<std::uint64_t> filterGeneration{0};
+    bool sortOrderBuilding = false; // a sort order for the table is being built on the pool
+
+    // Last/p99 timing of the most recent operation
+    QLabel *latencyLabel;
 
     // Controller and data
     std::unique_ptr<Controller> controller;
+    std::string replicationBase;
+    std::unique_ptr<ReplicationLog> replicationLog; // follows controller; declared after it
     int selectedBookId;
     bool isUpdating;
 
+    // Change events waiting for the next repaint
+    std::vector<ChangeEvent> pendingChanges;
+    bool changeFlushScheduled;
+
+    // Writer side: events of an open batch, posted to the GUI thread together
+    std::mutex incomingMutex;
+    std::vector<ChangeEvent> incomingChanges;
+    int incomingBatchDepth = 0;
+
     QVBoxLayout* leftLayout;
 };
 
@@ -0,0 +1,67 @@
+# Core and Business layers, shared by the test and benchmark executables and
+# the command-line tools. QtCore only: nothing here pulls in the widgets
+# module, so the tools run without a display.
+
+QT = core
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/Core $$PWD/Business
+
+SOURCES += \
+    $$PWD/Core/blockfile.cpp \
+    $$PWD/Core/book.cpp \
+    $$PWD/Core/catalogsync.cpp \
+    $$PWD/Core/csvrepository.cpp \
+    $$PWD/Core/filelock.cpp \
+    $$PWD/Core/filewatcher.cpp \
+    $$PWD/Core/idallocator.cpp \
+    $$PWD/Core/jsonrepository.cpp \
+    $$PWD/Core/ndjsonrepository.cpp \
+    $$PWD/Core/repository.cpp \
+    $$PWD/Core/shardedrepository.cpp \
+    $$PWD/Business/batchprocessor.cpp \
+    $$PWD/Business/catalogsnapshot.cpp \
+    $$PWD/Business/commandhistory.cpp \
+    $$PWD/Business/commands.cpp \
+    $$PWD/Business/controller.cpp \
+    $$PWD/Business/converter.cpp \
+    $$PWD/Business/csvimporter.cpp \
+    $$PWD/Business/deltasync.cpp \
+    $$PWD/Business/exporter.cpp \
+    $$PWD/Business/filter.cpp \
+    $$PWD/Business/metrics.cpp \
+    $$PWD/Business/queryserver.cpp \
+    $$PWD/Business/replication.cpp \
+    $$PWD/Business/sortindex.cpp \
+    $$PWD/Business/writerpipeline.cpp
+
+HEADERS += \
+    $$PWD/Core/blockfile.h \
+    $$PWD/Core/book.h \
+    $$PWD/Core/catalogsync.h \
+    $$PWD/Core/changeevent.h \
+    $$PWD/Core/csvrepository.h \
+    $$PWD/Core/filelock.h \
+    $$PWD/Core/filewatcher.h \
+    $$PWD/Core/idallocator.h \
+    $$PWD/Core/jsonrepository.h \
+    $$PWD/Core/ndjsonrepository.h \
+    $$PWD/Core/repository.h \
+    $$PWD/Core/shardedrepository.h \
+    $$PWD/Business/batchprocessor.h \
+    $$PWD/Business/catalogsnapshot.h \
+    $$PWD/Business/commandhistory.h \
+    $$PWD/Business/commands.h \
+    $$PWD/Business/controller.h \
+    $$PWD/Business/converter.h \
+    $$PWD/Business/csvimporter.h \
+    $$PWD/Business/deltasync.h \
+    $$PWD/Business/exporter.h \
+    $$PWD/Business/filter.h \
+    $$PWD/Business/metrics.h \
+    $$PWD/Business/mpscqueue.h \
+    $$PWD/Business/queryserver.h \
+    $$PWD/Business/replication.h \
+    $$PWD/Business/sortindex.h \
+    $$PWD/Business/writerpipeline.h
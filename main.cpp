@@ -1,30 +1,35 @@
 #include "mainwindow.h"
-#include "librarytests.h"
+#include "metrics.h"
 
-#include <vector>
-#include <memory>
+#include <cstring>
+#include <string>
 
 #include <QApplication>
+#include <QTimer>
 
-void runTests() {
-    std::vector<std::unique_ptr<TestFramework>> testSuites;
-    testSuites.emplace_back(std::make_unique<BookTests>());
-    testSuites.emplace_back(std::make_unique<CSVRepositoryTests>());
-    testSuites.emplace_back(std::make_unique<JSONRepositoryTests>());
-    testSuites.emplace_back(std::make_unique<ControllerTests>());
-    testSuites.emplace_back(std::make_unique<FilterTests>());
-
-    for (auto& suite : testSuites) {
-        suite->runAllTests();
-        suite->printResults();
-    }
-}
-
+// The catalog is opened in the background while the window comes up; the
+// test suites live in their own executable (Testing/tests.cpp).
+// --startup-timing prints how long each startup phase took once the catalog
+// is on screen; Help > Startup Timing shows the same at any time.
+// --ship-log BASE publishes changes for read replicas (see ReplicationLog).
 int main(int argc, char *argv[])
 {
+    StartupProfile::mark("main() entered");
+    bool reportStartup = false;
+    std::string shipLog;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--startup-timing") == 0) reportStartup = true;
+        else if (std::strcmp(argv[i], "--ship-log") == 0 && i + 1 < argc) shipLog = argv[++i];
+    }
+
     QApplication a(argc, argv);
+    StartupProfile::mark("QApplication created");
     MainWindow w;
-    runTests();
+    w.setReportStartup(reportStartup);
+    w.setReplicationLog(shipLog);
+    StartupProfile::mark("Main window built");
     w.show();
+    StartupProfile::mark("Main window shown");
+    QTimer::singleShot(0, [] { StartupProfile::mark("Event loop running"); });
     return a.exec();
 }